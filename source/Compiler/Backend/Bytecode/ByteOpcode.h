@@ -28,6 +28,33 @@ enum class Register : u8
     Count = R15
 };
 
+// Where a native function's callback finds one of its parameters, the first four are in registers and the rest in 8 byte slots from Rsp up
+struct NativeParameterLocation
+{
+public:
+    static constexpr NativeParameterLocation Get(u32 index)
+    {
+        constexpr Register ParameterRegisters[4] = { Register::Rcx, Register::Rdx, Register::R8, Register::R9 };
+
+        NativeParameterLocation location;
+        if (index < 4)
+        {
+            location.reg = ParameterRegisters[index];
+        }
+        else
+        {
+            // Natives don't set up a frame, the caller pushed the arguments last to first so the fifth one is at Rsp
+            location.stackOffset = (index - 4) * 8;
+        }
+
+        return location;
+    }
+
+public:
+    Register reg = Register::None; // None when the parameter is on the stack
+    u32 stackOffset = 0;
+};
+
 struct ByteOpcode
 {
 public:
@@ -51,11 +78,14 @@ public:
 
         MemoryNew,
         MemoryFree,
+        MemCopy, // Copy a block of memory between two addresses
+        MemSet, // Fill a block of memory with a byte value
 
         CreateStringOnHeap,
 
         FunctionCall,
         FunctionCallNative,
+        TailCall, // Replaces the running function with the callee, the callee returns straight to our caller
         Ret,
 
         MoveNToR, // Move Number To Register
@@ -88,16 +118,14 @@ public:
         CmpLE_RToR, // Cmp Less Equals Register to Register
         CmpG_RToR, // Cmp Greater Register to Register
         CmpGE_RToR, // Cmp GreaterEquals Register to Register
+
+        Count
     };
 
     ByteOpcode(Kind inKind) : kind(inKind) { }
 
     Kind kind = Kind::None;
 
-#if NAI_DEBUG
-    char comment[32] = { 0 };
-#endif // NAI_DEBUG
-
 public:
     static const char* GetKindName(Kind kind)
     {
@@ -117,8 +145,11 @@ public:
             case Kind::LoadAddress: return "LoadAddress";
             case Kind::MemoryNew: return "MemoryNew";
             case Kind::MemoryFree: return "MemoryFree";
+            case Kind::MemCopy: return "MemCopy";
+            case Kind::MemSet: return "MemSet";
             case Kind::CreateStringOnHeap: return "CreateStringOnHeap";
             case Kind::FunctionCall: return "FunctionCall";
+            case Kind::TailCall: return "TailCall";
             case Kind::Ret: return "Ret";
             case Kind::MoveNToR: return "MoveNToR";
             case Kind::MoveNToA: return "MoveNToA";
@@ -149,6 +180,9 @@ public:
         }
     }
 
+    // Size of the instruction in bytes, 0 for kinds the Interpreter can't run
+    static u32 GetKindSize(Kind kind);
+
     static const char* GetRegisterName(Register reg)
     {
         switch (reg)
@@ -354,6 +388,58 @@ public:
     MemoryFree() : ByteOpcode(Kind::MemoryFree) { }
 };
 
+// Source and destination registers hold addresses, the size is read from sizeRegister unless it is Register::None
+struct MemCopy : public ByteOpcode
+{
+public:
+    MemCopy(Register inSource, Register inDestination, u64 inSize) : ByteOpcode(Kind::MemCopy)
+    {
+        source = inSource;
+        destination = inDestination;
+        sizeRegister = Register::None;
+        size = inSize;
+    }
+    MemCopy(Register inSource, Register inDestination, Register inSizeRegister) : ByteOpcode(Kind::MemCopy)
+    {
+        source = inSource;
+        destination = inDestination;
+        sizeRegister = inSizeRegister;
+        size = 0;
+    }
+
+    Register source;
+    Register destination;
+    Register sizeRegister;
+    u64 size;
+};
+// Destination register holds an address, value and size are read from their registers unless they are Register::None
+struct MemSet : public ByteOpcode
+{
+public:
+    MemSet(Register inDestination, u8 inValue, u64 inSize) : ByteOpcode(Kind::MemSet)
+    {
+        destination = inDestination;
+        valueRegister = Register::None;
+        sizeRegister = Register::None;
+        value = inValue;
+        size = inSize;
+    }
+    MemSet(Register inDestination, Register inValueRegister, Register inSizeRegister) : ByteOpcode(Kind::MemSet)
+    {
+        destination = inDestination;
+        valueRegister = inValueRegister;
+        sizeRegister = inSizeRegister;
+        value = 0;
+        size = 0;
+    }
+
+    Register destination;
+    Register valueRegister;
+    Register sizeRegister;
+    u8 value;
+    u64 size;
+};
+
 struct CreateStringOnHeap : public ByteOpcode
 {
 public:
@@ -375,6 +461,16 @@ public:
 
     u32 callhash;
 };
+struct TailCall : public ByteOpcode
+{
+public:
+    TailCall(u32 hash) : ByteOpcode(Kind::TailCall)
+    {
+        callhash = hash;
+    }
+
+    u32 callhash;
+};
 struct OpRet : public ByteOpcode
 {
     OpRet() : ByteOpcode(Kind::Ret) { }
@@ -812,4 +908,56 @@ public:
 
     Register source;
     Register destination;
-};
\ No newline at end of file
+};
+
+inline u32 ByteOpcode::GetKindSize(Kind kind)
+{
+    switch (kind)
+    {
+        case Kind::PushRegister: return sizeof(PushRegister);
+        case Kind::PushNumber: return sizeof(PushNumber);
+        case Kind::PopRegister: return sizeof(PopRegister);
+        case Kind::PopNoRegister: return sizeof(PopNoRegister);
+        case Kind::JumpAbsolute: return sizeof(JumpAbsolute);
+        case Kind::JumpRelative: return sizeof(JumpRelative);
+        case Kind::JumpFunctionEnd: return sizeof(JumpFunctionEnd);
+        case Kind::LoadAbsolute: return sizeof(LoadAbsolute);
+        case Kind::LoadRelative: return sizeof(LoadRelative);
+        case Kind::LoadRegister: return sizeof(LoadRegister);
+        case Kind::LoadAddress: return sizeof(LoadAddress);
+        case Kind::MemoryNew: return sizeof(MemoryNew);
+        case Kind::MemoryFree: return sizeof(MemoryFree);
+        case Kind::MemCopy: return sizeof(MemCopy);
+        case Kind::MemSet: return sizeof(MemSet);
+        case Kind::CreateStringOnHeap: return sizeof(CreateStringOnHeap);
+        case Kind::FunctionCall: return sizeof(FunctionCall);
+        case Kind::TailCall: return sizeof(TailCall);
+        case Kind::Ret: return sizeof(OpRet);
+        case Kind::MoveNToR: return sizeof(MoveNToR);
+        case Kind::MoveNToA: return sizeof(MoveNToA);
+        case Kind::MoveRToR: return sizeof(MoveRToR);
+        case Kind::MoveRToA: return sizeof(MoveRToA);
+        case Kind::MoveAToR: return sizeof(MoveAToR);
+        case Kind::MoveAToA: return sizeof(MoveAToA);
+        case Kind::AddNToR: return sizeof(AddNToR);
+        case Kind::AddNToA: return sizeof(AddNToA);
+        case Kind::AddRToR: return sizeof(AddRToR);
+        case Kind::AddRToA: return sizeof(AddRToA);
+        case Kind::AddAToR: return sizeof(AddAToR);
+        case Kind::AddAToA: return sizeof(AddAToA);
+        case Kind::SubNToR: return sizeof(SubNToR);
+        case Kind::SubRToR: return sizeof(SubRToR);
+        case Kind::MulRToR: return sizeof(MulRToR);
+        case Kind::DivRToR: return sizeof(DivRToR);
+        case Kind::ModuloRToR: return sizeof(ModuloRToR);
+        case Kind::CmpE_RToR: return sizeof(CmpE_RToR);
+        case Kind::CmpNE_RToR: return sizeof(CmpNE_RToR);
+        case Kind::CmpL_RToR: return sizeof(CmpL_RToR);
+        case Kind::CmpLE_NToR: return sizeof(CmpLE_NToR);
+        case Kind::CmpLE_RToR: return sizeof(CmpLE_RToR);
+        case Kind::CmpG_RToR: return sizeof(CmpG_RToR);
+        case Kind::CmpGE_RToR: return sizeof(CmpGE_RToR);
+
+        default: return 0;
+    }
+}
@@ -3,36 +3,245 @@
 #include "../../Module.h"
 
 #include "ByteOpcode.h"
+#include "RegisterAllocator.h"
+#include "Utils/JobUtils.h"
+
+thread_local BytecodeContext* Bytecode::_context = nullptr;
 
 void Bytecode::Process(Module* module)
 {
-    module->bytecodeInfo.opcodes.clear();
+    // Nai has no global variables, so we only need to generate functions
+    std::vector<Declaration*> functions;
 
-    Compound* compound = module->parserInfo.block;
-    GenerateScope(module, compound->scope);
+    ListNode* node;
+    ListIterate(&module->parserInfo.block->scope->declarations, node)
+    {
+        Declaration* declaration = ListGetStructPtr(node, Declaration, listNode);
+        if (declaration->kind == Declaration::Kind::Function)
+            functions.push_back(declaration);
+    }
+
+    Process(module, functions);
 }
 
-void Bytecode::EnterLoop(Module* module, Loop* loop)
+void Bytecode::Process(Module* module, const std::vector<Declaration*>& declarations)
 {
-    Loop* currentLoop = module->parserInfo.currentLoop;
+    BytecodeInfo& bytecodeInfo = module->bytecodeInfo;
+
+    robin_hood::unordered_map<Declaration*, bool> needsGenerating;
+    for (Declaration* declaration : declarations)
+    {
+        if (declaration->kind == Declaration::Kind::Function)
+            needsGenerating[declaration] = true;
+    }
+
+    std::vector<Declaration*> functions;
+    robin_hood::unordered_map<u32, bool> functionHashes;
+
+    ListNode* node;
+    ListIterate(&module->parserInfo.block->scope->declarations, node)
+    {
+        Declaration* declaration = ListGetStructPtr(node, Declaration, listNode);
+
+        // Unreachable functions were never typed, leaving them out also keeps them out of the module's code
+        if (declaration->kind == Declaration::Kind::Function && !declaration->function.flags.unreachable)
+        {
+            functions.push_back(declaration);
+            functionHashes[declaration->token->nameHash.hash] = true;
+        }
+    }
+
+    // Functions that no longer exist must not be callable
+    for (auto itr = bytecodeInfo.functionHashToDeclaration.begin(); itr != bytecodeInfo.functionHashToDeclaration.end();)
+    {
+        if (functionHashes.find(itr->first) == functionHashes.end())
+        {
+            bytecodeInfo.functionHashToMemoryInfo.erase(itr->first);
+            bytecodeInfo.functionHashToParamInfo.erase(itr->first);
+            bytecodeInfo.functionHashToComments.erase(itr->first);
+            itr = bytecodeInfo.functionHashToDeclaration.erase(itr);
+        }
+        else
+        {
+            ++itr;
+        }
+    }
+
+    // Create every map entry up front, the workers only write to entries they own and never insert
+    for (Declaration* declaration : functions)
+    {
+        u32 functionHash = declaration->token->nameHash.hash;
+
+        bytecodeInfo.functionHashToDeclaration[functionHash] = declaration;
+        bytecodeInfo.functionHashToMemoryInfo[functionHash];
+        bytecodeInfo.functionHashToParamInfo[functionHash];
+    }
+
+    std::vector<BytecodeContext> contexts(functions.size());
+    std::vector<size_t> jobs;
+
+    for (size_t i = 0; i < functions.size(); i++)
+    {
+        u32 functionHash = functions[i]->token->nameHash.hash;
+
+        BytecodeContext& context = contexts[i];
+        context.memoryInfo = &bytecodeInfo.functionHashToMemoryInfo[functionHash];
+        context.paramInfo = &bytecodeInfo.functionHashToParamInfo[functionHash];
+
+        if (needsGenerating.find(functions[i]) != needsGenerating.end())
+        {
+            context.opcodes.recordComments = bytecodeInfo.recordComments;
+
+            auto irItr = module->irInfo.functions.find(functions[i]);
+            if (irItr != module->irInfo.functions.end())
+            {
+                context.irFunction = irItr->second;
+            }
+
+            jobs.push_back(i);
+        }
+        else
+        {
+            // Reused functions keep their code, their strings were already added to the StringTable when first linked
+            FunctionMemoryInfo* memoryInfo = context.memoryInfo;
+            assert(memoryInfo->instructions);
+
+            context.opcodes.Assign(memoryInfo->instructions, memoryInfo->numInstructionBytes);
+        }
+    }
+
+    JobUtils::ParallelFor(jobs.size(), [&](size_t index)
+    {
+        size_t functionIndex = jobs[index];
+
+        _context = &contexts[functionIndex];
+        GenerateFunction(module, &functions[functionIndex]->function);
+        _context = nullptr;
+    });
+
+    // Link in declaration order so the output doesn't depend on thread scheduling
+    // Reserving up front keeps the instruction pointers we hand out stable while we append
+    size_t numInstructionBytes = 0;
+    for (BytecodeContext& context : contexts)
+    {
+        numInstructionBytes += context.opcodes.GetSize();
+    }
+
+    // Frames that are still running keep executing the previous code, the Interpreter releases it once they have returned
+    if (bytecodeInfo.opcodes.size())
+    {
+        bytecodeInfo.retiredOpcodes.push_back(std::move(bytecodeInfo.opcodes));
+    }
+
+    bytecodeInfo.opcodes = std::vector<u8>();
+    bytecodeInfo.opcodes.reserve(numInstructionBytes);
+
+    for (BytecodeContext& context : contexts)
+    {
+        LinkFunction(module, &context);
+    }
+
+    // Reused functions keep the comments from when they were generated
+    if (bytecodeInfo.recordComments)
+    {
+        for (size_t functionIndex : jobs)
+        {
+            u32 functionHash = functions[functionIndex]->token->nameHash.hash;
+            bytecodeInfo.functionHashToComments[functionHash] = std::move(contexts[functionIndex].opcodes.comments);
+        }
+    }
+
+    DebugHandler::PrintSuccess("Bytecode : Successfully Processsed Module (%s) (Functions: %u, Generated: %u, Bytes: %u)", module->nameHash.name.c_str(), static_cast<u32>(functions.size()), static_cast<u32>(jobs.size()), static_cast<u32>(numInstructionBytes));
+}
+
+void Bytecode::LinkFunction(Module* module, BytecodeContext* context)
+{
+    BytecodeInfo& bytecodeInfo = module->bytecodeInfo;
+
+    for (size_t i = 0; i < context->stringOpcodeIndices.size(); i++)
+    {
+        CreateStringOnHeap createString(0);
+        context->opcodes.Read(context->stringOpcodeIndices[i], createString);
+
+        String* string = context->strings[createString.strIndex];
+        createString.strIndex = static_cast<u16>(bytecodeInfo.stringTable.AddString(*string));
+        context->opcodes.Write(context->stringOpcodeIndices[i], createString);
+    }
+
+    // Jumps are relative to the start of the function and calls go through the function hash, so the code can be moved as is
+    size_t offset = bytecodeInfo.opcodes.size();
+    u8* code = context->opcodes.GetData();
+    bytecodeInfo.opcodes.insert(bytecodeInfo.opcodes.end(), code, code + context->opcodes.GetSize());
+
+    context->memoryInfo->instructions = bytecodeInfo.opcodes.data() + offset;
+    context->opcodes.Release();
+}
+
+void Bytecode::PrintDisassembly(Module* module)
+{
+    BytecodeInfo& bytecodeInfo = module->bytecodeInfo;
+
+    ListNode* node;
+    ListIterate(&module->parserInfo.block->scope->declarations, node)
+    {
+        Declaration* declaration = ListGetStructPtr(node, Declaration, listNode);
+        if (declaration->kind != Declaration::Kind::Function)
+            continue;
+
+        u32 functionHash = declaration->token->nameHash.hash;
+
+        // Natives and unreachable functions have no code
+        auto itr = bytecodeInfo.functionHashToComments.find(functionHash);
+        if (itr == bytecodeInfo.functionHashToComments.end())
+            continue;
+
+        const FunctionMemoryInfo& memoryInfo = bytecodeInfo.functionHashToMemoryInfo[functionHash];
+        DebugHandler::Print("Function (%.*s) (Bytes: %u)", declaration->token->nameHash.length, declaration->token->nameHash.name, memoryInfo.numInstructionBytes);
+
+        for (const CodeComment& comment : itr->second)
+        {
+            ByteOpcode* opcode = reinterpret_cast<ByteOpcode*>(memoryInfo.instructions + comment.offset);
+            DebugHandler::Print("    %04u %-20s %.*s", comment.offset, ByteOpcode::GetKindName(opcode->kind), static_cast<i32>(comment.text.length()), comment.text.data());
+        }
+    }
+}
+
+void Bytecode::EnterLoop(Module* /*module*/, Loop* loop)
+{
+    Loop* currentLoop = _context->currentLoop;
 
     loop->parent = currentLoop;
-    module->parserInfo.currentLoop = loop;
+    _context->currentLoop = loop;
 }
 
-void Bytecode::ExitLoop(Module* module)
+void Bytecode::ExitLoop(Module* /*module*/)
 {
-    assert(module->parserInfo.currentLoop);
-    module->parserInfo.currentLoop = module->parserInfo.currentLoop->parent;
+    assert(_context->currentLoop);
+    _context->currentLoop = _context->currentLoop->parent;
 }
 
 void Bytecode::GenerateLoadFrom(Module* module, Type* type, Register source, Register destination, bool isSourceAddress, bool isDestinationAddress)
 {
-    assert(type && (type->kind == Type::Kind::Basic || type->kind == Type::Kind::Pointer));
+    assert(type && (type->kind == Type::Kind::Basic || type->kind == Type::Kind::Pointer || type->kind == Type::Kind::Struct));
 
     if (type->kind == Type::Kind::Pointer && type->pointer.count)
         return;
 
+    // The value of a struct is its address, only storing it into another struct touches its memory
+    if (type->kind == Type::Kind::Struct)
+    {
+        if (isDestinationAddress)
+        {
+            Emit(module, MemCopy(source, destination, type->size), "Copy Struct");
+        }
+        else if (source != destination)
+        {
+            Emit(module, MoveRToR(source, destination, 8, false));
+        }
+
+        return;
+    }
+
     if (type->size < 1 || type->size > 8)
     {
         DebugHandler::PrintError("Bytecode : Unsupported Type::size(%u)", type->size);
@@ -62,6 +271,9 @@ void Bytecode::GenerateAddressInto(Module* module, Expression* expression, Regis
     if (expression->kind == Expression::Kind::Primary &&
         expression->primary.kind == Primary::Kind::Identifier)
     {
+        // The RegisterAllocator leaves every local that needs an address in the frame
+        assert(GetLocalRegister(expression->primary.declaration) == Register::None);
+
         if (loadAddress)
         {
             Emit(module, LoadAddress(static_cast<i32>(expression->primary.declaration->variable.offset), reg, true, false));
@@ -79,7 +291,7 @@ void Bytecode::GenerateAddressInto(Module* module, Expression* expression, Regis
     else if (expression->kind == Expression::Kind::Dot)
     {
         GenerateAddressInto(module, expression->dot.expression, Register::Rax, true);
-        Emit(module, AddNToR(expression->dot.offset, Register::Rax, static_cast<u8>(expression->type->size)));
+        Emit(module, AddNToR(expression->dot.offset, Register::Rax, 8));
     }
     else
     {
@@ -88,33 +300,28 @@ void Bytecode::GenerateAddressInto(Module* module, Expression* expression, Regis
     }
 }
 
-void Bytecode::GenerateScope(Module* module, Scope* scope)
-{
-    // Nai has no global variables, so we only need to generate functions
-
-    ListNode* node;
-    ListIterate(&scope->declarations, node)
-    {
-        Declaration* declaration = ListGetStructPtr(node, Declaration, listNode);
-        if (declaration->kind == Declaration::Kind::Function)
-            GenerateFunction(module, &declaration->function);
-    }
-}
-
 void Bytecode::GenerateFunction(Module* module, Function* function)
 {
     assert(function->body);
 
-    Declaration* fnDecl = reinterpret_cast<Declaration*>(function);
-    u32 functionHash = fnDecl->token->nameHash.hash;
+    _context->currentFunction = function;
+    FunctionParamInfo& paramInfo = *_context->paramInfo;
+    paramInfo.extraParameterStackSpace = 0;
 
-    module->bytecodeInfo.currentFunction = function;
-    module->bytecodeInfo.functionHashToDeclaration[functionHash] = fnDecl;
-    FunctionParamInfo& paramInfo = module->bytecodeInfo.functionHashToParamInfo[functionHash];
+    // The Typer rejects structs returned by value
+    assert(function->returnType->kind != Type::Kind::Struct);
 
     // Go over all variables (Including Child Scopes) and generate variable offsets
     u64 variableFrameSize = GenerateFunctionVariableOffsets(module, function->scope);
 
+    IRFunction* irFunction = _context->irFunction;
+    if (irFunction)
+    {
+        variableFrameSize = AssignSlots(irFunction, variableFrameSize);
+    }
+
+    _context->frameSize = variableFrameSize;
+
     ListNode* node;
     u64 numParameters = 0;
 
@@ -139,20 +346,96 @@ void Bytecode::GenerateFunction(Module* module, Function* function)
         Emit(module, SubNToR(variableFrameSize, Register::Rsp, 8), "Move Rsp");
     }
 
-    GenerateStatement(module, function->body);
+    if (irFunction)
+    {
+        // Values kept in registers use the same callee saved registers as locals
+        for (Register reg : _context->savedRegisters)
+        {
+            Emit(module, PushRegister(reg), "Save Value Register");
+        }
 
-    u32 cleanupAddress = static_cast<u32>(module->bytecodeInfo.opcodes.size());
-    Emit(module, MoveRToR(Register::Rbp, Register::Rsp, 8, false), "Restore Rsp Stack");
-    Emit(module, PopRegister(Register::Rbp), "Restore Rbp");
+        LowerFunction(module, irFunction);
+    }
+    else
+    {
+        // Locals kept in registers use callee saved registers, the caller expects them untouched when we return
+        RegisterAllocator::Allocate(module, function, _context);
+        _context->numTemporaries = 0;
+
+        for (Register reg : _context->savedRegisters)
+        {
+            Emit(module, PushRegister(reg), "Save Local Register");
+        }
+
+        GenerateStructParameterCopies(module, function);
+        GenerateStatement(module, function->body);
+    }
+
+    u32 cleanupAddress = static_cast<u32>(_context->opcodes.GetSize());
+
+    GenerateFunctionCleanup(module);
     Emit(module, OpRet(), "Function Return");
 
-    FunctionMemoryInfo& memoryInfo = module->bytecodeInfo.functionHashToMemoryInfo[functionHash];
-    memoryInfo.numInstructionBytes = static_cast<u32>(module->bytecodeInfo.opcodes.size());
-    memoryInfo.instructions = new u8[memoryInfo.numInstructionBytes];
+    // The instructions pointer is set by LinkFunction once the function has been placed in the module's buffer
+    FunctionMemoryInfo& memoryInfo = *_context->memoryInfo;
+    memoryInfo.numInstructionBytes = static_cast<u32>(_context->opcodes.GetSize());
     memoryInfo.cleanupAddress = cleanupAddress;
-    
-    memcpy(memoryInfo.instructions, module->bytecodeInfo.opcodes.data(), memoryInfo.numInstructionBytes);
-    module->bytecodeInfo.opcodes.clear();
+    memoryInfo.frameSize = static_cast<u32>(variableFrameSize);
+    memoryInfo.isNative = function->flags.nativeCall;
+}
+
+void Bytecode::GenerateStructParameterCopies(Module* module, Function* function)
+{
+    u32 parameterIndex = 0;
+
+    ListNode* node;
+    ListIterate(&function->scope->declarations, node)
+    {
+        Declaration* declaration = ListGetStructPtr(node, Declaration, listNode);
+        if (declaration->kind != Declaration::Kind::Variable)
+            continue;
+
+        u32 index = parameterIndex++;
+        if (declaration->type->kind != Type::Kind::Struct)
+            continue;
+
+        // Stack parameters only have room for the address
+        if (index >= RegisterAllocator::NumParameterRegisters)
+        {
+            module->lexerInfo.Error(declaration->token, "Structs can only be passed by value as one of the first %u parameters", RegisterAllocator::NumParameterRegisters);
+        }
+
+        // GenerateScopeVariableOffsets reserved room for the whole struct, the parameter register points at our copy from here on
+        Register reg = RegisterAllocator::ParameterRegisters[index];
+        Emit(module, LoadAddress(static_cast<i32>(declaration->variable.offset), Register::Rdi, true, false), "Struct Parameter Address");
+        Emit(module, MemCopy(reg, Register::Rdi, declaration->type->size), "Copy Struct Parameter");
+        Emit(module, MoveRToR(Register::Rdi, reg, 8, false), "Struct Parameter To Copy");
+    }
+}
+
+void Bytecode::GenerateFunctionCleanup(Module* module)
+{
+    // Returns can jump here with anything on the stack, so point Rsp back at the saved registers before popping them
+    if (_context->savedRegisters.size())
+    {
+        i32 savedRegistersOffset = static_cast<i32>(_context->frameSize + _context->savedRegisters.size() * 8);
+        Emit(module, LoadAddress(savedRegistersOffset, Register::Rsp, true, false), "Find Saved Registers");
+
+        for (auto itr = _context->savedRegisters.rbegin(); itr != _context->savedRegisters.rend(); itr++)
+        {
+            Emit(module, PopRegister(*itr), "Restore Local Register");
+        }
+    }
+
+    Emit(module, MoveRToR(Register::Rbp, Register::Rsp, 8, false), "Restore Rsp Stack");
+    Emit(module, PopRegister(Register::Rbp), "Restore Rbp");
+
+    // Undo the Rsp move over our stack arguments, our caller pops them itself
+    u8 extraParameterStackSpace = _context->paramInfo->extraParameterStackSpace;
+    if (extraParameterStackSpace > 0)
+    {
+        Emit(module, SubNToR(extraParameterStackSpace + 8, Register::Rsp, 8), "> 4 Parameters");
+    }
 }
 
 void Bytecode::GenerateStatement(Module* module, Statement* statement)
@@ -184,6 +467,13 @@ void Bytecode::GenerateStatement(Module* module, Statement* statement)
         {
             Return* ret = &statement->returnStmt;
 
+            // The callee's return value is already in Rax when it returns to our caller, there is nothing left for us to do
+            if (ret->expression && IsTailCall(module, ret->expression))
+            {
+                GenerateExpressionCall(module, ret->expression, true);
+                break;
+            }
+
             if (ret->expression)
             {
                 GenerateExpression(module, ret->expression);
@@ -206,9 +496,9 @@ void Bytecode::GenerateStatement(Module* module, Statement* statement)
         case Statement::Kind::Continue:
         case Statement::Kind::Break:
         {
-            LoopPath& loopPath = module->parserInfo.currentLoop->paths->emplace_back();
+            LoopPath& loopPath = _context->currentLoop->paths->emplace_back();
             loopPath.kind = statement->kind == Statement::Kind::Continue ? LoopPath::Kind::Continue : LoopPath::Kind::Break;
-            loopPath.opcodeDataIndex = module->bytecodeInfo.opcodes.size();
+            loopPath.opcodeDataIndex = _context->opcodes.GetSize();
 
             GenerateLoopPath(module, &loopPath);
             break;
@@ -285,13 +575,22 @@ void Bytecode::GenerateExpressionPrimary(Module* module, Expression* expression)
         case Primary::Kind::Identifier:
         {
             Register reg = GetParameterRegister(module, expression->primary.declaration);
-            
-            if (reg == Register::None)
+            Register localReg = GetLocalRegister(expression->primary.declaration);
+
+            if (localReg != Register::None)
+            {
+                Emit(module, MoveRToR(localReg, Register::Rax, 8, false), "Move Local To Rax");
+            }
+            else if (reg == Register::None)
             {
                 if (expression->type->IsPointer())
                 {
                     Emit(module, LoadAddress(static_cast<i32>(expression->primary.declaration->variable.offset), Register::Rax, true, true), "Load Variable Address");
                 }
+                else if (expression->type->kind == Type::Kind::Struct)
+                {
+                    Emit(module, LoadAddress(static_cast<i32>(expression->primary.declaration->variable.offset), Register::Rax, true, false), "Load Struct Address");
+                }
                 else
                 {
                     Emit(module, LoadRelative(static_cast<i32>(expression->primary.declaration->variable.offset), Register::Rax, static_cast<u8>(expression->primary.declaration->type->size)), "Load Variable");
@@ -306,9 +605,7 @@ void Bytecode::GenerateExpressionPrimary(Module* module, Expression* expression)
 
         case Primary::Kind::String:
         {
-            u16 strIndex = static_cast<u16>(module->bytecodeInfo.stringTable.AddString(*primary->string));
-            Emit(module, CreateStringOnHeap(strIndex));
-
+            GenerateString(module, primary->string);
             break;
         }
 
@@ -353,10 +650,59 @@ void Bytecode::GenerateExpressionBinary(Module* module, Expression* expression)
     assert(binary->left);
     assert(binary->right);
 
-    if (binary->kind == Binary::Kind::Assign)
+    if (binary->kind == Binary::Kind::LogicalAnd || binary->kind == Binary::Kind::LogicalOr)
     {
-        GenerateAddressInto(module, binary->left, Register::Rax, true);
-        Emit(module, PushRegister(Register::Rax));
+        // Only used as a value here, conditions branch on it directly in GenerateBranch
+        std::vector<PatchPoint> falseJumps;
+        GenerateBranch(module, expression, false, falseJumps);
+
+        Emit(module, MoveNToR(1, Register::Rax, 8, false), "Logical : True");
+        PatchPoint endJump = EmitJump(module, JumpAbsolute(0), "Logical : Skip False");
+
+        PatchJumps(module, falseJumps, static_cast<i32>(_context->opcodes.GetSize()));
+        Emit(module, MoveNToR(0, Register::Rax, 8, false), "Logical : False");
+
+        PatchJump(module, endJump, static_cast<i32>(_context->opcodes.GetSize()));
+    }
+    else if (binary->kind == Binary::Kind::Assign)
+    {
+        // Locals in registers have no address, the value is moved straight into the register
+        Register localReg = Register::None;
+        if (binary->left->kind == Expression::Kind::Primary)
+        {
+            localReg = GetLocalRegister(binary->left->primary.declaration);
+        }
+
+        if (localReg == Register::None)
+        {
+            GenerateAddressInto(module, binary->left, Register::Rax, true);
+            SaveTemporary(module);
+        }
+
+        Type* type = binary->left->type;
+        if (type->kind == Type::Kind::Struct)
+        {
+            Expression* right = binary->right;
+
+            if (right->kind == Expression::Kind::Primary && right->primary.kind == Primary::Kind::Number && right->primary.number == 0)
+            {
+                Register address = RestoreTemporary(module);
+                Emit(module, MemSet(address, 0, type->size), "Zero Struct");
+            }
+            else if (right->type == type)
+            {
+                GenerateExpression(module, right);
+
+                Register address = RestoreTemporary(module);
+                GenerateLoadFrom(module, type, Register::Rax, address, false, true);
+            }
+            else
+            {
+                module->lexerInfo.Error(binary->op, "Structs can only be assigned 0 or a struct of the same type");
+            }
+
+            return;
+        }
 
         if (binary->right->kind == Expression::Kind::MemoryNew)
         {
@@ -372,8 +718,15 @@ void Bytecode::GenerateExpressionBinary(Module* module, Expression* expression)
             GenerateExpression(module, binary->right);
         }
 
-        Emit(module, PopRegister(Register::Rdi));
-        GenerateLoadFrom(module, expression->type, Register::Rax, Register::Rdi, false, true);
+        if (localReg != Register::None)
+        {
+            Emit(module, MoveRToR(Register::Rax, localReg, 8, false), "Move Rax To Local");
+        }
+        else
+        {
+            Register address = RestoreTemporary(module);
+            GenerateLoadFrom(module, expression->type, Register::Rax, address, false, true);
+        }
     }
     else
     {
@@ -392,65 +745,65 @@ void Bytecode::GenerateExpressionBinary(Module* module, Expression* expression)
             size = 8;
 
         GenerateExpression(module, binary->right);
-        Emit(module, PushRegister(Register::Rax));
+        SaveTemporary(module);
         GenerateExpression(module, binary->left);
-        Emit(module, PopRegister(Register::Rdi));
+        Register right = RestoreTemporary(module);
 
         switch (binary->kind)
         {
             case Binary::Kind::Add:
             {
-                Emit(module, AddRToR(Register::Rdi, Register::Rax, static_cast<u8>(binary->left->type->size)));
+                Emit(module, AddRToR(right, Register::Rax, static_cast<u8>(binary->left->type->size)));
                 break;
             }
             case Binary::Kind::Subtract:
             {
-                Emit(module, SubRToR(Register::Rdi, Register::Rax, static_cast<u8>(binary->left->type->size)));
+                Emit(module, SubRToR(right, Register::Rax, static_cast<u8>(binary->left->type->size)));
                 break;
             }
             case Binary::Kind::Multiply:
             {
-                Emit(module, MulRToR(Register::Rdi, Register::Rax, static_cast<u8>(binary->left->type->size)));
+                Emit(module, MulRToR(right, Register::Rax, static_cast<u8>(binary->left->type->size)));
                 break;
             }
             case Binary::Kind::Divide:
             {
-                Emit(module, DivRToR(Register::Rdi, Register::Rax, static_cast<u8>(binary->left->type->size)));
+                Emit(module, DivRToR(right, Register::Rax, static_cast<u8>(binary->left->type->size)));
                 break;
             }
             case Binary::Kind::Modulo:
             {
-                Emit(module, ModuloRToR(Register::Rdi, Register::Rax, static_cast<u8>(binary->left->type->size)));
+                Emit(module, ModuloRToR(right, Register::Rax, static_cast<u8>(binary->left->type->size)));
                 break;
             }
             case Binary::Kind::Equal:
             {
-                Emit(module, CmpE_RToR(Register::Rdi, Register::Rax, static_cast<u8>(binary->left->type->size)));
+                Emit(module, CmpE_RToR(right, Register::Rax, static_cast<u8>(binary->left->type->size)));
                 break;
             }
             case Binary::Kind::NotEqual:
             {
-                Emit(module, CmpNE_RToR(Register::Rdi, Register::Rax, static_cast<u8>(binary->left->type->size)));
+                Emit(module, CmpNE_RToR(right, Register::Rax, static_cast<u8>(binary->left->type->size)));
                 break;
             }
             case Binary::Kind::LessThan:
             {
-                Emit(module, CmpL_RToR(Register::Rdi, Register::Rax, static_cast<u8>(binary->left->type->size)));
+                Emit(module, CmpL_RToR(right, Register::Rax, static_cast<u8>(binary->left->type->size)));
                 break;
             }
             case Binary::Kind::LessEqual:
             {
-                Emit(module, CmpLE_RToR(Register::Rdi, Register::Rax, static_cast<u8>(binary->left->type->size)));
+                Emit(module, CmpLE_RToR(right, Register::Rax, static_cast<u8>(binary->left->type->size)));
                 break;
             }
             case Binary::Kind::GreaterThan:
             {
-                Emit(module, CmpG_RToR(Register::Rdi, Register::Rax, static_cast<u8>(binary->left->type->size)));
+                Emit(module, CmpG_RToR(right, Register::Rax, static_cast<u8>(binary->left->type->size)));
                 break;
             }
             case Binary::Kind::GreaterEqual:
             {
-                Emit(module, CmpGE_RToR(Register::Rdi, Register::Rax, static_cast<u8>(binary->left->type->size)));
+                Emit(module, CmpGE_RToR(right, Register::Rax, static_cast<u8>(binary->left->type->size)));
                 break;
             }
 
@@ -463,7 +816,7 @@ void Bytecode::GenerateExpressionBinary(Module* module, Expression* expression)
     }
 }
 
-void Bytecode::GenerateExpressionCall(Module* module, Expression* expression)
+void Bytecode::GenerateExpressionCall(Module* module, Expression* expression, bool isTailCall)
 {
     // Iterate all arguments
     //  - Generate Expression
@@ -480,47 +833,29 @@ void Bytecode::GenerateExpressionCall(Module* module, Expression* expression)
         argumentCount++;
     }
 
-    Function* function = module->bytecodeInfo.currentFunction;
-    u64 numVariablesInCurrentFunc = 0;
+    // Parameter registers are caller saved, only the ones read after the call or already holding an argument of an enclosing call need to survive it
+    u8 pendingArguments = _context->pendingArguments;
+    u8 savedParameters = _context->liveParameters[expression] | pendingArguments;
 
-    ListIterate(&function->scope->declarations, node)
+    for (u32 i = 0; i < RegisterAllocator::NumParameterRegisters; i++)
     {
-        Declaration* declaration = ListGetStructPtr(node, Declaration, listNode);
-        if (declaration->kind == Declaration::Kind::Variable)
+        if (savedParameters & (1 << i))
         {
-            if (++numVariablesInCurrentFunc == 4)
-                break;
+            Emit(module, PushRegister(RegisterAllocator::ParameterRegisters[i]), "Save Parameter");
         }
     }
 
-    // Save Parameters in current func before calling next
-    for (u64 i = 0; i < numVariablesInCurrentFunc; i++)
+    // Temporaries are caller saved, the arguments and the callee are free to use all of them
+    u32 numTemporaries = _context->numTemporaries;
+    u32 numSavedTemporaries = std::min(numTemporaries, RegisterAllocator::NumTemporaryRegisters);
+
+    for (u32 i = 0; i < numSavedTemporaries; i++)
     {
-        switch (i)
-        {
-            case 0:
-            {
-                Emit(module, PushRegister(Register::Rcx), "Save Parameter Rcx");
-                break;
-            }
-            case 1:
-            {
-                Emit(module, PushRegister(Register::Rdx), "Save Parameter Rdx");
-                break;
-            }
-            case 2:
-            {
-                Emit(module, PushRegister(Register::R8), "Save Parameter R8");
-                break;
-            }
-            case 3:
-            {
-                Emit(module, PushRegister(Register::R9), "Save Parameter R9");
-                break;
-            }
-        }
+        Emit(module, PushRegister(RegisterAllocator::TemporaryRegisters[i]), "Save Temporary");
     }
 
+    _context->numTemporaries = 0;
+
     // If we have more than 4 arguments, we need to push extra space for RBP
     if (argumentCount > 4)
     {
@@ -540,38 +875,62 @@ void Bytecode::GenerateExpressionCall(Module* module, Expression* expression)
             {
                 // Move Rax -> Rcx
                 Emit(module, MoveRToR(Register::Rax, Register::Rcx, 8, false), "Arg1 -> Rcx");
+                _context->pendingArguments |= 1 << 0;
                 break;
             }
             case 1:
             {
                 // Move Rax -> Rdx
                 Emit(module, MoveRToR(Register::Rax, Register::Rdx, 8, false), "Arg2 -> Rdx");
+                _context->pendingArguments |= 1 << 1;
                 break;
             }
             case 2:
             {
                 // Move Rax -> R8
                 Emit(module, MoveRToR(Register::Rax, Register::R8, 8, false), "Arg3 -> R8");
+                _context->pendingArguments |= 1 << 2;
                 break;
             }
             case 3:
             {
                 // Move Rax -> R9
                 Emit(module, MoveRToR(Register::Rax, Register::R9, 8, false), "Arg4 -> R9");
+                _context->pendingArguments |= 1 << 3;
                 break;
             }
 
             default:
             {
-                numPushedBytes += expr->type->size;
+                numPushedBytes += 8;
                 Emit(module, PushRegister(Register::Rax), "Push argument");
                 break;
             }
         }
     }
-    
+
+    if (isTailCall)
+    {
+        // Nothing was saved and nothing was pushed, so once our frame is gone the callee sees the stack our caller left
+        assert(savedParameters == 0 && numSavedTemporaries == 0 && numPushedBytes == 0);
+
+        GenerateFunctionCleanup(module);
+        Emit(module, TailCall(call->token->nameHash.hash), "Tail Call Function");
+
+        _context->numTemporaries = numTemporaries;
+        _context->pendingArguments = pendingArguments;
+        return;
+    }
+
     // Generate Call Instruction
-    Emit(module, FunctionCall(call->token->nameHash.hash), "Call Function");
+    if (IsIntrinsic(module, call->token->nameHash.hash))
+    {
+        GenerateIntrinsic(module, call->token->nameHash.hash);
+    }
+    else
+    {
+        Emit(module, FunctionCall(call->token->nameHash.hash), "Call Function");
+    }
 
     if (numPushedBytes > 0)
     {
@@ -579,31 +938,95 @@ void Bytecode::GenerateExpressionCall(Module* module, Expression* expression)
         Emit(module, PopNoRegister(static_cast<u8>(numPushedBytes)), "Pop Pushed Argument");
     }
 
-    // Restore Parameters in current func before calling next
-    for (u64 i = 0; i < numVariablesInCurrentFunc; i++)
+    for (u32 i = numSavedTemporaries; i > 0; i--)
     {
-        switch (i)
+        Emit(module, PopRegister(RegisterAllocator::TemporaryRegisters[i - 1]), "Restore Temporary");
+    }
+
+    _context->numTemporaries = numTemporaries;
+
+    for (u32 i = RegisterAllocator::NumParameterRegisters; i > 0; i--)
+    {
+        if (savedParameters & (1 << (i - 1)))
         {
-            case 0:
-            {
-                Emit(module, PopRegister(Register::Rcx), "Restore Parameter Rcx");
-                break;
-            }
-            case 1:
-            {
-                Emit(module, PopRegister(Register::Rdx), "Restore Parameter Rdx");
-                break;
-            }
-            case 2:
-            {
-                Emit(module, PopRegister(Register::R8), "Restore Parameter R8");
-                break;
-            }
-            case 3:
-            {
-                Emit(module, PopRegister(Register::R9), "Restore Parameter R9");
-                break;
-            }
+            Emit(module, PopRegister(RegisterAllocator::ParameterRegisters[i - 1]), "Restore Parameter");
+        }
+    }
+
+    _context->pendingArguments = pendingArguments;
+}
+
+bool Bytecode::IsTailCall(Module* module, Expression* expression)
+{
+    if (expression->kind != Expression::Kind::Call)
+        return false;
+
+    // Intrinsics never leave our frame, the return still needs its JumpFunctionEnd
+    if (IsIntrinsic(module, expression->call.token->nameHash.hash))
+        return false;
+
+    // Arguments past the fourth live in the frame of the callee, which would be on top of ours
+    u32 argumentCount = 0;
+
+    ListNode* node;
+    ListIterate(&expression->call.arguments, node)
+    {
+        argumentCount++;
+    }
+
+    if (argumentCount > RegisterAllocator::NumParameterRegisters)
+        return false;
+
+    // The callee would be handed pointers into a frame we already freed
+    if (_context->isFrameAddressTaken)
+        return false;
+
+    // Structs are passed by the address of our copy of them
+    ListIterate(&expression->call.arguments, node)
+    {
+        Expression* argument = ListGetStructPtr(node, Expression, listNode);
+        if (argument->type->kind == Type::Kind::Struct)
+            return false;
+    }
+
+    // A return sits outside of any other expression, so only the live parameters could need saving around the call
+    auto itr = _context->liveParameters.find(expression);
+    if (itr != _context->liveParameters.end() && itr->second != 0)
+        return false;
+
+    return _context->pendingArguments == 0 && _context->numTemporaries == 0;
+}
+
+bool Bytecode::IsIntrinsic(Module* module, u32 callHash)
+{
+    auto itr = module->bytecodeInfo.functionHashToDeclaration.find(callHash);
+    if (itr == module->bytecodeInfo.functionHashToDeclaration.end())
+        return false;
+
+    return itr->second->function.flags.intrinsic;
+}
+
+void Bytecode::GenerateIntrinsic(Module* module, u32 callHash)
+{
+    switch (callHash)
+    {
+        case "MemCopy"_djb2:
+        {
+            // MemCopy(destination, source, size)
+            Emit(module, MemCopy(Register::Rdx, Register::Rcx, Register::R8), "Intrinsic : MemCopy");
+            break;
+        }
+        case "MemSet"_djb2:
+        {
+            // MemSet(destination, value, size)
+            Emit(module, MemSet(Register::Rcx, Register::Rdx, Register::R8), "Intrinsic : MemSet");
+            break;
+        }
+
+        default:
+        {
+            DebugHandler::PrintError("Bytecode : Unhandled Intrinsic(%u)", callHash);
+            exit(1);
         }
     }
 }
@@ -632,49 +1055,138 @@ void Bytecode::GenerateExpressionDot(Module* module, Expression* expression)
     GenerateLoadFrom(module, expression->type, Register::Rax, Register::Rax, true, false);
 }
 
+void Bytecode::GenerateBranch(Module* module, Expression* condition, bool jumpIf, std::vector<PatchPoint>& jumps)
+{
+    // A condition the Folder reduced to a number either always jumps or never does
+    if (condition->kind == Expression::Kind::Primary && condition->primary.kind == Primary::Kind::Number)
+    {
+        if ((condition->primary.number != 0) == jumpIf)
+        {
+            jumps.push_back(EmitJump(module, JumpAbsolute(0), "Branch : Always"));
+        }
+
+        return;
+    }
+
+    if (condition->kind == Expression::Kind::Binary)
+    {
+        Binary* binary = &condition->binary;
+
+        switch (binary->kind)
+        {
+            case Binary::Kind::LogicalAnd:
+            case Binary::Kind::LogicalOr:
+            {
+                // && is decided by a false left hand side and || by a true one
+                bool decidedBy = binary->kind == Binary::Kind::LogicalOr;
+
+                if (decidedBy == jumpIf)
+                {
+                    GenerateBranch(module, binary->left, jumpIf, jumps);
+                    GenerateBranch(module, binary->right, jumpIf, jumps);
+                }
+                else
+                {
+                    // The left hand side deciding the result means the jump is not taken, so it skips the right hand side instead
+                    std::vector<PatchPoint> skipJumps;
+                    GenerateBranch(module, binary->left, decidedBy, skipJumps);
+                    GenerateBranch(module, binary->right, jumpIf, jumps);
+
+                    PatchJumps(module, skipJumps, static_cast<i32>(_context->opcodes.GetSize()));
+                }
+
+                return;
+            }
+
+            case Binary::Kind::Equal:
+            case Binary::Kind::NotEqual:
+            case Binary::Kind::LessThan:
+            case Binary::Kind::LessEqual:
+            case Binary::Kind::GreaterThan:
+            case Binary::Kind::GreaterEqual:
+            {
+                // The compare is the last opcode GenerateExpressionBinary emits, the flag it sets is the result
+                GenerateExpressionBinary(module, condition);
+
+                jumps.push_back(EmitJump(module, JumpAbsolute(0, true, jumpIf), "Branch : Compare Jump"));
+                return;
+            }
+
+            default:
+            {
+                break;
+            }
+        }
+    }
+
+    GenerateExpression(module, condition);
+    Emit(module, CmpLE_NToR(0, Register::Rax, static_cast<u8>(condition->type->size)), "Branch : Compare Zero");
+
+    // The compare sets the flag when the value is zero, which is when the condition is false
+    jumps.push_back(EmitJump(module, JumpAbsolute(0, true, !jumpIf), "Branch : Jump"));
+}
+
+PatchPoint Bytecode::EmitJump(Module* module, const JumpAbsolute& opcode, StringView comment)
+{
+    PatchPoint patchPoint;
+    patchPoint.offset = Emit(module, opcode, comment);
+
+    return patchPoint;
+}
+
+void Bytecode::PatchJump(Module* /*module*/, PatchPoint patchPoint, i32 address)
+{
+    _context->opcodes.PatchJump(patchPoint, address);
+}
+
+void Bytecode::PatchJumps(Module* module, const std::vector<PatchPoint>& patchPoints, i32 address)
+{
+    for (PatchPoint patchPoint : patchPoints)
+    {
+        PatchJump(module, patchPoint, address);
+    }
+}
+
 void Bytecode::GenerateConditional(Module* module, Conditional* conditional)
 {
-    GenerateExpression(module, conditional->condition);
-    Emit(module, CmpLE_NToR(0, Register::Rax, static_cast<u8>(conditional->condition->type->size)), "If True Compare");
+    // The Folder reduced the condition to a number, only the body that would run is generated
+    Expression* condition = conditional->condition;
+    if (condition->kind == Expression::Kind::Primary && condition->primary.kind == Primary::Kind::Number)
+    {
+        if (condition->primary.number)
+        {
+            GenerateStatement(module, conditional->trueBody);
+        }
+        else if (conditional->falseBody)
+        {
+            GenerateStatement(module, conditional->falseBody);
+        }
+
+        return;
+    }
 
-    // The first jump should always go to the start of "falseBody", if there is no "falseBody" we will simply go out of the if
-    i64 firstJumpOpcodeIndex = module->bytecodeInfo.opcodes.size();
-    Emit(module, JumpAbsolute(0, true, true), "Condition : Skip True Body");
+    // These jumps should always go to the start of "falseBody", if there is no "falseBody" we will simply go out of the if
+    std::vector<PatchPoint> falseJumps;
+    GenerateBranch(module, conditional->condition, false, falseJumps);
 
     GenerateStatement(module, conditional->trueBody);
 
     if (conditional->falseBody)
     {
         // This JMP exists so that we can skip the "falseBody" if we entered the "trueBody"
-        i64 secondJumpOpcodeIndex = module->bytecodeInfo.opcodes.size();
-        Emit(module, JumpAbsolute(0), "Condition : Skip False Body");
+        PatchPoint skipFalseJump = EmitJump(module, JumpAbsolute(0), "Condition : Skip False Body");
 
         // Skip the JMP above if we jumped here from failing the initial conditional check for the if
-        {
-            i32 startOfFalseBodyIndex = static_cast<i32>(module->bytecodeInfo.opcodes.size());
-
-            JumpAbsolute* jumpAbsolute = reinterpret_cast<JumpAbsolute*>(&module->bytecodeInfo.opcodes[firstJumpOpcodeIndex]);
-            jumpAbsolute->address = startOfFalseBodyIndex;
-        }
+        PatchJumps(module, falseJumps, static_cast<i32>(_context->opcodes.GetSize()));
 
         GenerateStatement(module, conditional->falseBody);
 
         // Correct the value stored by the second Jmp Opcode
-        {
-            i32 endOfConditionIndex = static_cast<i32>(module->bytecodeInfo.opcodes.size());
-
-            JumpAbsolute* jumpAbsolute = reinterpret_cast<JumpAbsolute*>(&module->bytecodeInfo.opcodes[secondJumpOpcodeIndex]);
-            jumpAbsolute->address = endOfConditionIndex;
-        }
+        PatchJump(module, skipFalseJump, static_cast<i32>(_context->opcodes.GetSize()));
     }
     else
     {
-        // Correct the value stored by the first Jmp Opcode
-        {
-            i32 endOfConditionIndex = static_cast<i32>(module->bytecodeInfo.opcodes.size());
-            JumpAbsolute* jumpAbsolute = reinterpret_cast<JumpAbsolute*>(&module->bytecodeInfo.opcodes[firstJumpOpcodeIndex]);
-            jumpAbsolute->address = endOfConditionIndex;
-        }
+        PatchJumps(module, falseJumps, static_cast<i32>(_context->opcodes.GetSize()));
     }
 }
 
@@ -684,39 +1196,42 @@ void Bytecode::GenerateLoop(Module* module, Loop* loop)
     {
         loop->paths = new std::vector<LoopPath>();
 
-        i32 startOfLoopIndex = static_cast<i32>(module->bytecodeInfo.opcodes.size());
-        GenerateExpression(module, loop->condition);
-        Emit(module, CmpLE_NToR(0, Register::Rax, static_cast<u8>(loop->condition->type->size)), "Loop Compare");
+        i32 startOfLoopIndex = static_cast<i32>(_context->opcodes.GetSize());
+
+        // A condition the Folder reduced to a non zero number never exits, the loop can only be left through a break
+        Expression* condition = loop->condition;
+        bool isAlwaysTrue = condition->kind == Expression::Kind::Primary && condition->primary.kind == Primary::Kind::Number && condition->primary.number;
 
         // Jump past the body if condition isn't met
-        i32 endJumpOpcodeIndex = static_cast<i32>(module->bytecodeInfo.opcodes.size());
-        Emit(module, JumpAbsolute(0, true, true), "Loop : Exit Jump");
+        std::vector<PatchPoint> exitJumps;
+        if (!isAlwaysTrue)
+        {
+            GenerateBranch(module, loop->condition, false, exitJumps);
+        }
 
         GenerateStatement(module, loop->body);
 
         // Jump to the start of the loop to re evalute the condition
         Emit(module, JumpAbsolute(startOfLoopIndex), "Loop : Start Jump");
-        i32 endOfLoopIndex = static_cast<i32>(module->bytecodeInfo.opcodes.size());
+        i32 endOfLoopIndex = static_cast<i32>(_context->opcodes.GetSize());
 
-        // Correct the value stored by the first Jmp Opcode
-        {
-            JumpAbsolute* jumpAbsolute = reinterpret_cast<JumpAbsolute*>(&module->bytecodeInfo.opcodes[endJumpOpcodeIndex]);
-            jumpAbsolute->address = endOfLoopIndex;
-        }
+        PatchJumps(module, exitJumps, endOfLoopIndex);
 
         // Correct the value stored by all (continue/break) paths
         for (u32 i = 0; i < loop->paths->size(); i++)
         {
             const LoopPath& loopPath = loop->paths->at(i);
 
-            JumpAbsolute* jumpAbsolute = reinterpret_cast<JumpAbsolute*>(&module->bytecodeInfo.opcodes[loopPath.opcodeDataIndex]);
+            PatchPoint patchPoint;
+            patchPoint.offset = static_cast<u32>(loopPath.opcodeDataIndex);
+
             if (loopPath.kind == LoopPath::Kind::Continue)
             {
-                jumpAbsolute->address = startOfLoopIndex;
+                PatchJump(module, patchPoint, startOfLoopIndex);
             }
             else if (loopPath.kind == LoopPath::Kind::Break)
             {
-                jumpAbsolute->address = endOfLoopIndex;
+                PatchJump(module, patchPoint, endOfLoopIndex);
             }
         }
     }
@@ -778,12 +1293,12 @@ i64 Bytecode::GenerateFunctionVariableOffsets(Module* module, Scope* scope)
     return variableStackSize;
 }
 
-Register Bytecode::GetParameterRegister(Module* module, Declaration* decl)
+Register Bytecode::GetParameterRegister(Module* /*module*/, Declaration* decl)
 {
-    assert(module->bytecodeInfo.currentFunction);
+    assert(_context->currentFunction);
     assert(decl && decl->kind == Declaration::Kind::Variable);
 
-    Scope* currentFnScope = module->bytecodeInfo.currentFunction->scope;
+    Scope* currentFnScope = _context->currentFunction->scope;
 
     ListNode* node;
     u64 parameterCount = 0;
@@ -817,6 +1332,52 @@ Register Bytecode::GetParameterRegister(Module* module, Declaration* decl)
     return Register::None;
 }
 
+Register Bytecode::GetLocalRegister(Declaration* declaration)
+{
+    auto itr = _context->localRegisters.find(declaration);
+    if (itr == _context->localRegisters.end())
+        return Register::None;
+
+    return itr->second;
+}
+
+void Bytecode::SaveTemporary(Module* module)
+{
+    u32 index = _context->numTemporaries++;
+
+    if (index < RegisterAllocator::NumTemporaryRegisters)
+    {
+        Emit(module, MoveRToR(Register::Rax, RegisterAllocator::TemporaryRegisters[index], 8, false), "Rax To Temporary");
+    }
+    else
+    {
+        // Nested deeper than we have temporaries for
+        Emit(module, PushRegister(Register::Rax), "Spill Temporary");
+    }
+}
+
+Register Bytecode::RestoreTemporary(Module* module)
+{
+    assert(_context->numTemporaries > 0);
+    u32 index = --_context->numTemporaries;
+
+    if (index < RegisterAllocator::NumTemporaryRegisters)
+        return RegisterAllocator::TemporaryRegisters[index];
+
+    Emit(module, PopRegister(Register::Rdi), "Reload Temporary");
+    return Register::Rdi;
+}
+
+void Bytecode::GenerateString(Module* module, String* string)
+{
+    // Index into the context's strings until LinkFunction adds it to the module's StringTable
+    u16 strIndex = static_cast<u16>(_context->strings.size());
+    _context->strings.push_back(string);
+    _context->stringOpcodeIndices.push_back(_context->opcodes.GetSize());
+
+    Emit(module, CreateStringOnHeap(strIndex));
+}
+
 void Bytecode::GenerateScopeVariableOffsets(Module* module, Scope* scope, i64& offset)
 {
     assert(scope);
@@ -833,11 +1394,8 @@ void Bytecode::GenerateScopeVariableOffsets(Module* module, Scope* scope, i64& o
                 numParameters++;
         }
 
-        Declaration* currFuncDecl = reinterpret_cast<Declaration*>(module->bytecodeInfo.currentFunction);
-        u32 fnHash = currFuncDecl->token->nameHash.hash;
-
-        FunctionParamInfo& paramInfo = module->bytecodeInfo.functionHashToParamInfo[fnHash];
-        paramInfo.declarations.resize(numParameters);
+        FunctionParamInfo& paramInfo = *_context->paramInfo;
+        paramInfo.parameterOffsets.resize(numParameters);
 
         ListIterateReverse(&scope->declarations, node)
         {
@@ -847,7 +1405,7 @@ void Bytecode::GenerateScopeVariableOffsets(Module* module, Scope* scope, i64& o
                 assert(declaration->type);
                 Type* type = declaration->type;
 
-                paramInfo.declarations[numParameters - 1] = declaration;
+                u32 parameterIndex = numParameters - 1;
 
                 if (numParameters-- <= 4)
                 {
@@ -861,6 +1419,7 @@ void Bytecode::GenerateScopeVariableOffsets(Module* module, Scope* scope, i64& o
                 }
 
                 declaration->variable.offset = offset;
+                paramInfo.parameterOffsets[parameterIndex] = offset;
 
 #if NAI_DEBUG
                 DebugHandler::PrintSuccess("Placed Variable(%.*s) at Offset(%d)", declaration->token->nameHash.length, declaration->token->nameHash.name, declaration->variable.offset);
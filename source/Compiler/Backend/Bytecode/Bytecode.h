@@ -1,8 +1,11 @@
 #pragma once
 #include "pch/Build.h"
 #include "ByteOpcode.h"
+#include "CodeBuffer.h"
+#include <vector>
 
 struct Module;
+struct BytecodeContext;
 struct ByteOpcode;
 struct Scope;
 struct Type;
@@ -14,36 +17,34 @@ struct LoopPath;
 struct Declaration;
 struct Function;
 struct Variable;
+struct IRFunction;
+struct IRBlock;
+struct IRInstruction;
+struct PhiCopy;
 
 class Bytecode
 {
 public:
     static void Process(Module* module);
+
+    // Generates the given functions and relinks them with the existing code of every other function in the module
+    static void Process(Module* module, const std::vector<Declaration*>& declarations);
+
+    // Prints every instruction with the comment it was generated with, needs BytecodeInfo::recordComments set before Process
+    static void PrintDisassembly(Module* module);
     
 private:
+    // Returns the offset of the instruction within the function
     template <typename T>
-    static void Emit(Module* module, T opcode, String comment = "")
+    static u32 Emit(Module* /*module*/, const T& opcode, StringView comment = StringView())
     {
-        size_t size = module->bytecodeInfo.opcodes.size();
-        size_t newSize = size + sizeof(T);
-        if (newSize > size)
-        {
-            module->bytecodeInfo.opcodes.resize(newSize);
-        }
-
-        // Trick to keep Release from giving a warning about comment being unused
-        u32 commentLength = static_cast<u32>(comment.length());
-        assert(commentLength < 32);
-
-#if NAI_DEBUG
-        if (commentLength > 0)
-        {
-            memcpy(&opcode.comment[0], comment.data(), commentLength);
-        }
-#endif // NAI_DEBUG
-
-        memcpy(&module->bytecodeInfo.opcodes[size], &opcode, sizeof(T));
+        return _context->opcodes.Append(opcode, comment);
     }
+
+    // Same as Emit, for a jump that gets its address from PatchJump once the target is known
+    static PatchPoint EmitJump(Module* module, const JumpAbsolute& opcode, StringView comment);
+    static void PatchJump(Module* module, PatchPoint patchPoint, i32 address);
+    static void PatchJumps(Module* module, const std::vector<PatchPoint>& patchPoints, i32 address);
     
     template <typename T>
     static size_t EmitData(Module* module, u8* data, size_t length)
@@ -59,23 +60,39 @@ private:
         return size;
     }
 
+    static void LinkFunction(Module* module, BytecodeContext* context);
+
     static void EnterLoop(Module* module, Loop* loop);
     static void ExitLoop(Module* module);
 
     static void GenerateLoadFrom(Module* module, Type* type, Register sourceRegister, Register destinationRegister, bool isSourceAddress, bool isDestinationAddress);
     static void GenerateAddressInto(Module* module, Expression* expression, Register reg, bool loadAddress);
 
-    static void GenerateScope(Module* module, Scope* scope);
     static void GenerateFunction(Module* module, Function* function);
+
+    // Structs are passed as the address of the caller's value, the callee copies them into its frame so the caller's value is never written
+    static void GenerateStructParameterCopies(Module* module, Function* function);
+
+    // Restores the saved registers, Rsp and Rbp, leaving the stack the way the caller handed it to us
+    static void GenerateFunctionCleanup(Module* module);
     static void GenerateStatement(Module* module, Statement* statement);
     static void GenerateExpression(Module* module, Expression* expression);
     static void GenerateExpressionPrimary(Module* module, Expression* expression);
     static void GenerateExpressionUnary(Module* module, Expression* expression);
     static void GenerateExpressionBinary(Module* module, Expression* expression);
-    static void GenerateExpressionCall(Module* module, Expression* expression);
+    static void GenerateExpressionCall(Module* module, Expression* expression, bool isTailCall = false);
+    static bool IsTailCall(Module* module, Expression* expression);
+
+    // Intrinsics take their arguments in the parameter registers like any call but run as a single opcode
+    static bool IsIntrinsic(Module* module, u32 callHash);
+    static void GenerateIntrinsic(Module* module, u32 callHash);
     static void GenerateExpressionMemoryNew(Module* module, Expression* expression, size_t typeSize);
     static void GenerateExpressionMemoryFree(Module* module, Expression* expression);
     static void GenerateExpressionDot(Module* module, Expression* expression);
+
+    // Emits jumps taken when the condition evaluates to jumpIf, their indices are added to jumps for the caller to patch
+    // Comparisons jump on the flag they set and && and || short circuit, so no boolean is materialized along the way
+    static void GenerateBranch(Module* module, Expression* condition, bool jumpIf, std::vector<PatchPoint>& jumps);
     static void GenerateConditional(Module* module, Conditional* conditional);
     static void GenerateLoop(Module* module, Loop* loop);
     static void GenerateLoopPath(Module* module, LoopPath* loopPath);
@@ -84,5 +101,32 @@ private:
     static u64 GetAllocationAlignment(u64 number, u64 alignment);
     static i64 GenerateFunctionVariableOffsets(Module* module, Scope* scope);
     static Register GetParameterRegister(Module* module, Declaration* declaration);
+    static Register GetLocalRegister(Declaration* declaration);
+
+    // Holds Rax while another expression is generated, RestoreTemporary returns the register the value can be read from
+    static void SaveTemporary(Module* module);
+    static Register RestoreTemporary(Module* module);
+
     static void GenerateScopeVariableOffsets(Module* module, Scope* scope, i64& offset);
+    static void GenerateString(Module* module, String* string);
+
+    // Lowering from the IR, values the RegisterAllocator couldn't keep in a register get a slot in the frame past the variables
+    static u64 AssignSlots(IRFunction* function, u64 frameSize);
+    static void LowerFunction(Module* module, IRFunction* function);
+    static void LowerInstruction(Module* module, IRInstruction* instruction);
+    static void LowerCall(Module* module, IRInstruction* instruction, bool isTailCall);
+    static bool IsTailCall(Module* module, IRInstruction* instruction, IRInstruction* next);
+    static bool IsFrameAddressTaken(IRFunction* function);
+    static void LowerTerminator(Module* module, IRInstruction* instruction, IRBlock* nextBlock);
+    static void LowerPhiCopies(Module* module, IRBlock* block);
+    static void LowerPhiCopy(Module* module, const PhiCopy& copy);
+    static bool IsSameHome(IRInstruction* a, IRInstruction* b);
+    static void LowerJump(Module* module, IRBlock* target, bool isConditional, bool condition, StringView comment);
+    static void LoadValue(Module* module, IRInstruction* value, Register reg);
+    static void StoreValue(Module* module, IRInstruction* value, Register reg);
+    static void StoreSlot(Module* module, i32 slot, Register reg);
+
+private:
+    // Functions are generated on worker threads, each with its own context
+    static thread_local BytecodeContext* _context;
 };
\ No newline at end of file
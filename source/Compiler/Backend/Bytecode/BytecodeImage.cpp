@@ -0,0 +1,288 @@
+#include "pch/Build.h"
+#include "BytecodeImage.h"
+#include "../../Module.h"
+#include "BytecodeVerifier.h"
+#include "Utils/MappedFile.h"
+
+#include <algorithm>
+#include <fstream>
+#include <vector>
+
+bool BytecodeImage::Save(Module* module, const std::string& path)
+{
+    BytecodeInfo& bytecodeInfo = module->bytecodeInfo;
+    assert(!bytecodeInfo.image);
+
+    std::vector<BytecodeImageFunction> functions;
+    std::vector<BytecodeImageNativeImport> nativeImports;
+    std::vector<i64> parameterOffsets;
+    std::vector<BytecodeImageString> strings;
+    std::string stringData;
+
+    for (u32 i = 0; i < bytecodeInfo.stringTable.GetNumStrings(); i++)
+    {
+        const std::string& string = bytecodeInfo.stringTable.GetString(i);
+
+        BytecodeImageString& imageString = strings.emplace_back();
+        imageString.offset = static_cast<u32>(stringData.size());
+        imageString.length = static_cast<u32>(string.length());
+
+        stringData += string;
+    }
+
+    // Sorted so the same module always produces the same image
+    std::vector<u32> functionHashes;
+    for (auto& itr : bytecodeInfo.functionHashToMemoryInfo)
+    {
+        functionHashes.push_back(itr.first);
+    }
+
+    std::sort(functionHashes.begin(), functionHashes.end());
+
+    for (u32 functionHash : functionHashes)
+    {
+        FunctionMemoryInfo& memoryInfo = bytecodeInfo.functionHashToMemoryInfo[functionHash];
+        FunctionParamInfo& paramInfo = bytecodeInfo.functionHashToParamInfo[functionHash];
+
+        u32 firstParameterOffset = static_cast<u32>(parameterOffsets.size());
+        parameterOffsets.insert(parameterOffsets.end(), paramInfo.parameterOffsets.begin(), paramInfo.parameterOffsets.end());
+
+        if (memoryInfo.isNative)
+        {
+            Declaration* declaration = bytecodeInfo.functionHashToDeclaration[functionHash];
+            NameHashView& nameHash = declaration->token->nameHash;
+
+            BytecodeImageNativeImport& nativeImport = nativeImports.emplace_back();
+            nativeImport.hash = functionHash;
+            nativeImport.nameOffset = static_cast<u32>(stringData.size());
+            nativeImport.nameLength = nameHash.length;
+            nativeImport.extraParameterStackSpace = paramInfo.extraParameterStackSpace;
+            nativeImport.firstParameterOffset = firstParameterOffset;
+            nativeImport.numParameters = static_cast<u32>(paramInfo.parameterOffsets.size());
+
+            stringData.append(nameHash.name, nameHash.length);
+        }
+        else
+        {
+            BytecodeImageFunction& function = functions.emplace_back();
+            function.hash = functionHash;
+            function.codeOffset = static_cast<u32>(memoryInfo.instructions - bytecodeInfo.opcodes.data());
+            function.numInstructionBytes = memoryInfo.numInstructionBytes;
+            function.cleanupAddress = memoryInfo.cleanupAddress;
+            function.frameSize = memoryInfo.frameSize;
+            function.extraParameterStackSpace = paramInfo.extraParameterStackSpace;
+            function.firstParameterOffset = firstParameterOffset;
+            function.numParameters = static_cast<u32>(paramInfo.parameterOffsets.size());
+        }
+    }
+
+    std::vector<u8> buffer;
+    auto Append = [&buffer](const void* data, size_t size) -> u64
+    {
+        // Every section starts 16 byte aligned relative to the start of the file
+        buffer.resize((buffer.size() + 15) & ~static_cast<size_t>(15));
+
+        u64 offset = buffer.size();
+        buffer.insert(buffer.end(), static_cast<const u8*>(data), static_cast<const u8*>(data) + size);
+
+        return offset;
+    };
+
+    BytecodeImageHeader header;
+    header.magic = Magic;
+    header.version = Version;
+    header.numFunctions = static_cast<u32>(functions.size());
+    header.numNativeImports = static_cast<u32>(nativeImports.size());
+    header.numStrings = static_cast<u32>(strings.size());
+    header.numParameterOffsets = static_cast<u32>(parameterOffsets.size());
+    header.codeSize = bytecodeInfo.opcodes.size();
+    header.stringDataSize = stringData.size();
+
+    Append(&header, sizeof(BytecodeImageHeader));
+    header.codeOffset = Append(bytecodeInfo.opcodes.data(), bytecodeInfo.opcodes.size());
+    header.functionsOffset = Append(functions.data(), functions.size() * sizeof(BytecodeImageFunction));
+    header.nativeImportsOffset = Append(nativeImports.data(), nativeImports.size() * sizeof(BytecodeImageNativeImport));
+    header.parameterOffsetsOffset = Append(parameterOffsets.data(), parameterOffsets.size() * sizeof(i64));
+    header.stringsOffset = Append(strings.data(), strings.size() * sizeof(BytecodeImageString));
+    header.stringDataOffset = Append(stringData.data(), stringData.size());
+
+    // The section offsets are only known now
+    memcpy(buffer.data(), &header, sizeof(BytecodeImageHeader));
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file)
+    {
+        DebugHandler::PrintError("BytecodeImage : Failed to open (%s) for writing", path.c_str());
+        return false;
+    }
+
+    file.write(reinterpret_cast<const char*>(buffer.data()), buffer.size());
+    if (!file)
+    {
+        DebugHandler::PrintError("BytecodeImage : Failed to write (%s)", path.c_str());
+        return false;
+    }
+
+    DebugHandler::PrintSuccess("BytecodeImage : Successfully Saved Module (%s) (Functions: %u, Natives: %u, Bytes: %u)", module->nameHash.name.c_str(), header.numFunctions, header.numNativeImports, static_cast<u32>(buffer.size()));
+    return true;
+}
+
+bool BytecodeImage::Load(Module* module, const std::string& path)
+{
+    BytecodeInfo& bytecodeInfo = module->bytecodeInfo;
+    assert(!bytecodeInfo.image);
+
+    MappedFile* image = new MappedFile();
+    if (!image->Open(path))
+    {
+        DebugHandler::PrintError("BytecodeImage : Failed to open (%s)", path.c_str());
+        delete image;
+        return false;
+    }
+
+    const u8* data = image->GetData();
+    u64 fileSize = image->GetSize();
+
+    const BytecodeImageHeader* header = reinterpret_cast<const BytecodeImageHeader*>(data);
+    if (fileSize < sizeof(BytecodeImageHeader) || header->magic != Magic)
+    {
+        DebugHandler::PrintError("BytecodeImage : (%s) is not a bytecode image", path.c_str());
+        delete image;
+        return false;
+    }
+
+    if (header->version != Version)
+    {
+        DebugHandler::PrintError("BytecodeImage : (%s) has version (%u) but we expect version (%u)", path.c_str(), header->version, Version);
+        delete image;
+        return false;
+    }
+
+    if (!IsInBounds(header->codeOffset, header->codeSize, fileSize) ||
+        !IsInBounds(header->functionsOffset, header->numFunctions * sizeof(BytecodeImageFunction), fileSize) ||
+        !IsInBounds(header->nativeImportsOffset, header->numNativeImports * sizeof(BytecodeImageNativeImport), fileSize) ||
+        !IsInBounds(header->parameterOffsetsOffset, header->numParameterOffsets * sizeof(i64), fileSize) ||
+        !IsInBounds(header->stringsOffset, header->numStrings * sizeof(BytecodeImageString), fileSize) ||
+        !IsInBounds(header->stringDataOffset, header->stringDataSize, fileSize))
+    {
+        DebugHandler::PrintError("BytecodeImage : (%s) is truncated or corrupt", path.c_str());
+        delete image;
+        return false;
+    }
+
+    const BytecodeImageFunction* functions = reinterpret_cast<const BytecodeImageFunction*>(data + header->functionsOffset);
+    const BytecodeImageNativeImport* nativeImports = reinterpret_cast<const BytecodeImageNativeImport*>(data + header->nativeImportsOffset);
+    const i64* parameterOffsets = reinterpret_cast<const i64*>(data + header->parameterOffsetsOffset);
+    const BytecodeImageString* strings = reinterpret_cast<const BytecodeImageString*>(data + header->stringsOffset);
+    const char* stringData = reinterpret_cast<const char*>(data + header->stringDataOffset);
+
+    // The mapping is read-only, nothing ever writes through instructions
+    u8* code = const_cast<u8*>(data + header->codeOffset);
+
+    // Everything is validated before we touch the module, so a failed load leaves it as it was
+    for (u32 i = 0; i < header->numStrings; i++)
+    {
+        const BytecodeImageString& imageString = strings[i];
+        if (!IsInBounds(imageString.offset, imageString.length, header->stringDataSize))
+        {
+            DebugHandler::PrintError("BytecodeImage : (%s) has a String outside of the string data", path.c_str());
+            delete image;
+            return false;
+        }
+    }
+
+    std::vector<FunctionMemoryInfo> memoryInfos(header->numFunctions);
+    for (u32 i = 0; i < header->numFunctions; i++)
+    {
+        const BytecodeImageFunction& function = functions[i];
+
+        if (!IsInBounds(function.codeOffset, function.numInstructionBytes, header->codeSize) ||
+            function.cleanupAddress >= function.numInstructionBytes ||
+            !IsInBounds(function.firstParameterOffset, function.numParameters, header->numParameterOffsets))
+        {
+            DebugHandler::PrintError("BytecodeImage : (%s) has a Function outside of its sections", path.c_str());
+            delete image;
+            return false;
+        }
+
+        FunctionMemoryInfo& memoryInfo = memoryInfos[i];
+        memoryInfo.instructions = code + function.codeOffset;
+        memoryInfo.numInstructionBytes = function.numInstructionBytes;
+        memoryInfo.cleanupAddress = function.cleanupAddress;
+        memoryInfo.frameSize = function.frameSize;
+        memoryInfo.isNative = false;
+
+        // Images may come from anywhere, the Interpreter trusts code that passed
+        if (!BytecodeVerifier::VerifyFunction(function.hash, memoryInfo, header->numStrings))
+        {
+            DebugHandler::PrintError("BytecodeImage : (%s) has a Function that failed verification", path.c_str());
+            delete image;
+            return false;
+        }
+    }
+
+    for (u32 i = 0; i < header->numNativeImports; i++)
+    {
+        const BytecodeImageNativeImport& nativeImport = nativeImports[i];
+
+        if (!IsInBounds(nativeImport.nameOffset, nativeImport.nameLength, header->stringDataSize) ||
+            !IsInBounds(nativeImport.firstParameterOffset, nativeImport.numParameters, header->numParameterOffsets))
+        {
+            DebugHandler::PrintError("BytecodeImage : (%s) has a Native Import outside of its sections", path.c_str());
+            delete image;
+            return false;
+        }
+    }
+
+    // CreateStringOnHeap refers to strings by index, so they must land on the index they had when the image was saved
+    if (bytecodeInfo.stringTable.GetNumStrings() > 0 || bytecodeInfo.functionHashToMemoryInfo.size() > 0)
+    {
+        DebugHandler::PrintError("BytecodeImage : Module (%s) is not empty, images must be loaded into an empty Module", module->nameHash.name.c_str());
+        delete image;
+        return false;
+    }
+
+    for (u32 i = 0; i < header->numStrings; i++)
+    {
+        const BytecodeImageString& imageString = strings[i];
+        bytecodeInfo.stringTable.AddString(std::string(stringData + imageString.offset, imageString.length));
+    }
+
+    for (u32 i = 0; i < header->numFunctions; i++)
+    {
+        const BytecodeImageFunction& function = functions[i];
+
+        bytecodeInfo.functionHashToMemoryInfo[function.hash] = memoryInfos[i];
+
+        FunctionParamInfo& paramInfo = bytecodeInfo.functionHashToParamInfo[function.hash];
+        paramInfo.extraParameterStackSpace = function.extraParameterStackSpace;
+        paramInfo.parameterOffsets.assign(parameterOffsets + function.firstParameterOffset, parameterOffsets + function.firstParameterOffset + function.numParameters);
+    }
+
+    for (u32 i = 0; i < header->numNativeImports; i++)
+    {
+        const BytecodeImageNativeImport& nativeImport = nativeImports[i];
+
+        FunctionMemoryInfo& memoryInfo = bytecodeInfo.functionHashToMemoryInfo[nativeImport.hash];
+        memoryInfo.isNative = true;
+
+        FunctionParamInfo& paramInfo = bytecodeInfo.functionHashToParamInfo[nativeImport.hash];
+        paramInfo.extraParameterStackSpace = nativeImport.extraParameterStackSpace;
+        paramInfo.parameterOffsets.assign(parameterOffsets + nativeImport.firstParameterOffset, parameterOffsets + nativeImport.firstParameterOffset + nativeImport.numParameters);
+
+#if NAI_DEBUG
+        DebugHandler::PrintSuccess("BytecodeImage : Module (%s) imports Native Function (%.*s)", module->nameHash.name.c_str(), nativeImport.nameLength, stringData + nativeImport.nameOffset);
+#endif // NAI_DEBUG
+    }
+
+    bytecodeInfo.image = image;
+    bytecodeInfo.isVerified = true;
+
+    DebugHandler::PrintSuccess("BytecodeImage : Successfully Loaded Module (%s) (Functions: %u, Natives: %u, Bytes: %u)", module->nameHash.name.c_str(), header->numFunctions, header->numNativeImports, static_cast<u32>(fileSize));
+    return true;
+}
+
+bool BytecodeImage::IsInBounds(u64 offset, u64 size, u64 fileSize)
+{
+    return offset <= fileSize && size <= fileSize - offset;
+}
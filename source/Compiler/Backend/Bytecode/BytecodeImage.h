@@ -0,0 +1,77 @@
+#pragma once
+#include "pch/Build.h"
+#include <string>
+
+struct Module;
+
+struct BytecodeImageHeader
+{
+public:
+    u32 magic = 0;
+    u32 version = 0;
+
+    u32 numFunctions = 0;
+    u32 numNativeImports = 0;
+    u32 numStrings = 0;
+    u32 numParameterOffsets = 0;
+
+    u64 codeOffset = 0;
+    u64 codeSize = 0;
+    u64 functionsOffset = 0;
+    u64 nativeImportsOffset = 0;
+    u64 parameterOffsetsOffset = 0;
+    u64 stringsOffset = 0;
+    u64 stringDataOffset = 0;
+    u64 stringDataSize = 0;
+};
+
+struct BytecodeImageFunction
+{
+public:
+    u32 hash = 0;
+    u32 codeOffset = 0;
+    u32 numInstructionBytes = 0;
+    u32 cleanupAddress = 0;
+    u32 frameSize = 0;
+
+    u32 extraParameterStackSpace = 0;
+    u32 firstParameterOffset = 0;
+    u32 numParameters = 0;
+};
+
+// Native functions have no code, the host binds a callback to them by name after loading
+struct BytecodeImageNativeImport
+{
+public:
+    u32 hash = 0;
+    u32 nameOffset = 0;
+    u32 nameLength = 0;
+
+    u32 extraParameterStackSpace = 0;
+    u32 firstParameterOffset = 0;
+    u32 numParameters = 0;
+};
+
+// Strings are stored back to back in the string data, nameOffset of native imports points into it as well
+struct BytecodeImageString
+{
+public:
+    u32 offset = 0;
+    u32 length = 0;
+};
+
+// Versioned on-disk form of a module's bytecode, loading maps the file and runs the code straight out of the mapping
+class BytecodeImage
+{
+public:
+    static constexpr u32 Magic = 0x4249414E; // "NAIB"
+
+    // Bump whenever the layout above or the encoding of any ByteOpcode changes
+    static constexpr u32 Version = 4;
+
+    static bool Save(Module* module, const std::string& path);
+    static bool Load(Module* module, const std::string& path);
+
+private:
+    static bool IsInBounds(u64 offset, u64 size, u64 fileSize);
+};
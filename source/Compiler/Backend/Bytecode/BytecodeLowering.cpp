@@ -0,0 +1,574 @@
+#include "pch/Build.h"
+#include "Bytecode.h"
+#include "../../Module.h"
+#include "../../IR/IR.h"
+
+#include "ByteOpcode.h"
+#include "RegisterAllocator.h"
+
+#include <algorithm>
+
+u64 Bytecode::AssignSlots(IRFunction* function, u64 frameSize)
+{
+    // Values live in registers where the RegisterAllocator found room, only the rest get a slot
+    RegisterAllocator::AllocateValues(function, _context);
+
+    // Every slot holds the full register, so they are all 8 bytes and aligned
+    frameSize = GetAllocationAlignment(frameSize, 8);
+
+    for (IRBlock* block : function->blocks)
+    {
+        for (IRInstruction* instruction : block->instructions)
+        {
+            if (!instruction->HasValue())
+                continue;
+
+            if (_context->valueRegisters[instruction->id] == Register::None)
+            {
+                frameSize += 8;
+                instruction->slot = static_cast<i32>(frameSize);
+            }
+        }
+    }
+
+    return frameSize;
+}
+
+void Bytecode::LowerFunction(Module* module, IRFunction* function)
+{
+    _context->blockJumps.clear();
+    _context->isFrameAddressTaken = IsFrameAddressTaken(function);
+
+    for (size_t i = 0; i < function->blocks.size(); i++)
+    {
+        IRBlock* block = function->blocks[i];
+        IRBlock* nextBlock = i + 1 < function->blocks.size() ? function->blocks[i + 1] : nullptr;
+
+        block->address = static_cast<u32>(_context->opcodes.GetSize());
+
+        for (size_t j = 0; j < block->instructions.size(); j++)
+        {
+            IRInstruction* instruction = block->instructions[j];
+            IRInstruction* next = j + 1 < block->instructions.size() ? block->instructions[j + 1] : nullptr;
+
+            if (IsTailCall(module, instruction, next))
+            {
+                // The Return is taken care of by the callee
+                LowerCall(module, instruction, true);
+                break;
+            }
+
+            // Predecessors already left the value where the Phi lives
+            if (instruction->kind == IRInstruction::Kind::Phi)
+                continue;
+
+            if (instruction->IsTerminator())
+            {
+                LowerTerminator(module, instruction, nextBlock);
+            }
+            else
+            {
+                LowerInstruction(module, instruction);
+            }
+        }
+    }
+
+    // Blocks further down weren't placed yet when the jumps to them were emitted
+    for (const BlockJump& blockJump : _context->blockJumps)
+    {
+        _context->opcodes.PatchJump(blockJump.jump, static_cast<i32>(blockJump.block->address));
+    }
+}
+
+void Bytecode::LowerInstruction(Module* module, IRInstruction* instruction)
+{
+    switch (instruction->kind)
+    {
+        case IRInstruction::Kind::Parameter:
+        {
+            if (instruction->number < RegisterAllocator::NumParameterRegisters)
+            {
+                StoreValue(module, instruction, RegisterAllocator::ParameterRegisters[instruction->number]);
+            }
+            else
+            {
+                Emit(module, LoadRelative(static_cast<i32>(instruction->declaration->variable.offset), Register::Rax, instruction->size), "Load Parameter");
+                StoreValue(module, instruction, Register::Rax);
+            }
+            break;
+        }
+        case IRInstruction::Kind::Copy:
+        {
+            LoadValue(module, instruction->operands[0], Register::Rax);
+            StoreValue(module, instruction, Register::Rax);
+            break;
+        }
+        case IRInstruction::Kind::String:
+        {
+            GenerateString(module, instruction->string);
+            StoreValue(module, instruction, Register::Rax);
+            break;
+        }
+        case IRInstruction::Kind::Load:
+        {
+            LoadValue(module, instruction->operands[0], Register::Rax);
+            Emit(module, MoveAToR(Register::Rax, Register::Rax, instruction->size, instruction->isPointer), "Load");
+            StoreValue(module, instruction, Register::Rax);
+            break;
+        }
+        case IRInstruction::Kind::Store:
+        {
+            LoadValue(module, instruction->operands[1], Register::Rax);
+            LoadValue(module, instruction->operands[0], Register::Rbx);
+            Emit(module, MoveRToA(Register::Rax, Register::Rbx, instruction->size, instruction->isPointer), "Store");
+            break;
+        }
+        case IRInstruction::Kind::Call:
+        {
+            LowerCall(module, instruction, false);
+            break;
+        }
+        case IRInstruction::Kind::MemoryNew:
+        {
+            LoadValue(module, instruction->operands[0], Register::Rax);
+            Emit(module, MoveNToR(instruction->number, Register::Rdi, 8, false));
+            Emit(module, MulRToR(Register::Rdi, Register::Rax, 8));
+            Emit(module, MemoryNew(), "Allocate Memory");
+            StoreValue(module, instruction, Register::Rax);
+            break;
+        }
+        case IRInstruction::Kind::MemoryFree:
+        {
+            LoadValue(module, instruction->operands[0], Register::Rax);
+            Emit(module, MemoryFree(), "Free Memory");
+            break;
+        }
+
+        default:
+        {
+            if (!instruction->IsBinary())
+            {
+                DebugHandler::PrintError("Bytecode : Unhandled IRInstruction::Kind(%s)", IRInstruction::GetKindName(instruction->kind));
+                exit(1);
+            }
+
+            // Add, Subtract and Multiply leave the same low bytes at any width, so they always write the whole register
+            // Writing part of one and then reading all of it is slow in both the Interpreter and the Jit
+            u8 size = instruction->size;
+            if (instruction->kind == IRInstruction::Kind::Add || instruction->kind == IRInstruction::Kind::Subtract || instruction->kind == IRInstruction::Kind::Multiply)
+            {
+                size = 8;
+            }
+
+            // Whole register results go straight to their own register, narrower ones are written whole through Rax
+            Register destination = size == 8 ? _context->valueRegisters[instruction->id] : Register::None;
+            if (destination == Register::None)
+            {
+                destination = Register::Rax;
+            }
+
+            // Operands in a register are read in place, the result may have taken over the register of the right one so that is read first
+
+            IRInstruction* right = instruction->operands[1];
+            Register source = _context->valueRegisters[right->id];
+            if (source == Register::None || source == destination)
+            {
+                source = Register::Rbx;
+                LoadValue(module, right, source);
+            }
+
+            LoadValue(module, instruction->operands[0], destination);
+
+            switch (instruction->kind)
+            {
+                case IRInstruction::Kind::Add: Emit(module, AddRToR(source, destination, size)); break;
+                case IRInstruction::Kind::Subtract: Emit(module, SubRToR(source, destination, size)); break;
+                case IRInstruction::Kind::Multiply: Emit(module, MulRToR(source, destination, size)); break;
+                case IRInstruction::Kind::Divide: Emit(module, DivRToR(source, destination, size)); break;
+                case IRInstruction::Kind::Modulo: Emit(module, ModuloRToR(source, destination, size)); break;
+                case IRInstruction::Kind::Equal: Emit(module, CmpE_RToR(source, destination, size)); break;
+                case IRInstruction::Kind::NotEqual: Emit(module, CmpNE_RToR(source, destination, size)); break;
+                case IRInstruction::Kind::LessThan: Emit(module, CmpL_RToR(source, destination, size)); break;
+                case IRInstruction::Kind::LessEqual: Emit(module, CmpLE_RToR(source, destination, size)); break;
+                case IRInstruction::Kind::GreaterThan: Emit(module, CmpG_RToR(source, destination, size)); break;
+                case IRInstruction::Kind::GreaterEqual: Emit(module, CmpGE_RToR(source, destination, size)); break;
+
+                default: break;
+            }
+
+            if (destination == Register::Rax)
+            {
+                StoreValue(module, instruction, Register::Rax);
+            }
+            break;
+        }
+    }
+}
+
+void Bytecode::LowerCall(Module* module, IRInstruction* instruction, bool isTailCall)
+{
+    u32 numArguments = static_cast<u32>(instruction->operands.size());
+    u32 numPushedBytes = 0;
+
+    // Same layout GenerateExpressionCall produces, the callee can't tell which one called it
+    if (numArguments > RegisterAllocator::NumParameterRegisters)
+    {
+        numPushedBytes += 8;
+        Emit(module, PushRegister(Register::Rax), "Push Extra Rbp Space");
+
+        for (u32 i = numArguments; i > RegisterAllocator::NumParameterRegisters; i--)
+        {
+            LoadValue(module, instruction->operands[i - 1], Register::Rax);
+            Emit(module, PushRegister(Register::Rax), "Push argument");
+
+            numPushedBytes += 8;
+        }
+    }
+
+    // The arguments are already values, loading them can't clobber another argument register
+    for (u32 i = 0; i < numArguments && i < RegisterAllocator::NumParameterRegisters; i++)
+    {
+        LoadValue(module, instruction->operands[i], RegisterAllocator::ParameterRegisters[i]);
+    }
+
+    if (isTailCall)
+    {
+        assert(numPushedBytes == 0);
+
+        GenerateFunctionCleanup(module);
+        Emit(module, TailCall(instruction->callHash), "Tail Call Function");
+        return;
+    }
+
+    if (IsIntrinsic(module, instruction->callHash))
+    {
+        GenerateIntrinsic(module, instruction->callHash);
+    }
+    else
+    {
+        Emit(module, FunctionCall(instruction->callHash), "Call Function");
+    }
+
+    if (numPushedBytes > 0)
+    {
+        Emit(module, PopNoRegister(static_cast<u8>(numPushedBytes)), "Pop Pushed Argument");
+    }
+
+    if (instruction->HasValue())
+    {
+        StoreValue(module, instruction, Register::Rax);
+    }
+}
+
+bool Bytecode::IsTailCall(Module* module, IRInstruction* instruction, IRInstruction* next)
+{
+    if (instruction->kind != IRInstruction::Kind::Call || !next || next->kind != IRInstruction::Kind::Return)
+        return false;
+
+    // Intrinsics never leave our frame, the Return still has to be lowered
+    if (IsIntrinsic(module, instruction->callHash))
+        return false;
+
+    if (instruction->operands.size() > RegisterAllocator::NumParameterRegisters)
+        return false;
+
+    // The callee would be handed pointers into a frame we already freed
+    if (_context->isFrameAddressTaken)
+        return false;
+
+    // Nothing but the Return can read the result, the block ends right after it
+    if (next->operands.size())
+        return next->operands[0] == instruction;
+
+    return true;
+}
+
+bool Bytecode::IsFrameAddressTaken(IRFunction* function)
+{
+    std::vector<bool> isFrameAddress(function->numInstructions);
+    auto IsFrameAddress = [&isFrameAddress](IRInstruction* value)
+    {
+        return value->kind == IRInstruction::Kind::FrameAddress || isFrameAddress[value->id];
+    };
+
+    // Pointer arithmetic, Copies and Phis pass an address along, Phis around a loop need another round to see it
+    bool isChanged = true;
+    while (isChanged)
+    {
+        isChanged = false;
+
+        for (IRBlock* block : function->blocks)
+        {
+            for (IRInstruction* instruction : block->instructions)
+            {
+                bool isPassedAlong = instruction->kind == IRInstruction::Kind::Add || instruction->kind == IRInstruction::Kind::Subtract ||
+                                     instruction->kind == IRInstruction::Kind::Copy || instruction->kind == IRInstruction::Kind::Phi;
+
+                if (!isPassedAlong || isFrameAddress[instruction->id])
+                    continue;
+
+                if (std::any_of(instruction->operands.begin(), instruction->operands.end(), IsFrameAddress))
+                {
+                    isFrameAddress[instruction->id] = true;
+                    isChanged = true;
+                }
+            }
+        }
+    }
+
+    // Loads and Stores through it stay within the frame, the address itself escapes when it is stored, returned or passed to a call
+    for (IRBlock* block : function->blocks)
+    {
+        for (IRInstruction* instruction : block->instructions)
+        {
+            switch (instruction->kind)
+            {
+                case IRInstruction::Kind::Store:
+                {
+                    if (IsFrameAddress(instruction->operands[1]))
+                        return true;
+                    break;
+                }
+                case IRInstruction::Kind::Call:
+                case IRInstruction::Kind::Return:
+                {
+                    if (std::any_of(instruction->operands.begin(), instruction->operands.end(), IsFrameAddress))
+                        return true;
+                    break;
+                }
+
+                default: break;
+            }
+        }
+    }
+
+    return false;
+}
+
+void Bytecode::LowerTerminator(Module* module, IRInstruction* instruction, IRBlock* nextBlock)
+{
+    // The condition is read before the Phi copies, one of them may take over its register
+    bool isFlagSet = false;
+    if (instruction->kind == IRInstruction::Kind::Branch)
+    {
+        IRInstruction* condition = instruction->operands[0];
+
+        // A compare lowered right before this still has its result in the flag, the Phi copies only move values around
+        const std::vector<IRInstruction*>& instructions = instruction->block->instructions;
+        isFlagSet = condition->IsComparison() && instructions.size() >= 2 && instructions[instructions.size() - 2] == condition;
+
+        if (!isFlagSet)
+        {
+            LoadValue(module, condition, Register::Rax);
+            Emit(module, CmpLE_NToR(0, Register::Rax, instruction->size), "Branch Compare");
+        }
+    }
+
+    // Phis of the successors are written before we leave, a Branch writes the Phis of both
+    LowerPhiCopies(module, instruction->block);
+
+    switch (instruction->kind)
+    {
+        case IRInstruction::Kind::Jump:
+        {
+            if (instruction->targets[0] != nextBlock)
+            {
+                LowerJump(module, instruction->targets[0], false, false, "Jump");
+            }
+            break;
+        }
+        case IRInstruction::Kind::Branch:
+        {
+            LowerJump(module, instruction->targets[1], true, !isFlagSet, "Branch : False");
+
+            if (instruction->targets[0] != nextBlock)
+            {
+                LowerJump(module, instruction->targets[0], false, false, "Branch : True");
+            }
+            break;
+        }
+        case IRInstruction::Kind::Return:
+        {
+            if (instruction->operands.size())
+            {
+                LoadValue(module, instruction->operands[0], Register::Rax);
+            }
+
+            // The cleanup directly follows the last block
+            if (nextBlock)
+            {
+                Emit(module, JumpFunctionEnd(), "Return (Clean Stack Frame)");
+            }
+            break;
+        }
+
+        default:
+        {
+            DebugHandler::PrintError("Bytecode : Unhandled IRInstruction::Kind(%s)", IRInstruction::GetKindName(instruction->kind));
+            exit(1);
+        }
+    }
+}
+
+void Bytecode::LowerPhiCopies(Module* module, IRBlock* block)
+{
+    IRBlock* successors[2];
+    u32 numSuccessors = block->GetSuccessors(successors);
+
+    // Every Phi reads the values from before the edge, so the copies of both successors happen as one
+    std::vector<PhiCopy> copies;
+    for (u32 i = 0; i < numSuccessors; i++)
+    {
+        if (i == 1 && successors[1] == successors[0])
+            break;
+
+        IRBlock* successor = successors[i];
+        u32 predecessorIndex = successor->GetPredecessorIndex(block);
+
+        for (IRInstruction* phi : successor->instructions)
+        {
+            if (phi->kind != IRInstruction::Kind::Phi)
+                break;
+
+            IRInstruction* source = phi->operands[predecessorIndex];
+            if (IsSameHome(source, phi))
+                continue;
+
+            copies.push_back({ phi, source, Register::None });
+        }
+    }
+
+    while (copies.size())
+    {
+        // A Phi can be written once no other copy still has to read what it overwrites
+        auto ready = std::find_if(copies.begin(), copies.end(), [&copies](const PhiCopy& copy)
+        {
+            return std::none_of(copies.begin(), copies.end(), [&copy](const PhiCopy& other)
+            {
+                return &other != &copy && other.sourceRegister == Register::None && IsSameHome(other.source, copy.phi);
+            });
+        });
+
+        if (ready != copies.end())
+        {
+            LowerPhiCopy(module, *ready);
+            copies.erase(ready);
+            continue;
+        }
+
+        // Only cycles are left, park one Phi in Rbx and let its readers take it from there, that unwinds the whole cycle
+        PhiCopy& parked = copies.front();
+        assert(std::none_of(copies.begin(), copies.end(), [](const PhiCopy& copy) { return copy.sourceRegister != Register::None; }));
+
+        LoadValue(module, parked.phi, Register::Rbx);
+        for (PhiCopy& copy : copies)
+        {
+            if (IsSameHome(copy.source, parked.phi))
+            {
+                copy.sourceRegister = Register::Rbx;
+            }
+        }
+    }
+}
+
+void Bytecode::LowerPhiCopy(Module* module, const PhiCopy& copy)
+{
+    Register phiRegister = _context->valueRegisters[copy.phi->id];
+
+    if (copy.sourceRegister != Register::None)
+    {
+        if (phiRegister != Register::None)
+        {
+            Emit(module, MoveRToR(copy.sourceRegister, phiRegister, 8, false), "Phi Copy");
+        }
+        else
+        {
+            StoreSlot(module, copy.phi->slot, copy.sourceRegister);
+        }
+    }
+    else if (phiRegister != Register::None)
+    {
+        LoadValue(module, copy.source, phiRegister);
+    }
+    else
+    {
+        LoadValue(module, copy.source, Register::Rax);
+        StoreSlot(module, copy.phi->slot, Register::Rax);
+    }
+}
+
+bool Bytecode::IsSameHome(IRInstruction* a, IRInstruction* b)
+{
+    // Constants and frame addresses don't live anywhere, they are materialized wherever they are read
+    if (!a->block || !b->block)
+        return false;
+
+    Register aRegister = _context->valueRegisters[a->id];
+    Register bRegister = _context->valueRegisters[b->id];
+
+    if (aRegister != Register::None || bRegister != Register::None)
+        return aRegister == bRegister;
+
+    return a->slot == b->slot;
+}
+
+void Bytecode::LowerJump(Module* module, IRBlock* target, bool isConditional, bool condition, StringView comment)
+{
+    BlockJump& blockJump = _context->blockJumps.emplace_back();
+    blockJump.jump = EmitJump(module, JumpAbsolute(0, isConditional, condition), comment);
+    blockJump.block = target;
+}
+
+void Bytecode::LoadValue(Module* module, IRInstruction* value, Register reg)
+{
+    switch (value->kind)
+    {
+        case IRInstruction::Kind::Constant:
+        {
+            Emit(module, MoveNToR(value->number, reg, 8, false), "Move Constant");
+            break;
+        }
+        case IRInstruction::Kind::FrameAddress:
+        {
+            Emit(module, LoadAddress(static_cast<i32>(value->declaration->variable.offset), reg, true, false), "Load Variable Address");
+            break;
+        }
+
+        default:
+        {
+            Register valueRegister = _context->valueRegisters[value->id];
+            if (valueRegister != Register::None)
+            {
+                if (valueRegister != reg)
+                {
+                    Emit(module, MoveRToR(valueRegister, reg, 8, false), "Load Value");
+                }
+                break;
+            }
+
+            assert(value->slot);
+            Emit(module, LoadRelative(value->slot, reg, 8), "Load Value");
+            break;
+        }
+    }
+}
+
+void Bytecode::StoreValue(Module* module, IRInstruction* value, Register reg)
+{
+    Register valueRegister = _context->valueRegisters[value->id];
+    if (valueRegister != Register::None)
+    {
+        Emit(module, MoveRToR(reg, valueRegister, 8, false), "Store Value");
+        return;
+    }
+
+    StoreSlot(module, value->slot, reg);
+}
+
+void Bytecode::StoreSlot(Module* module, i32 slot, Register reg)
+{
+    assert(reg != Register::Rdi);
+
+    Emit(module, LoadAddress(slot, Register::Rdi, true, false), "Find Slot");
+    Emit(module, MoveRToA(reg, Register::Rdi, 8, false), "Store Value");
+}
@@ -0,0 +1,575 @@
+#include "pch/Build.h"
+#include "BytecodeVerifier.h"
+#include "../../Module.h"
+
+#include <algorithm>
+#include <vector>
+
+// Far beyond any real frame, keeps the depth arithmetic below from overflowing
+constexpr i64 MaxStackBytes = 0x7FFFFFFF;
+
+bool BytecodeVerifier::Process(Module* module)
+{
+    BytecodeInfo& bytecodeInfo = module->bytecodeInfo;
+    u32 numStrings = static_cast<u32>(bytecodeInfo.stringTable.GetNumStrings());
+
+    u32 numFunctions = 0;
+    bool isVerified = true;
+
+    for (auto& itr : bytecodeInfo.functionHashToMemoryInfo)
+    {
+        FunctionMemoryInfo& memoryInfo = itr.second;
+
+        // Natives run as host callbacks, there is no bytecode to verify
+        if (memoryInfo.isNative)
+            continue;
+
+        numFunctions++;
+
+        if (!VerifyFunction(itr.first, memoryInfo, numStrings))
+        {
+            isVerified = false;
+        }
+    }
+
+    bytecodeInfo.isVerified = isVerified;
+
+    if (!isVerified)
+    {
+        DebugHandler::PrintError("BytecodeVerifier : Module (%s) failed verification, it runs with runtime checks", module->nameHash.name.c_str());
+        return false;
+    }
+
+    DebugHandler::PrintSuccess("BytecodeVerifier : Successfully Verified Module (%s) (Functions: %u)", module->nameHash.name.c_str(), numFunctions);
+    return true;
+}
+
+bool BytecodeVerifier::VerifyFunction(u32 functionHash, FunctionMemoryInfo& memoryInfo, u32 numStrings)
+{
+    u8* instructions = memoryInfo.instructions;
+    u32 size = memoryInfo.numInstructionBytes;
+
+    const char* error = nullptr;
+    u32 errorOffset = 0;
+
+    // Decode every instruction once, jumps may only land where one starts, jumping to the end returns
+    std::vector<u8> isInstructionStart(static_cast<size_t>(size) + 1, 0);
+    isInstructionStart[size] = 1;
+
+    for (u32 offset = 0; offset < size && !error;)
+    {
+        ByteOpcode* opcode = reinterpret_cast<ByteOpcode*>(instructions + offset);
+        errorOffset = offset;
+
+        u8 kind = instructions[offset];
+        u32 opcodeSize = kind < static_cast<u8>(ByteOpcode::Kind::Count) ? ByteOpcode::GetKindSize(opcode->kind) : 0;
+
+        if (opcodeSize == 0)
+        {
+            error = "Unknown opcode";
+        }
+        else if (opcodeSize > size - offset)
+        {
+            error = "Instruction runs past the end of the function";
+        }
+        else
+        {
+            error = VerifyInstruction(opcode, numStrings);
+        }
+
+        isInstructionStart[offset] = 1;
+        offset += opcodeSize;
+    }
+
+    if (!error && (memoryInfo.cleanupAddress > size || !isInstructionStart[memoryInfo.cleanupAddress]))
+    {
+        error = "Cleanup address does not land on an instruction";
+        errorOffset = memoryInfo.cleanupAddress;
+    }
+
+    // Walk every path through the function, tracking how far Rsp and Rbp are from where Rsp was on entry
+    std::vector<StackState> states(static_cast<size_t>(size) + 1);
+    std::vector<u8> isVisited(static_cast<size_t>(size) + 1, 0);
+    std::vector<u32> worklist;
+    StackBounds bounds;
+
+    auto Reach = [&](u32 target, const StackState& state) -> const char*
+    {
+        if (target > size || !isInstructionStart[target])
+            return "Jump does not land on an instruction";
+
+        // Running off the end returns just like Ret does
+        if (target == size)
+            return state.isDepthKnown && state.depth == 0 ? nullptr : "Returns with an unbalanced stack";
+
+        if (!isVisited[target])
+        {
+            isVisited[target] = 1;
+            states[target] = state;
+            worklist.push_back(target);
+            return nullptr;
+        }
+
+        StackState& existing = states[target];
+        if (existing.isRbpKnown != state.isRbpKnown || (state.isRbpKnown && existing.rbpDepth != state.rbpDepth))
+            return "Paths meet with different values of Rbp";
+
+        if (existing.isDepthKnown && (!state.isDepthKnown || existing.depth != state.depth))
+        {
+            existing.isDepthKnown = false;
+            worklist.push_back(target);
+        }
+
+        return nullptr;
+    };
+
+    if (!error && size > 0)
+    {
+        StackState entry;
+        error = Reach(0, entry);
+    }
+
+    while (!error && worklist.size())
+    {
+        u32 offset = worklist.back();
+        worklist.pop_back();
+
+        ByteOpcode* opcode = reinterpret_cast<ByteOpcode*>(instructions + offset);
+        u32 next = offset + ByteOpcode::GetKindSize(opcode->kind);
+        errorOffset = offset;
+
+        StackState state = states[offset];
+        error = Step(opcode, state, memoryInfo, bounds);
+
+        if (error)
+            break;
+
+        switch (opcode->kind)
+        {
+            case ByteOpcode::Kind::JumpAbsolute:
+            {
+                JumpAbsolute* jump = reinterpret_cast<JumpAbsolute*>(opcode);
+
+                error = jump->address < 0 ? "Jump does not land on an instruction" : Reach(static_cast<u32>(jump->address), state);
+                if (!error && jump->flags.isConditional)
+                {
+                    error = Reach(next, state);
+                }
+                break;
+            }
+            case ByteOpcode::Kind::JumpRelative:
+            {
+                JumpRelative* jump = reinterpret_cast<JumpRelative*>(opcode);
+                i64 target = static_cast<i64>(offset) + jump->address;
+
+                error = target < 0 ? "Jump does not land on an instruction" : Reach(static_cast<u32>(std::min<i64>(target, static_cast<i64>(size) + 1)), state);
+                if (!error && jump->flags.isConditional)
+                {
+                    error = Reach(next, state);
+                }
+                break;
+            }
+            case ByteOpcode::Kind::JumpFunctionEnd:
+            {
+                JumpFunctionEnd* jump = reinterpret_cast<JumpFunctionEnd*>(opcode);
+
+                error = Reach(memoryInfo.cleanupAddress, state);
+                if (!error && jump->flags.isConditional)
+                {
+                    error = Reach(next, state);
+                }
+                break;
+            }
+            case ByteOpcode::Kind::Ret:
+            case ByteOpcode::Kind::TailCall:
+            {
+                // Our caller pops its own arguments, so it has to get Rsp back the way it handed it to us
+                if (!state.isDepthKnown || state.depth != 0)
+                {
+                    error = "Returns with an unbalanced stack";
+                }
+                break;
+            }
+
+            default:
+            {
+                error = Reach(next, state);
+                break;
+            }
+        }
+    }
+
+    if (error)
+    {
+        ByteOpcode::Kind kind = errorOffset < size ? reinterpret_cast<ByteOpcode*>(instructions + errorOffset)->kind : ByteOpcode::Kind::None;
+        DebugHandler::PrintError("BytecodeVerifier : Function (%u) rejected at offset (%u) (%s) : %s", functionHash, errorOffset, ByteOpcode::GetKindName(kind), error);
+        return false;
+    }
+
+    memoryInfo.maxStackDepth = static_cast<u32>(bounds.maxDepth);
+    memoryInfo.maxStackRise = static_cast<u32>(-bounds.minDepth);
+    return true;
+}
+
+template <typename T>
+const char* BytecodeVerifier::VerifyRegisterToRegister(ByteOpcode* opcode)
+{
+    T* instruction = reinterpret_cast<T*>(opcode);
+
+    if (!IsValidRegister(instruction->source) || !IsValidRegister(instruction->destination))
+        return "Register out of range";
+
+    if (instruction->size < 1 || instruction->size > 8)
+        return "Size does not fit a register";
+
+    return nullptr;
+}
+
+template <typename T>
+const char* BytecodeVerifier::VerifyNumberToRegister(ByteOpcode* opcode)
+{
+    T* instruction = reinterpret_cast<T*>(opcode);
+
+    if (!IsValidRegister(instruction->destination))
+        return "Register out of range";
+
+    if (instruction->size < 1 || instruction->size > 8)
+        return "Size does not fit a register";
+
+    return nullptr;
+}
+
+const char* BytecodeVerifier::VerifyInstruction(ByteOpcode* opcode, u32 numStrings)
+{
+    switch (opcode->kind)
+    {
+        case ByteOpcode::Kind::PushRegister:
+        {
+            return IsValidRegister(reinterpret_cast<PushRegister*>(opcode)->reg) ? nullptr : "Register out of range";
+        }
+        case ByteOpcode::Kind::PushNumber:
+        {
+            u8 size = reinterpret_cast<PushNumber*>(opcode)->size;
+            return size >= 1 && size <= 8 ? nullptr : "Size does not fit a register";
+        }
+        case ByteOpcode::Kind::PopRegister:
+        {
+            return IsValidRegister(reinterpret_cast<PopRegister*>(opcode)->reg) ? nullptr : "Register out of range";
+        }
+
+        case ByteOpcode::Kind::LoadAbsolute:
+        case ByteOpcode::Kind::LoadRelative:
+        case ByteOpcode::Kind::LoadRegister:
+        case ByteOpcode::Kind::LoadAddress:
+        {
+            Load* load = reinterpret_cast<Load*>(opcode);
+            if (!IsValidRegister(load->GetDestination()))
+                return "Register out of range";
+
+            if (opcode->kind == ByteOpcode::Kind::LoadRegister && !IsValidRegister(reinterpret_cast<LoadRegister*>(opcode)->source))
+                return "Register out of range";
+
+            // LoadAddress always moves a whole address, its size is unused
+            if (opcode->kind != ByteOpcode::Kind::LoadAddress && (load->GetSize() < 1 || load->GetSize() > 8))
+                return "Size does not fit a register";
+
+            return nullptr;
+        }
+
+        case ByteOpcode::Kind::MemCopy:
+        {
+            MemCopy* copy = reinterpret_cast<MemCopy*>(opcode);
+            if (!IsValidRegister(copy->source) || !IsValidRegister(copy->destination))
+                return "Register out of range";
+
+            if (copy->sizeRegister != Register::None && !IsValidRegister(copy->sizeRegister))
+                return "Register out of range";
+
+            return nullptr;
+        }
+        case ByteOpcode::Kind::MemSet:
+        {
+            MemSet* set = reinterpret_cast<MemSet*>(opcode);
+            if (!IsValidRegister(set->destination))
+                return "Register out of range";
+
+            if ((set->valueRegister != Register::None && !IsValidRegister(set->valueRegister)) ||
+                (set->sizeRegister != Register::None && !IsValidRegister(set->sizeRegister)))
+                return "Register out of range";
+
+            return nullptr;
+        }
+
+        case ByteOpcode::Kind::CreateStringOnHeap:
+        {
+            return reinterpret_cast<CreateStringOnHeap*>(opcode)->strIndex < numStrings ? nullptr : "String index out of range";
+        }
+
+        case ByteOpcode::Kind::MoveNToR: return VerifyNumberToRegister<MoveNToR>(opcode);
+        case ByteOpcode::Kind::MoveNToA: return VerifyNumberToRegister<MoveNToA>(opcode);
+        case ByteOpcode::Kind::MoveRToR: return VerifyRegisterToRegister<MoveRToR>(opcode);
+        case ByteOpcode::Kind::MoveRToA: return VerifyRegisterToRegister<MoveRToA>(opcode);
+        case ByteOpcode::Kind::MoveAToR: return VerifyRegisterToRegister<MoveAToR>(opcode);
+        case ByteOpcode::Kind::MoveAToA: return VerifyRegisterToRegister<MoveAToA>(opcode);
+        case ByteOpcode::Kind::AddNToR: return VerifyNumberToRegister<AddNToR>(opcode);
+        case ByteOpcode::Kind::AddNToA: return VerifyNumberToRegister<AddNToA>(opcode);
+        case ByteOpcode::Kind::AddRToR: return VerifyRegisterToRegister<AddRToR>(opcode);
+        case ByteOpcode::Kind::AddRToA: return VerifyRegisterToRegister<AddRToA>(opcode);
+        case ByteOpcode::Kind::AddAToR: return VerifyRegisterToRegister<AddAToR>(opcode);
+        case ByteOpcode::Kind::AddAToA: return VerifyRegisterToRegister<AddAToA>(opcode);
+        case ByteOpcode::Kind::SubNToR: return VerifyNumberToRegister<SubNToR>(opcode);
+        case ByteOpcode::Kind::SubRToR: return VerifyRegisterToRegister<SubRToR>(opcode);
+        case ByteOpcode::Kind::MulRToR: return VerifyRegisterToRegister<MulRToR>(opcode);
+        case ByteOpcode::Kind::DivRToR: return VerifyRegisterToRegister<DivRToR>(opcode);
+        case ByteOpcode::Kind::ModuloRToR: return VerifyRegisterToRegister<ModuloRToR>(opcode);
+        case ByteOpcode::Kind::CmpE_RToR: return VerifyRegisterToRegister<CmpE_RToR>(opcode);
+        case ByteOpcode::Kind::CmpNE_RToR: return VerifyRegisterToRegister<CmpNE_RToR>(opcode);
+        case ByteOpcode::Kind::CmpL_RToR: return VerifyRegisterToRegister<CmpL_RToR>(opcode);
+        case ByteOpcode::Kind::CmpLE_NToR: return VerifyNumberToRegister<CmpLE_NToR>(opcode);
+        case ByteOpcode::Kind::CmpLE_RToR: return VerifyRegisterToRegister<CmpLE_RToR>(opcode);
+        case ByteOpcode::Kind::CmpG_RToR: return VerifyRegisterToRegister<CmpG_RToR>(opcode);
+        case ByteOpcode::Kind::CmpGE_RToR: return VerifyRegisterToRegister<CmpGE_RToR>(opcode);
+
+        default:
+        {
+            return nullptr;
+        }
+    }
+}
+
+const char* BytecodeVerifier::VerifyFrameAccess(const StackState& state, i64 source, u8 size, const FunctionMemoryInfo& memoryInfo, StackBounds& bounds)
+{
+    if (!state.isRbpKnown)
+        return "Frame access before Rbp is set";
+
+    // Variables sit below Rbp, the first one ends right at it
+    if (source < size || source > static_cast<i64>(memoryInfo.frameSize))
+        return "Frame access outside of the frame";
+
+    bounds.maxDepth = std::max(bounds.maxDepth, state.rbpDepth + source);
+    bounds.minDepth = std::min(bounds.minDepth, state.rbpDepth + source - size);
+    return nullptr;
+}
+
+const char* BytecodeVerifier::Step(ByteOpcode* opcode, StackState& state, const FunctionMemoryInfo& memoryInfo, StackBounds& bounds)
+{
+    switch (opcode->kind)
+    {
+        case ByteOpcode::Kind::PushRegister:
+        {
+            return Push(state, 8, bounds);
+        }
+        case ByteOpcode::Kind::PushNumber:
+        {
+            return Push(state, reinterpret_cast<PushNumber*>(opcode)->size, bounds);
+        }
+        case ByteOpcode::Kind::PopRegister:
+        {
+            Register reg = reinterpret_cast<PopRegister*>(opcode)->reg;
+            if (reg == Register::Rsp)
+                return "Pops into Rsp";
+
+            // Restores our caller's Rbp, the frame can't be accessed after this
+            if (reg == Register::Rbp)
+            {
+                state.isRbpKnown = false;
+            }
+
+            return Push(state, -8, bounds);
+        }
+        case ByteOpcode::Kind::PopNoRegister:
+        {
+            return Push(state, -static_cast<i64>(reinterpret_cast<PopNoRegister*>(opcode)->size), bounds);
+        }
+
+        case ByteOpcode::Kind::AddNToR:
+        {
+            AddNToR* add = reinterpret_cast<AddNToR*>(opcode);
+            if (add->destination != Register::Rsp)
+                break;
+
+            if (add->source > static_cast<u64>(MaxStackBytes))
+                return "Moves Rsp too far";
+
+            return Push(state, -static_cast<i64>(add->source), bounds);
+        }
+        case ByteOpcode::Kind::SubNToR:
+        {
+            SubNToR* sub = reinterpret_cast<SubNToR*>(opcode);
+            if (sub->destination != Register::Rsp)
+                break;
+
+            if (sub->source > static_cast<u64>(MaxStackBytes))
+                return "Moves Rsp too far";
+
+            return Push(state, static_cast<i64>(sub->source), bounds);
+        }
+        case ByteOpcode::Kind::MoveRToR:
+        {
+            MoveRToR* move = reinterpret_cast<MoveRToR*>(opcode);
+
+            if (move->destination == Register::Rbp)
+            {
+                if (move->source != Register::Rsp)
+                    return "Rbp can only be set from Rsp";
+
+                if (!state.isDepthKnown)
+                    return "Sets Rbp after paths with different stack depths met";
+
+                state.rbpDepth = state.depth;
+                state.isRbpKnown = true;
+                return nullptr;
+            }
+
+            if (move->destination == Register::Rsp)
+            {
+                if (move->source != Register::Rbp)
+                    return "Rsp can only be set from Rbp";
+
+                if (!state.isRbpKnown)
+                    return "Sets Rsp before Rbp is set";
+
+                state.depth = state.rbpDepth;
+                state.isDepthKnown = true;
+                return nullptr;
+            }
+            break;
+        }
+
+        case ByteOpcode::Kind::LoadAbsolute:
+        {
+            return "Absolute addresses are not allowed";
+        }
+        case ByteOpcode::Kind::LoadRelative:
+        {
+            LoadRelative* load = reinterpret_cast<LoadRelative*>(opcode);
+
+            const char* error = VerifyFrameAccess(state, load->source, load->GetSize(), memoryInfo, bounds);
+            if (error)
+                return error;
+            break;
+        }
+        case ByteOpcode::Kind::LoadAddress:
+        {
+            LoadAddress* load = reinterpret_cast<LoadAddress*>(opcode);
+            if (!load->flags.loadRelative)
+                return "Absolute addresses are not allowed";
+
+            // Points Rsp back into the frame, the cleanup uses this to find the saved registers
+            if (load->GetDestination() == Register::Rsp)
+            {
+                if (load->flags.isPointer)
+                    return "Rsp can only be set from Rbp";
+
+                if (!state.isRbpKnown)
+                    return "Sets Rsp before Rbp is set";
+
+                if (load->source < 0)
+                    return "Moves Rsp above Rbp";
+
+                state.depth = state.rbpDepth + load->source;
+                state.isDepthKnown = true;
+
+                bounds.maxDepth = std::max(bounds.maxDepth, state.depth);
+                return nullptr;
+            }
+
+            // A pointer variable is read, anything else only has its address taken
+            const char* error = VerifyFrameAccess(state, load->source, load->flags.isPointer ? 8 : 1, memoryInfo, bounds);
+            if (error)
+                return error;
+            break;
+        }
+
+        case ByteOpcode::Kind::FunctionCall:
+        {
+            // Natives find their stack arguments relative to Rsp
+            if (!state.isDepthKnown)
+                return "Calls after paths with different stack depths met";
+            break;
+        }
+
+        default:
+        {
+            break;
+        }
+    }
+
+    Register reg = GetWrittenRegister(opcode);
+    if (reg == Register::Rsp || reg == Register::Rbp)
+        return "Writes Rsp or Rbp directly";
+
+    return nullptr;
+}
+
+const char* BytecodeVerifier::Push(StackState& state, i64 size, StackBounds& bounds)
+{
+    if (!state.isDepthKnown)
+        return "Uses the stack after paths with different stack depths met";
+
+    state.depth += size;
+    if (state.depth > MaxStackBytes || state.depth < -MaxStackBytes)
+        return "Moves Rsp too far";
+
+    bounds.maxDepth = std::max(bounds.maxDepth, state.depth);
+    bounds.minDepth = std::min(bounds.minDepth, state.depth);
+    return nullptr;
+}
+
+bool BytecodeVerifier::IsValidRegister(Register reg)
+{
+    return reg > Register::None && reg <= Register::Count;
+}
+
+template <typename T>
+Register BytecodeVerifier::GetDestination(ByteOpcode* opcode)
+{
+    return reinterpret_cast<T*>(opcode)->destination;
+}
+
+Register BytecodeVerifier::GetWrittenRegister(ByteOpcode* opcode)
+{
+    switch (opcode->kind)
+    {
+        case ByteOpcode::Kind::PopRegister: return reinterpret_cast<PopRegister*>(opcode)->reg;
+
+        case ByteOpcode::Kind::LoadAbsolute:
+        case ByteOpcode::Kind::LoadRelative:
+        case ByteOpcode::Kind::LoadRegister:
+        case ByteOpcode::Kind::LoadAddress:
+        {
+            return reinterpret_cast<Load*>(opcode)->GetDestination();
+        }
+
+        case ByteOpcode::Kind::MemoryNew:
+        case ByteOpcode::Kind::CreateStringOnHeap:
+        case ByteOpcode::Kind::FunctionCall:
+        {
+            return Register::Rax;
+        }
+
+        case ByteOpcode::Kind::MoveNToR: return GetDestination<MoveNToR>(opcode);
+        case ByteOpcode::Kind::MoveRToR: return GetDestination<MoveRToR>(opcode);
+        case ByteOpcode::Kind::MoveAToR: return GetDestination<MoveAToR>(opcode);
+        case ByteOpcode::Kind::AddNToR: return GetDestination<AddNToR>(opcode);
+        case ByteOpcode::Kind::AddRToR: return GetDestination<AddRToR>(opcode);
+        case ByteOpcode::Kind::AddAToR: return GetDestination<AddAToR>(opcode);
+        case ByteOpcode::Kind::SubNToR: return GetDestination<SubNToR>(opcode);
+        case ByteOpcode::Kind::SubRToR: return GetDestination<SubRToR>(opcode);
+        case ByteOpcode::Kind::MulRToR: return GetDestination<MulRToR>(opcode);
+        case ByteOpcode::Kind::DivRToR: return GetDestination<DivRToR>(opcode);
+        case ByteOpcode::Kind::ModuloRToR: return GetDestination<ModuloRToR>(opcode);
+        case ByteOpcode::Kind::CmpE_RToR: return GetDestination<CmpE_RToR>(opcode);
+        case ByteOpcode::Kind::CmpNE_RToR: return GetDestination<CmpNE_RToR>(opcode);
+        case ByteOpcode::Kind::CmpL_RToR: return GetDestination<CmpL_RToR>(opcode);
+        case ByteOpcode::Kind::CmpLE_NToR: return GetDestination<CmpLE_NToR>(opcode);
+        case ByteOpcode::Kind::CmpLE_RToR: return GetDestination<CmpLE_RToR>(opcode);
+        case ByteOpcode::Kind::CmpG_RToR: return GetDestination<CmpG_RToR>(opcode);
+        case ByteOpcode::Kind::CmpGE_RToR: return GetDestination<CmpGE_RToR>(opcode);
+
+        default:
+        {
+            return Register::None;
+        }
+    }
+}
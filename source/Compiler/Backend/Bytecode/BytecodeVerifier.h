@@ -0,0 +1,59 @@
+#pragma once
+#include "pch/Build.h"
+#include "ByteOpcode.h"
+
+struct Module;
+struct FunctionMemoryInfo;
+
+// Checks bytecode once before it runs, so the Interpreter doesn't have to check it on every instruction
+// Every instruction must be a known opcode with its registers in range and jumps must land on the start of an instruction
+// Frame accesses must stay inside the function's frame and every path must leave the stack the way it found it
+// Images are verified when they are loaded, they may come from anywhere
+class BytecodeVerifier
+{
+public:
+    // Verifies every function of the module, BytecodeInfo::isVerified is set when all of them pass
+    static bool Process(Module* module);
+
+    // Fills in the stack bounds of memoryInfo, the Interpreter checks them once on entry instead of on every push and pop
+    static bool VerifyFunction(u32 functionHash, FunctionMemoryInfo& memoryInfo, u32 numStrings);
+
+private:
+    struct StackState
+    {
+    public:
+        // Bytes pushed since entry, negative once the function moves Rsp over the arguments its caller pushed
+        i64 depth = 0;
+        i64 rbpDepth = 0;
+
+        // Paths may meet with different depths, as long as Rsp is set from Rbp before the stack is used again
+        bool isDepthKnown = true;
+
+        // Rbp belongs to our caller until the function sets it
+        bool isRbpKnown = false;
+    };
+
+    struct StackBounds
+    {
+    public:
+        i64 minDepth = 0;
+        i64 maxDepth = 0;
+    };
+
+    // Each returns the reason the instruction was rejected, or nullptr if it passed
+    static const char* VerifyInstruction(ByteOpcode* opcode, u32 numStrings);
+    static const char* VerifyFrameAccess(const StackState& state, i64 source, u8 size, const FunctionMemoryInfo& memoryInfo, StackBounds& bounds);
+    static const char* Step(ByteOpcode* opcode, StackState& state, const FunctionMemoryInfo& memoryInfo, StackBounds& bounds);
+    static const char* Push(StackState& state, i64 size, StackBounds& bounds);
+
+    template <typename T>
+    static const char* VerifyRegisterToRegister(ByteOpcode* opcode);
+    template <typename T>
+    static const char* VerifyNumberToRegister(ByteOpcode* opcode);
+
+    static bool IsValidRegister(Register reg);
+    static Register GetWrittenRegister(ByteOpcode* opcode);
+
+    template <typename T>
+    static Register GetDestination(ByteOpcode* opcode);
+};
@@ -0,0 +1,45 @@
+#include "pch/Build.h"
+#include "CodeBuffer.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+// Most functions fit in this without ever growing
+constexpr u32 InitialCapacity = 256;
+
+void CodeBuffer::Assign(const u8* data, u32 size)
+{
+    _size = 0;
+    if (size > _capacity)
+    {
+        Grow(size);
+    }
+
+    memcpy(_data, data, size);
+    _size = size;
+}
+
+void CodeBuffer::Release()
+{
+    free(_data);
+
+    _data = nullptr;
+    _size = 0;
+    _capacity = 0;
+}
+
+void CodeBuffer::Grow(size_t minimumGrowth)
+{
+    size_t capacity = std::max<size_t>(_capacity * 2, InitialCapacity);
+    capacity = std::max<size_t>(capacity, _size + minimumGrowth);
+
+    u8* data = static_cast<u8*>(realloc(_data, capacity));
+    if (!data)
+    {
+        DebugHandler::PrintError("Bytecode : Failed to grow code buffer to %u bytes", static_cast<u32>(capacity));
+        exit(1);
+    }
+
+    _data = data;
+    _capacity = static_cast<u32>(capacity);
+}
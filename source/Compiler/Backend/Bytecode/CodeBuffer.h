@@ -0,0 +1,100 @@
+#pragma once
+#include "pch/Build.h"
+#include "ByteOpcode.h"
+#include <cstring>
+#include <vector>
+
+// Comment the generator left on the instruction starting at offset, relative to the start of the function
+struct CodeComment
+{
+public:
+    u32 offset = 0;
+    StringView text;
+};
+
+// A jump emitted before its target was known, the address is filled in through CodeBuffer::PatchJump once it is
+struct PatchPoint
+{
+public:
+    u32 offset = 0;
+};
+
+// Instructions of a single function, appended without zero filling and grown geometrically
+// Comments are only kept when recordComments is set, they point at string literals so recording them never allocates a string
+class CodeBuffer
+{
+public:
+    CodeBuffer() { }
+    ~CodeBuffer() { Release(); }
+
+    CodeBuffer(const CodeBuffer&) = delete;
+    CodeBuffer& operator=(const CodeBuffer&) = delete;
+
+    // Returns the offset the instruction was placed at
+    template <typename T>
+    u32 Append(const T& opcode, StringView comment)
+    {
+        u32 offset = _size;
+        if (_size + sizeof(T) > _capacity)
+        {
+            Grow(sizeof(T));
+        }
+
+        memcpy(&_data[offset], &opcode, sizeof(T));
+        _size += sizeof(T);
+
+        if (recordComments)
+        {
+            CodeComment& codeComment = comments.emplace_back();
+            codeComment.offset = offset;
+            codeComment.text = comment;
+        }
+
+        return offset;
+    }
+
+    // Copies code that was already generated, used for functions that are kept as they are
+    void Assign(const u8* data, u32 size);
+
+    // Instructions are packed back to back, so an offset is rarely aligned for T and is only ever accessed through memcpy
+    template <typename T>
+    void Read(size_t offset, T& opcode) const
+    {
+        assert(offset + sizeof(T) <= _size);
+        memcpy(&opcode, &_data[offset], sizeof(T));
+    }
+
+    template <typename T>
+    void Write(size_t offset, const T& opcode)
+    {
+        assert(offset + sizeof(T) <= _size);
+        memcpy(&_data[offset], &opcode, sizeof(T));
+    }
+
+    void PatchJump(PatchPoint patchPoint, i32 address)
+    {
+        JumpAbsolute jumpAbsolute(0);
+        Read(patchPoint.offset, jumpAbsolute);
+
+        jumpAbsolute.address = address;
+        Write(patchPoint.offset, jumpAbsolute);
+    }
+
+    u8* GetData() { return _data; }
+    u32 GetSize() const { return _size; }
+
+    // Frees the instructions, the comments are kept
+    void Release();
+
+public:
+    bool recordComments = false;
+    std::vector<CodeComment> comments;
+
+private:
+    void Grow(size_t minimumGrowth);
+
+private:
+    u8* _data = nullptr;
+    u32 _size = 0;
+    u32 _capacity = 0;
+};
@@ -6,6 +6,9 @@
 
 #include "Bytecode.h"
 #include "ByteOpcode.h"
+#include "../../Incremental.h"
+#include "Utils/ExecutableMemory.h"
+#include "../x86_64/x86_64.h"
 
 void Interpreter::Init()
 {
@@ -14,25 +17,86 @@ void Interpreter::Init()
 
 void Interpreter::Interpret(Module* module, Declaration* declaration)
 {
-    ZoneScopedNC("Interpret", tracy::Color::AliceBlue);
     assert(declaration->kind == Declaration::Kind::Function);
+    Interpret(module, declaration->token->nameHash.hash);
+}
+
+void Interpreter::Interpret(Module* module, u32 functionHash)
+{
+    ZoneScopedNC("Interpret", tracy::Color::AliceBlue);
+
+    // Function entry is our safe point, nothing is half way through reading the function tables
+    if (_hasPendingReload)
+    {
+        ApplyReloads();
+    }
+
+    CountHotness(module, functionHash, 1);
+
+    auto memoryInfoItr = module->bytecodeInfo.functionHashToMemoryInfo.find(functionHash);
+    if (memoryInfoItr == module->bytecodeInfo.functionHashToMemoryInfo.end())
+    {
+        DebugHandler::PrintError("Interpreter : Called a Function that does not exist in Module (%s)", module->nameHash.name.c_str());
+        exit(1);
+    }
 
     _moduleStack.push(module);
-    _callStack.push(declaration);
-    FunctionMemoryInfo& memoryInfo = module->bytecodeInfo.functionHashToMemoryInfo[declaration->token->nameHash.hash];
+    _callStack.push(functionHash);
+
+    // Copied so a reload during one of our calls can't change the code this frame is running
+    FunctionMemoryInfo memoryInfo = memoryInfoItr->second;
+
+    RunFunction(module, memoryInfo);
+
+#if NAI_DEBUG
+    DebugHandler::PrintSuccess("Interpreter : Function(%u) Returned (%u)", functionHash, *GetRegister(Register::Rax));
+#endif // NAI_DEBUG
+
+    _callStack.pop();
+    _moduleStack.pop();
+
+    if (_callStack.empty())
+    {
+        ReleaseRetiredCode();
+    }
+}
+
+void Interpreter::RunFunction(Module* module, FunctionMemoryInfo& memoryInfo)
+{
+    if (memoryInfo.jitCode)
+    {
+        // Translated code is always verified code, the bounds are checked here just like Execute<true> does
+        CheckStackBounds(memoryInfo);
+        module->jitInfo.enter(this, _registers, _memory, memoryInfo.jitCode);
+    }
+    else if (module->bytecodeInfo.isVerified)
+    {
+        Execute<true>(module, memoryInfo);
+    }
+    else
+    {
+        Execute<false>(module, memoryInfo);
+    }
+}
+
+template <bool IsVerified>
+void Interpreter::Execute(Module* module, FunctionMemoryInfo& memoryInfo)
+{
+    // The verifier proved how far the function moves Rsp, so one check here replaces the ones on every push and pop
+    if constexpr (IsVerified)
+    {
+        CheckStackBounds(memoryInfo);
+    }
 
     u8* ip = memoryInfo.instructions;
     u8* memoryEnd = memoryInfo.instructions + memoryInfo.numInstructionBytes;
+    u32 numBackEdges = 0;
 
     while (ip < memoryEnd)
     {
         ByteOpcode* opcode = reinterpret_cast<ByteOpcode*>(ip);
         ByteOpcode::Kind kind = opcode->kind;
 
-#if NAI_DEBUG
-       //DebugHandler::PrintSuccess("Opcode: %s -- %s", ByteOpcode::GetKindName(opcode->kind), &opcode->comment[0]);
-#endif // NAI_DEBUG
-
         switch (kind)
         {
             case ByteOpcode::Kind::PushRegister:
@@ -44,7 +108,7 @@ void Interpreter::Interpret(Module* module, Declaration* declaration)
                 *rsp -= 8;
                 memcpy(&_memory[*rsp], GetRegister(pushCmd->reg), 8);
 
-                if (*rsp > StackSize)
+                if (!IsVerified && *rsp > StackSize)
                 {
                     DebugHandler::PrintError("Interpreter : Stack overflow");
                     exit(1);
@@ -62,7 +126,7 @@ void Interpreter::Interpret(Module* module, Declaration* declaration)
                 *rsp -= pushCmd->size;
                 memcpy(&_memory[*rsp], &pushCmd->number, pushCmd->size);
 
-                if (*rsp > StackSize)
+                if (!IsVerified && *rsp > StackSize)
                 {
                     DebugHandler::PrintError("Interpreter : Stack overflow");
                     exit(1);
@@ -80,7 +144,7 @@ void Interpreter::Interpret(Module* module, Declaration* declaration)
                 memcpy(GetRegister(popCmd->reg), &_memory[*rsp], 8);
                 *rsp += 8;
 
-                if (*rsp > StackSize)
+                if (!IsVerified && *rsp > StackSize)
                 {
                     DebugHandler::PrintError("Interpreter : Stack underflow");
                     exit(1);
@@ -97,7 +161,7 @@ void Interpreter::Interpret(Module* module, Declaration* declaration)
 
                 *rsp += popCmd->size;
 
-                if (*rsp > StackSize)
+                if (!IsVerified && *rsp > StackSize)
                 {
                     DebugHandler::PrintError("Interpreter : Stack underflow");
                     exit(1);
@@ -115,7 +179,16 @@ void Interpreter::Interpret(Module* module, Declaration* declaration)
                 bool shouldJmp = !jumpCmd->flags.isConditional || compareFlag == jumpCmd->flags.condition;
                 if (shouldJmp)
                 {
-                    ip = memoryInfo.instructions + jumpCmd->address;
+                    u8* target = memoryInfo.instructions + jumpCmd->address;
+
+                    // Jumping back is a loop iteration, it counts towards promoting the function
+                    if (target <= ip && module->jitInfo.isTiered && ++numBackEdges == BackEdgeBatchSize)
+                    {
+                        CountHotness(module, _callStack.top(), numBackEdges);
+                        numBackEdges = 0;
+                    }
+
+                    ip = target;
                     break;
                 }
 
@@ -130,6 +203,12 @@ void Interpreter::Interpret(Module* module, Declaration* declaration)
                 bool shouldJmp = !jumpCmd->flags.isConditional || compareFlag == jumpCmd->flags.condition;
                 if (shouldJmp)
                 {
+                    if (jumpCmd->address <= 0 && module->jitInfo.isTiered && ++numBackEdges == BackEdgeBatchSize)
+                    {
+                        CountHotness(module, _callStack.top(), numBackEdges);
+                        numBackEdges = 0;
+                    }
+
                     ip += jumpCmd->address;
                     break;
                 }
@@ -258,32 +337,43 @@ void Interpreter::Interpret(Module* module, Declaration* declaration)
                 break;
             }
 
-            case ByteOpcode::Kind::CreateStringOnHeap:
+            case ByteOpcode::Kind::MemCopy:
             {
-                ZoneScopedNC("CreateStringOnHeap", tracy::Color::SandyBrown);
+                ZoneScopedNC("MemCopy", tracy::Color::Brown);
+                MemCopy* copyCmd = reinterpret_cast<MemCopy*>(ip);
 
-                CreateStringOnHeap* createStringCmd = reinterpret_cast<CreateStringOnHeap*>(ip);
+                u64 sourceAddress = *GetRegister(copyCmd->source);
+                u64 destinationAddress = *GetRegister(copyCmd->destination);
+                u64 size = copyCmd->sizeRegister != Register::None ? *GetRegister(copyCmd->sizeRegister) : copyCmd->size;
 
-                size_t size = 0;
-                size_t address = 0;
+                // Struct copies may overlap when a value is assigned through a pointer into itself
+                memmove(&_memory[destinationAddress], &_memory[sourceAddress], size);
 
-                auto itr = module->bytecodeInfo.stringIndexToHeapAddress.find(createStringCmd->strIndex);
-                if (itr == module->bytecodeInfo.stringIndexToHeapAddress.end())
-                {
-                    const std::string& str = module->bytecodeInfo.stringTable.GetString(createStringCmd->strIndex);
-                    size = str.length() + 1;
+                ip += sizeof(MemCopy);
+                break;
+            }
+            case ByteOpcode::Kind::MemSet:
+            {
+                ZoneScopedNC("MemSet", tracy::Color::Brown);
+                MemSet* setCmd = reinterpret_cast<MemSet*>(ip);
 
-                    AllocateHeap(size, address);
-                    memcpy(&_memory[address], str.c_str(), size);
+                u64 destinationAddress = *GetRegister(setCmd->destination);
+                u8 value = setCmd->valueRegister != Register::None ? static_cast<u8>(*GetRegister(setCmd->valueRegister)) : setCmd->value;
+                u64 size = setCmd->sizeRegister != Register::None ? *GetRegister(setCmd->sizeRegister) : setCmd->size;
 
-                    module->bytecodeInfo.stringIndexToHeapAddress[createStringCmd->strIndex] = address;
-                }
-                else
-                {
-                    address = itr->second;
-                }
+                memset(&_memory[destinationAddress], value, size);
+
+                ip += sizeof(MemSet);
+                break;
+            }
+
+            case ByteOpcode::Kind::CreateStringOnHeap:
+            {
+                ZoneScopedNC("CreateStringOnHeap", tracy::Color::SandyBrown);
+
+                CreateStringOnHeap* createStringCmd = reinterpret_cast<CreateStringOnHeap*>(ip);
 
-                *GetRegister(Register::Rax) = address;
+                *GetRegister(Register::Rax) = GetStringAddress(module, createStringCmd->strIndex);
                 ip += sizeof(CreateStringOnHeap);
                 break;
             }
@@ -292,20 +382,69 @@ void Interpreter::Interpret(Module* module, Declaration* declaration)
             {
                 ZoneScopedNC("Function Call", tracy::Color::Violet);
                 FunctionCall* callCmd = reinterpret_cast<FunctionCall*>(ip);
-                Declaration* funcDeclaration = module->bytecodeInfo.functionHashToDeclaration[callCmd->callhash];
 
-                if (funcDeclaration->function.flags.nativeCall)
+                CallFunction(module, callCmd->callhash);
+
+                ip += sizeof(FunctionCall);
+                break;
+            }
+            case ByteOpcode::Kind::TailCall:
+            {
+                ZoneScopedNC("Tail Call", tracy::Color::Violet);
+                TailCall* callCmd = reinterpret_cast<TailCall*>(ip);
+
+                // Copied out of the instruction, find binds a reference to its key and the instruction isn't aligned
+                u32 functionHash = callCmd->callhash;
+
+                if (_hasPendingReload)
                 {
-                    _callStack.push(funcDeclaration);
-                    module->_nativeFunctionHashToCallback[callCmd->callhash](this);
-                    _callStack.pop();
+                    ApplyReloads();
                 }
-                else
+
+                CountHotness(module, functionHash, 1);
+
+                auto itr = module->bytecodeInfo.functionHashToMemoryInfo.find(functionHash);
+                if (itr == module->bytecodeInfo.functionHashToMemoryInfo.end())
                 {
-                    Interpret(module, funcDeclaration);
+                    DebugHandler::PrintError("Interpreter : Called a Function that no longer exists in Module (%s)", module->nameHash.name.c_str());
+                    exit(1);
                 }
 
-                ip += sizeof(FunctionCall);
+                // Our frame is already gone, the callee takes over this Interpret call and its Ret returns to our caller
+                _callStack.top() = functionHash;
+
+                if (itr->second.isNative)
+                {
+                    CallNative(module, functionHash);
+                    ip = memoryEnd;
+                    break;
+                }
+
+                memoryInfo = itr->second;
+
+                // A promoted callee runs as machine code and returns straight to our caller
+                if (memoryInfo.jitCode)
+                {
+                    RunFunction(module, memoryInfo);
+                    ip = memoryEnd;
+                    break;
+                }
+
+                ip = memoryInfo.instructions;
+                memoryEnd = memoryInfo.instructions + memoryInfo.numInstructionBytes;
+                numBackEdges = 0;
+
+                if constexpr (IsVerified)
+                {
+                    // A reload may have swapped in code that failed verification
+                    if (!module->bytecodeInfo.isVerified)
+                    {
+                        Execute<false>(module, memoryInfo);
+                        return;
+                    }
+
+                    CheckStackBounds(memoryInfo);
+                }
                 break;
             }
             case ByteOpcode::Kind::Ret:
@@ -796,13 +935,166 @@ void Interpreter::Interpret(Module* module, Declaration* declaration)
             }
         }
     }
+}
 
-#if NAI_DEBUG
-    DebugHandler::PrintSuccess("Interpreter : Function(%.*s) Returned (%u)", declaration->token->nameHash.length, declaration->token->nameHash.name, *GetRegister(Register::Rax));
-#endif // NAI_DEBUG
+void Interpreter::CallFunction(Module* module, u32 functionHash)
+{
+    // A reload may have removed the function since this code was generated
+    if (_hasPendingReload)
+    {
+        ApplyReloads();
+    }
 
-    _callStack.pop();
-    _moduleStack.pop();
+    auto itr = module->bytecodeInfo.functionHashToMemoryInfo.find(functionHash);
+    if (itr == module->bytecodeInfo.functionHashToMemoryInfo.end())
+    {
+        DebugHandler::PrintError("Interpreter : Called a Function that no longer exists in Module (%s)", module->nameHash.name.c_str());
+        exit(1);
+    }
+
+    if (itr->second.isNative)
+    {
+        _callStack.push(functionHash);
+        CallNative(module, functionHash);
+        _callStack.pop();
+    }
+    else
+    {
+        Interpret(module, functionHash);
+    }
+}
+
+void Interpreter::CallNative(Module* module, u32 functionHash)
+{
+    auto itr = module->_nativeFunctionHashToBinding.find(functionHash);
+    if (itr == module->_nativeFunctionHashToBinding.end() || !itr->second.callback)
+    {
+        DebugHandler::PrintError("Interpreter : Native Function has not been bound in Module (%s)", module->nameHash.name.c_str());
+        exit(1);
+    }
+
+    // The callback can call back into Nai and from there into another native, which has a layout of its own
+    const NativeParameterLocation* callerParameters = _nativeParameters;
+    u32 numCallerParameters = _numNativeParameters;
+
+    const NativeFunctionBinding& binding = itr->second;
+    _nativeParameters = binding.parameters.data();
+    _numNativeParameters = static_cast<u32>(binding.parameters.size());
+
+    binding.callback(this);
+
+    _nativeParameters = callerParameters;
+    _numNativeParameters = numCallerParameters;
+}
+
+u64 Interpreter::GetStringAddress(Module* module, u16 strIndex)
+{
+    // Every use of a string literal shares the same copy on the heap
+    auto itr = module->bytecodeInfo.stringIndexToHeapAddress.find(strIndex);
+    if (itr != module->bytecodeInfo.stringIndexToHeapAddress.end())
+        return itr->second;
+
+    const std::string& str = module->bytecodeInfo.stringTable.GetString(strIndex);
+    size_t size = str.length() + 1;
+    size_t address = 0;
+
+    AllocateHeap(size, address);
+    memcpy(&_memory[address], str.c_str(), size);
+
+    module->bytecodeInfo.stringIndexToHeapAddress[strIndex] = address;
+    return address;
+}
+
+void Interpreter::CheckStackBounds(const FunctionMemoryInfo& memoryInfo)
+{
+    u64 rsp = *GetRegister(Register::Rsp);
+
+    if (rsp < memoryInfo.maxStackDepth)
+    {
+        DebugHandler::PrintError("Interpreter : Stack overflow");
+        exit(1);
+    }
+
+    if (rsp + memoryInfo.maxStackRise > StackSize)
+    {
+        DebugHandler::PrintError("Interpreter : Stack underflow");
+        exit(1);
+    }
+}
+
+void Interpreter::CountHotness(Module* module, u32 functionHash, u32 amount)
+{
+    JitInfo& jitInfo = module->jitInfo;
+    if (!jitInfo.isEnabled || !jitInfo.isTiered)
+        return;
+
+    auto itr = module->bytecodeInfo.functionHashToMemoryInfo.find(functionHash);
+    if (itr == module->bytecodeInfo.functionHashToMemoryInfo.end())
+        return;
+
+    // Functions at the threshold were promoted already, or the Jit declined them, either way there's nothing left to count
+    FunctionMemoryInfo& memoryInfo = itr->second;
+    if (memoryInfo.isNative || memoryInfo.hotness >= jitInfo.promotionThreshold)
+        return;
+
+    memoryInfo.hotness += amount;
+    if (memoryInfo.hotness >= jitInfo.promotionThreshold)
+    {
+        Jit::Promote(module, functionHash);
+    }
+}
+
+void Interpreter::QueueReload(Module* module, const char* source, size_t size)
+{
+    std::unique_lock lock(_reloadMutex);
+
+    PendingReload& reload = _pendingReloads.emplace_back();
+    reload.module = module;
+    reload.source.assign(source, size);
+
+    _hasPendingReload = true;
+}
+
+void Interpreter::ApplyReloads()
+{
+    std::vector<PendingReload> reloads;
+    {
+        std::unique_lock lock(_reloadMutex);
+
+        reloads = std::move(_pendingReloads);
+        _pendingReloads.clear();
+        _hasPendingReload = false;
+    }
+
+    for (PendingReload& reload : reloads)
+    {
+        Incremental::Parse(reload.module, reload.source.data(), reload.source.size());
+        Incremental::Compile(reload.module);
+
+        _reloadedModules.push_back(reload.module);
+    }
+
+    if (_callStack.empty())
+    {
+        ReleaseRetiredCode();
+    }
+}
+
+void Interpreter::ReleaseRetiredCode()
+{
+    for (Module* module : _reloadedModules)
+    {
+        module->bytecodeInfo.retiredOpcodes.clear();
+
+        for (ExecutableMemory* code : module->jitInfo.retiredCode)
+        {
+            delete code;
+        }
+
+        module->jitInfo.retiredCode.clear();
+    }
+
+    _reloadedModules.clear();
 }
 
 void Interpreter::AllocateHeap(size_t size, size_t& address)
@@ -3,10 +3,16 @@
 #include "ByteOpcode.h"
 #include "Utils/LinkedList.h"
 #include "Memory/BufferAllocator.h"
+#include <cstring>
 #include <stack>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
 
 struct Module;
 struct Declaration;
+struct FunctionMemoryInfo;
 
 class Interpreter
 {
@@ -20,55 +26,41 @@ public:
     void Init();
 
     void Interpret(Module* module, Declaration* function);
+    void Interpret(Module* module, u32 functionHash);
 
+    // Recompiles the module from new source at the next safe point and swaps in the code of the functions that changed
+    // Safe to call from any thread, frames that are already running finish on the code they started with
+    // Heap and stack are left untouched
+    void QueueReload(Module* module, const char* source, size_t size);
+
+    // Only valid while a native callback runs, the location of each declared parameter was worked out when the native was bound
+    // Arguments past the declared ones, like the values print formats, follow the same convention
     template<typename T>
     T* GetParameter(u8 index, bool isPointer = false)
     {
         assert(index > 0);
 
-        // Get Value From Registers
-        if (index <= 4)
+        NativeParameterLocation location = index <= _numNativeParameters ? _nativeParameters[index - 1] : NativeParameterLocation::Get(index - 1);
+
+        u64* parameter = nullptr;
+        if (location.reg != Register::None)
         {
-            const static Register lookup[4] = { Register::Rcx, Register::Rdx, Register::R8, Register::R9 };
-
-            Register reg = static_cast<Register>(lookup[index - 1]);
-
-            if (isPointer)
-            {
-                u64 parameterAddress = *GetRegister(reg);
-                T* ptr = reinterpret_cast<T*>(&_memory[parameterAddress]);
-                return ptr;
-            }
-            else
-            {
-                return reinterpret_cast<T*>(GetRegister(reg));
-            }
+            parameter = GetRegister(location.reg);
         }
-        // Get Value From Stack
         else
         {
-            assert(_moduleStack.size() > 0);
-            assert(_callStack.size() > 0);
-            Module* currModule = _moduleStack.top();
-            Declaration* currFunc = _callStack.top();
-
-            FunctionParamInfo& paramInfo = currModule->bytecodeInfo.functionHashToParamInfo[currFunc->token->nameHash.hash];
-            Declaration* param = paramInfo.declarations[index - 1];
-
-            // Native functions don't setup a function frame in Nai because the code runs in a cpp callback, therefore Rsp is "actually" storing our Rbp
-            u64* rbp = GetRegister(Register::Rsp);
-            size_t stackAddress = (*rbp + paramInfo.extraParameterStackSpace) - param->variable.offset;
-
-            if (isPointer)
-            {
-                u64 ptrAddress = _memory[stackAddress];
-                return reinterpret_cast<T*>(&_memory[ptrAddress]);
-            }
-            else
-            {
-                return reinterpret_cast<T*>(&_memory[stackAddress]);
-            }
+            parameter = reinterpret_cast<u64*>(&_memory[*GetRegister(Register::Rsp) + location.stackOffset]);
+        }
+
+        if (isPointer)
+        {
+            u64 parameterAddress;
+            memcpy(&parameterAddress, parameter, sizeof(u64));
+
+            return reinterpret_cast<T*>(&_memory[parameterAddress]);
         }
+
+        return reinterpret_cast<T*>(parameter);
     }
     u64* GetRegister(Register reg)
     {
@@ -80,11 +72,43 @@ public:
     void AllocateHeap(size_t size, size_t& address);
     void FreeHeap(size_t address);
 
+private:
+    friend class Jit;
+
+    struct PendingReload
+    {
+    public:
+        Module* module = nullptr;
+        std::string source;
+    };
+
+    // Runs the function as machine code when the Jit translated it, in the Interpreter otherwise
+    void RunFunction(Module* module, FunctionMemoryInfo& memoryInfo);
+
+    // Runs the function's instructions, verified code skips the per instruction stack checks
+    template <bool IsVerified>
+    void Execute(Module* module, FunctionMemoryInfo& memoryInfo);
+    void CheckStackBounds(const FunctionMemoryInfo& memoryInfo);
+
+    // Adds to the function's hotness and has the Jit promote it once it reaches the threshold of a tiered module
+    void CountHotness(Module* module, u32 functionHash, u32 amount);
+
+    // Shared with the Jit, whose machine code calls back into the Interpreter for these
+    void CallFunction(Module* module, u32 functionHash);
+    void CallNative(Module* module, u32 functionHash);
+    u64 GetStringAddress(Module* module, u16 strIndex);
+
+    void ApplyReloads();
+    void ReleaseRetiredCode();
+
 private:
     static constexpr u32 RegisterCount = static_cast<u32>(Register::Count);
     static constexpr u32 StackSize = 1 * 1024 * 1024;
     static constexpr u32 HeapSize = 16 * 1024 * 1024;
 
+    // Loop iterations are counted locally and added to the function's hotness in batches of this many
+    static constexpr u32 BackEdgeBatchSize = 64;
+
     bool compareFlag = false;
     u64 _registers[RegisterCount];
     u8 _memory[StackSize + HeapSize];
@@ -92,5 +116,14 @@ private:
 
     BufferAllocator _bufferAllocator;
     std::stack<Module*> _moduleStack;
-    std::stack<Declaration*> _callStack;
+    std::stack<u32> _callStack;
+
+    // Parameter layout of the running native callback
+    const NativeParameterLocation* _nativeParameters = nullptr;
+    u32 _numNativeParameters = 0;
+
+    std::mutex _reloadMutex;
+    std::atomic<bool> _hasPendingReload = false;
+    std::vector<PendingReload> _pendingReloads;
+    std::vector<Module*> _reloadedModules;
 };
\ No newline at end of file
@@ -0,0 +1,614 @@
+#include "pch/Build.h"
+#include "RegisterAllocator.h"
+#include "../../Module.h"
+#include "../../IR/IR.h"
+
+#include <algorithm>
+#include <limits>
+
+void RegisterAllocator::Allocate(Module* /*module*/, Function* function, BytecodeContext* context)
+{
+    context->localRegisters.clear();
+    context->savedRegisters.clear();
+    context->liveParameters.clear();
+
+    RegisterAllocation allocation;
+    CollectCandidates(function->body->compound.scope, allocation);
+    CollectParameters(function, allocation);
+
+    NumberStatement(function->body, allocation);
+
+    for (auto& itr : allocation.excluded)
+    {
+        allocation.intervals.erase(itr.first);
+    }
+
+    ExtendOverLoops(allocation);
+    LinearScan(allocation, context);
+    FindLiveParameters(allocation, context);
+
+    context->isFrameAddressTaken = allocation.isFrameAddressTaken;
+}
+
+void RegisterAllocator::CollectCandidates(Scope* scope, RegisterAllocation& allocation)
+{
+    ListNode* node;
+    ListIterate(&scope->declarations, node)
+    {
+        Declaration* declaration = ListGetStructPtr(node, Declaration, listNode);
+
+        if (IsCandidate(declaration))
+        {
+            LiveInterval& interval = allocation.intervals[declaration];
+            interval.declaration = declaration;
+            interval.start = std::numeric_limits<u32>::max();
+        }
+    }
+
+    ListIterate(&scope->scopeChildren, node)
+    {
+        Scope* subScope = ListGetStructPtr(node, Scope, listNode);
+        CollectCandidates(subScope, allocation);
+    }
+}
+
+void RegisterAllocator::CollectParameters(Function* function, RegisterAllocation& allocation)
+{
+    u32 numParameters = 0;
+
+    ListNode* node;
+    ListIterate(&function->scope->declarations, node)
+    {
+        Declaration* declaration = ListGetStructPtr(node, Declaration, listNode);
+        if (declaration->kind != Declaration::Kind::Variable)
+            continue;
+
+        LiveInterval& interval = allocation.parameterIntervals[numParameters];
+        interval.declaration = declaration;
+        interval.reg = ParameterRegisters[numParameters];
+
+        if (++numParameters == NumParameterRegisters)
+            break;
+    }
+}
+
+bool RegisterAllocator::IsCandidate(Declaration* declaration)
+{
+    if (declaration->kind != Declaration::Kind::Variable)
+        return false;
+
+    Type* type = declaration->type;
+
+    // Arrays live in the frame, their identifier evaluates to the address of the first element
+    if (type->kind == Type::Kind::Pointer)
+        return type->pointer.count == 0;
+
+    return type->kind == Type::Kind::Basic && type->size <= 8;
+}
+
+void RegisterAllocator::NumberStatement(Statement* statement, RegisterAllocation& allocation)
+{
+    switch (statement->kind)
+    {
+        case Statement::Kind::Compound:
+        {
+            ListNode* node;
+            ListIterate(&statement->compound.statements, node)
+            {
+                Statement* stmt = ListGetStructPtr(node, Statement, listNode);
+                NumberStatement(stmt, allocation);
+            }
+            break;
+        }
+        case Statement::Kind::Expression:
+        {
+            NumberExpression(statement->expression, allocation);
+            break;
+        }
+        case Statement::Kind::Return:
+        {
+            if (statement->returnStmt.expression)
+            {
+                NumberExpression(statement->returnStmt.expression, allocation);
+            }
+            break;
+        }
+        case Statement::Kind::Conditional:
+        {
+            Conditional* conditional = &statement->conditional;
+
+            NumberExpression(conditional->condition, allocation);
+            NumberStatement(conditional->trueBody, allocation);
+
+            if (conditional->falseBody)
+            {
+                NumberStatement(conditional->falseBody, allocation);
+            }
+            break;
+        }
+        case Statement::Kind::Loop:
+        {
+            LoopRange range;
+            range.start = allocation.position++;
+
+            NumberExpression(statement->loop.condition, allocation);
+            NumberStatement(statement->loop.body, allocation);
+
+            range.end = allocation.position++;
+            allocation.loops.push_back(range);
+            break;
+        }
+
+        default:
+        {
+            break;
+        }
+    }
+}
+
+void RegisterAllocator::NumberExpression(Expression* expression, RegisterAllocation& allocation)
+{
+    switch (expression->kind)
+    {
+        case Expression::Kind::Primary:
+        {
+            if (expression->primary.kind == Primary::Kind::Identifier)
+            {
+                NumberReference(expression->primary.declaration, allocation);
+            }
+            break;
+        }
+        case Expression::Kind::Unary:
+        {
+            if (expression->unary.kind == Unary::Kind::AddressOf)
+            {
+                ExcludeAddressTaken(expression->unary.operand, allocation);
+                allocation.isFrameAddressTaken = true;
+            }
+
+            NumberExpression(expression->unary.operand, allocation);
+            break;
+        }
+        case Expression::Kind::Binary:
+        {
+            Binary* binary = &expression->binary;
+
+            // Same order as Bytecode, locals in registers are stored after the right hand side is evaluated
+            if (binary->kind == Binary::Kind::Assign && binary->left->kind == Expression::Kind::Primary)
+            {
+                NumberExpression(binary->right, allocation);
+                NumberExpression(binary->left, allocation);
+            }
+            else if (binary->kind == Binary::Kind::Assign || binary->kind == Binary::Kind::LogicalAnd || binary->kind == Binary::Kind::LogicalOr)
+            {
+                NumberExpression(binary->left, allocation);
+                NumberExpression(binary->right, allocation);
+            }
+            else
+            {
+                NumberExpression(binary->right, allocation);
+                NumberExpression(binary->left, allocation);
+            }
+            break;
+        }
+        case Expression::Kind::Call:
+        {
+            ListNode* node;
+            ListIterateReverse(&expression->call.arguments, node)
+            {
+                Expression* argument = ListGetStructPtr(node, Expression, listNode);
+                NumberExpression(argument, allocation);
+            }
+
+            allocation.callPositions[expression] = allocation.position++;
+            break;
+        }
+        case Expression::Kind::Dot:
+        {
+            ExcludeAddressTaken(expression->dot.expression, allocation);
+            NumberExpression(expression->dot.expression, allocation);
+            break;
+        }
+        case Expression::Kind::MemoryNew:
+        case Expression::Kind::MemoryFree:
+        {
+            NumberExpression(expression->memory.expression, allocation);
+            break;
+        }
+
+        default:
+        {
+            break;
+        }
+    }
+}
+
+void RegisterAllocator::NumberReference(Declaration* declaration, RegisterAllocation& allocation)
+{
+    u32 position = allocation.position++;
+
+    for (LiveInterval& interval : allocation.parameterIntervals)
+    {
+        if (interval.declaration == declaration)
+        {
+            interval.end = std::max(interval.end, position);
+            return;
+        }
+    }
+
+    auto itr = allocation.intervals.find(declaration);
+    if (itr == allocation.intervals.end())
+        return;
+
+    LiveInterval& interval = itr->second;
+    interval.start = std::min(interval.start, position);
+    interval.end = std::max(interval.end, position);
+}
+
+void RegisterAllocator::ExcludeAddressTaken(Expression* expression, RegisterAllocation& allocation)
+{
+    while (expression->kind == Expression::Kind::Dot)
+    {
+        expression = expression->dot.expression;
+    }
+
+    if (expression->kind == Expression::Kind::Primary && expression->primary.kind == Primary::Kind::Identifier)
+    {
+        allocation.excluded[expression->primary.declaration] = true;
+    }
+}
+
+void RegisterAllocator::ExtendOverLoops(RegisterAllocation& allocation)
+{
+    // A local referenced inside a loop may carry its value around the back edge, so it has to stay live for the whole loop
+    auto Extend = [&allocation](LiveInterval& interval)
+    {
+        for (const LoopRange& loop : allocation.loops)
+        {
+            if (interval.start <= loop.end && interval.end >= loop.start)
+            {
+                interval.start = std::min(interval.start, loop.start);
+                interval.end = std::max(interval.end, loop.end);
+            }
+        }
+    };
+
+    for (auto& itr : allocation.intervals)
+    {
+        Extend(itr.second);
+    }
+
+    for (LiveInterval& interval : allocation.parameterIntervals)
+    {
+        if (interval.declaration)
+        {
+            Extend(interval);
+        }
+    }
+}
+
+void RegisterAllocator::LinearScan(RegisterAllocation& allocation, BytecodeContext* context)
+{
+    std::vector<LiveInterval*> intervals;
+    for (auto& itr : allocation.intervals)
+    {
+        // Declared but never referenced
+        if (itr.second.start > itr.second.end)
+            continue;
+
+        intervals.push_back(&itr.second);
+    }
+
+    // Ties are broken on the declaration's position in the source, so the allocation doesn't depend on map order
+    std::sort(intervals.begin(), intervals.end(), [](LiveInterval* a, LiveInterval* b)
+    {
+        if (a->start != b->start)
+            return a->start < b->start;
+
+        return a->declaration->token->nameHash.name < b->declaration->token->nameHash.name;
+    });
+
+    ScanIntervals(intervals);
+
+    for (LiveInterval* interval : intervals)
+    {
+        if (interval->reg == Register::None)
+            continue;
+
+        context->localRegisters[interval->declaration] = interval->reg;
+    }
+
+    SaveUsedRegisters(intervals, context);
+}
+
+void RegisterAllocator::ScanIntervals(std::vector<LiveInterval*>& intervals)
+{
+    std::vector<Register> freeRegisters(std::rbegin(LocalRegisters), std::rend(LocalRegisters));
+    std::vector<LiveInterval*> active;
+
+    for (LiveInterval* interval : intervals)
+    {
+        // Expire everything that ended before this interval starts
+        for (auto itr = active.begin(); itr != active.end();)
+        {
+            if ((*itr)->end < interval->start)
+            {
+                freeRegisters.push_back((*itr)->reg);
+                itr = active.erase(itr);
+            }
+            else
+            {
+                itr++;
+            }
+        }
+
+        if (freeRegisters.size())
+        {
+            interval->reg = freeRegisters.back();
+            freeRegisters.pop_back();
+
+            active.push_back(interval);
+            continue;
+        }
+
+        // Out of registers, whichever interval lives the longest stays in the frame
+        auto furthest = std::max_element(active.begin(), active.end(), [](LiveInterval* a, LiveInterval* b) { return a->end < b->end; });
+        if ((*furthest)->end > interval->end)
+        {
+            interval->reg = (*furthest)->reg;
+            (*furthest)->reg = Register::None;
+
+            *furthest = interval;
+        }
+    }
+}
+
+void RegisterAllocator::SaveUsedRegisters(const std::vector<LiveInterval*>& intervals, BytecodeContext* context)
+{
+    bool isUsed[NumLocalRegisters] = { };
+    for (LiveInterval* interval : intervals)
+    {
+        if (interval->reg == Register::None)
+            continue;
+
+        isUsed[static_cast<u32>(interval->reg) - static_cast<u32>(LocalRegisters[0])] = true;
+    }
+
+    for (u32 i = 0; i < NumLocalRegisters; i++)
+    {
+        if (isUsed[i])
+        {
+            context->savedRegisters.push_back(LocalRegisters[i]);
+        }
+    }
+}
+
+void RegisterAllocator::AllocateValues(IRFunction* function, BytecodeContext* context)
+{
+    context->savedRegisters.clear();
+    context->valueRegisters.assign(function->numInstructions, Register::None);
+
+    std::vector<LiveInterval> valueIntervals(function->numInstructions);
+    ComputeValueIntervals(function, valueIntervals);
+
+    std::vector<LiveInterval*> intervals;
+    for (LiveInterval& interval : valueIntervals)
+    {
+        if (interval.value)
+        {
+            intervals.push_back(&interval);
+        }
+    }
+
+    // Ties are broken on the id, so the allocation doesn't depend on anything but the IR
+    std::sort(intervals.begin(), intervals.end(), [](LiveInterval* a, LiveInterval* b)
+    {
+        if (a->start != b->start)
+            return a->start < b->start;
+
+        return a->value->id < b->value->id;
+    });
+
+    ScanIntervals(intervals);
+
+    for (LiveInterval* interval : intervals)
+    {
+        context->valueRegisters[interval->value->id] = interval->reg;
+    }
+
+    SaveUsedRegisters(intervals, context);
+}
+
+void RegisterAllocator::ComputeValueIntervals(IRFunction* function, std::vector<LiveInterval>& intervals)
+{
+    std::vector<IRBlock*>& blocks = function->blocks;
+    u32 numValues = function->numInstructions;
+
+    // Constants and frame addresses are materialized at every use, they never need a home
+    auto IsValue = [](IRInstruction* value)
+    {
+        return value->kind != IRInstruction::Kind::Constant && value->kind != IRInstruction::Kind::FrameAddress;
+    };
+
+    auto Extend = [&intervals](u32 id, u32 position)
+    {
+        LiveInterval& interval = intervals[id];
+        interval.start = std::min(interval.start, position);
+        interval.end = std::max(interval.end, position);
+    };
+
+    for (LiveInterval& interval : intervals)
+    {
+        interval.start = std::numeric_limits<u32>::max();
+    }
+
+    robin_hood::unordered_map<IRBlock*, u32> blockIndices;
+    std::vector<u32> blockStarts(blocks.size());
+    std::vector<u32> blockEnds(blocks.size());
+
+    std::vector<std::vector<bool>> uses(blocks.size(), std::vector<bool>(numValues));
+    std::vector<std::vector<bool>> definitions(blocks.size(), std::vector<bool>(numValues));
+
+    // Positions are the order Bytecode lowers the instructions in, Phis of a successor are read at the terminator of each predecessor
+    // Every instruction reads its operands before it writes its value, so reads get the even position and the write the odd one after it
+    // That lets a value take over the register of an operand that dies in the same instruction
+    u32 position = 0;
+    for (u32 i = 0; i < blocks.size(); i++)
+    {
+        IRBlock* block = blocks[i];
+        blockIndices[block] = i;
+        blockStarts[i] = position;
+
+        for (IRInstruction* instruction : block->instructions)
+        {
+            if (instruction->kind != IRInstruction::Kind::Phi)
+            {
+                for (IRInstruction* operand : instruction->operands)
+                {
+                    if (!IsValue(operand))
+                        continue;
+
+                    Extend(operand->id, position * 2);
+
+                    if (!definitions[i][operand->id])
+                    {
+                        uses[i][operand->id] = true;
+                    }
+                }
+            }
+
+            if (instruction->HasValue())
+            {
+                intervals[instruction->id].value = instruction;
+                Extend(instruction->id, position * 2 + 1);
+
+                definitions[i][instruction->id] = true;
+            }
+
+            position++;
+        }
+
+        blockEnds[i] = position - 1;
+    }
+
+    // Values that flow around a loop are live in blocks placed after their last use, a straight walk over the positions misses those
+    std::vector<std::vector<bool>> liveIn(blocks.size(), std::vector<bool>(numValues));
+    std::vector<std::vector<bool>> liveOut(blocks.size(), std::vector<bool>(numValues));
+
+    bool isChanged = true;
+    while (isChanged)
+    {
+        isChanged = false;
+
+        for (u32 i = static_cast<u32>(blocks.size()); i-- > 0;)
+        {
+            IRBlock* successors[2];
+            u32 numSuccessors = blocks[i]->GetSuccessors(successors);
+
+            for (u32 j = 0; j < numSuccessors; j++)
+            {
+                auto itr = blockIndices.find(successors[j]);
+                if (itr == blockIndices.end())
+                    continue;
+
+                for (u32 id = 0; id < numValues; id++)
+                {
+                    if (liveIn[itr->second][id])
+                    {
+                        liveOut[i][id] = true;
+                    }
+                }
+
+                u32 predecessorIndex = successors[j]->GetPredecessorIndex(blocks[i]);
+                for (IRInstruction* phi : successors[j]->instructions)
+                {
+                    if (phi->kind != IRInstruction::Kind::Phi)
+                        break;
+
+                    IRInstruction* operand = phi->operands[predecessorIndex];
+                    if (IsValue(operand))
+                    {
+                        liveOut[i][operand->id] = true;
+                    }
+                }
+            }
+
+            for (u32 id = 0; id < numValues; id++)
+            {
+                bool isLive = uses[i][id] || (liveOut[i][id] && !definitions[i][id]);
+                if (isLive && !liveIn[i][id])
+                {
+                    liveIn[i][id] = true;
+                    isChanged = true;
+                }
+            }
+        }
+    }
+
+    // Intervals have no holes, a value is kept from its first to its last live position
+    // Phis are written by the terminator of each predecessor once it read its operands, so a Phi lives from there on
+    // Whatever is live into a successor lives past that write, an operand only feeding a Phi dies at the read and may hand over its register
+    for (u32 i = 0; i < blocks.size(); i++)
+    {
+        for (u32 id = 0; id < numValues; id++)
+        {
+            if (liveIn[i][id])
+            {
+                Extend(id, blockStarts[i] * 2);
+            }
+        }
+
+        IRBlock* successors[2];
+        u32 numSuccessors = blocks[i]->GetSuccessors(successors);
+
+        for (u32 j = 0; j < numSuccessors; j++)
+        {
+            auto itr = blockIndices.find(successors[j]);
+            if (itr == blockIndices.end())
+                continue;
+
+            for (u32 id = 0; id < numValues; id++)
+            {
+                if (liveIn[itr->second][id])
+                {
+                    Extend(id, blockEnds[i] * 2 + 1);
+                }
+            }
+
+            u32 predecessorIndex = successors[j]->GetPredecessorIndex(blocks[i]);
+            for (IRInstruction* phi : successors[j]->instructions)
+            {
+                if (phi->kind != IRInstruction::Kind::Phi)
+                    break;
+
+                Extend(phi->id, blockEnds[i] * 2 + 1);
+
+                IRInstruction* operand = phi->operands[predecessorIndex];
+                if (IsValue(operand))
+                {
+                    Extend(operand->id, blockEnds[i] * 2);
+                }
+            }
+        }
+    }
+}
+
+void RegisterAllocator::FindLiveParameters(RegisterAllocation& allocation, BytecodeContext* context)
+{
+    for (auto& itr : allocation.callPositions)
+    {
+        u8 liveParameters = 0;
+
+        for (u32 i = 0; i < NumParameterRegisters; i++)
+        {
+            const LiveInterval& interval = allocation.parameterIntervals[i];
+
+            if (interval.declaration && interval.end > itr.second)
+            {
+                liveParameters |= 1 << i;
+            }
+        }
+
+        context->liveParameters[itr.first] = liveParameters;
+    }
+}
@@ -0,0 +1,96 @@
+#pragma once
+#include "pch/Build.h"
+#include "robin_hood.h"
+#include "ByteOpcode.h"
+#include <vector>
+
+struct Module;
+struct BytecodeContext;
+struct Function;
+struct Scope;
+struct Statement;
+struct Expression;
+struct Declaration;
+struct IRFunction;
+struct IRInstruction;
+
+struct LiveInterval
+{
+public:
+    Declaration* declaration = nullptr;
+
+    // Set instead of the declaration for values of lowered IR
+    IRInstruction* value = nullptr;
+
+    // Positions are the order in which Bytecode visits the references to the local
+    u32 start = 0;
+    u32 end = 0;
+
+    Register reg = Register::None;
+};
+
+struct LoopRange
+{
+public:
+    u32 start = 0;
+    u32 end = 0;
+};
+
+struct RegisterAllocation
+{
+public:
+    u32 position = 0;
+
+    robin_hood::unordered_map<Declaration*, LiveInterval> intervals;
+    robin_hood::unordered_map<Declaration*, bool> excluded;
+
+    // Some address into the frame may have been handed out
+    bool isFrameAddressTaken = false;
+    std::vector<LoopRange> loops;
+
+    // Register passed parameters are live from the start of the function, only their end matters
+    LiveInterval parameterIntervals[4];
+    robin_hood::unordered_map<Expression*, u32> callPositions;
+};
+
+// Linear scan over the function's tree, keeps scalar locals whose address is never taken in VM registers
+// Functions lowered from the IR get the same treatment for their values
+// Registers handed out here are callee saved, Bytecode saves them in the prologue and restores them in the epilogue
+// The same intervals tell each call which of the caller's parameter registers are still needed once it returns
+class RegisterAllocator
+{
+public:
+    // R15 can't be the destination of a Load opcode, its register index doesn't fit in 4 bits
+    static constexpr Register LocalRegisters[] = { Register::R10, Register::R11, Register::R12, Register::R13, Register::R14 };
+    static constexpr u32 NumLocalRegisters = sizeof(LocalRegisters) / sizeof(Register);
+
+    // Temporaries of binary expressions are caller saved, Bytecode saves the ones holding a value around calls
+    static constexpr Register TemporaryRegisters[] = { Register::Rbx, Register::Rsi };
+    static constexpr u32 NumTemporaryRegisters = sizeof(TemporaryRegisters) / sizeof(Register);
+
+    static constexpr Register ParameterRegisters[] = { Register::Rcx, Register::Rdx, Register::R8, Register::R9 };
+    static constexpr u32 NumParameterRegisters = sizeof(ParameterRegisters) / sizeof(Register);
+
+    static void Allocate(Module* module, Function* function, BytecodeContext* context);
+
+    // The same scan over the values of a function lowered from its IR, liveness comes from its blocks so values live around a loop keep their register
+    // Values that don't get a register are spilled to a frame slot
+    static void AllocateValues(IRFunction* function, BytecodeContext* context);
+
+private:
+    static void CollectCandidates(Scope* scope, RegisterAllocation& allocation);
+    static void CollectParameters(Function* function, RegisterAllocation& allocation);
+    static bool IsCandidate(Declaration* declaration);
+
+    static void NumberStatement(Statement* statement, RegisterAllocation& allocation);
+    static void NumberExpression(Expression* expression, RegisterAllocation& allocation);
+    static void NumberReference(Declaration* declaration, RegisterAllocation& allocation);
+    static void ExcludeAddressTaken(Expression* expression, RegisterAllocation& allocation);
+
+    static void ExtendOverLoops(RegisterAllocation& allocation);
+    static void LinearScan(RegisterAllocation& allocation, BytecodeContext* context);
+    static void ScanIntervals(std::vector<LiveInterval*>& intervals);
+    static void SaveUsedRegisters(const std::vector<LiveInterval*>& intervals, BytecodeContext* context);
+    static void ComputeValueIntervals(IRFunction* function, std::vector<LiveInterval>& intervals);
+    static void FindLiveParameters(RegisterAllocation& allocation, BytecodeContext* context);
+};
@@ -0,0 +1,305 @@
+#include "pch/Build.h"
+#include "ObjectFile.h"
+#include "x86_64.h"
+#include "Compiler/Module.h"
+
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+// ELF64 layouts, spelled out here since elf.h doesn't exist on every host the compiler runs on
+struct ElfHeader
+{
+public:
+    u8 ident[16] = { 0x7F, 'E', 'L', 'F', 2, 1, 1 }; // 64 bit, little endian, current version
+    u16 type = 1; // Relocatable
+    u16 machine = 62; // x86-64
+    u32 version = 1;
+    u64 entry = 0;
+    u64 programHeaderOffset = 0;
+    u64 sectionHeaderOffset = 0;
+    u32 flags = 0;
+    u16 headerSize = sizeof(ElfHeader);
+    u16 programHeaderSize = 0;
+    u16 numProgramHeaders = 0;
+    u16 sectionHeaderSize = 64;
+    u16 numSectionHeaders = 0;
+    u16 sectionNameTableIndex = 0;
+};
+
+struct ElfSectionHeader
+{
+public:
+    u32 name = 0;
+    u32 type = 0;
+    u64 flags = 0;
+    u64 address = 0;
+    u64 offset = 0;
+    u64 size = 0;
+    u32 link = 0;
+    u32 info = 0;
+    u64 alignment = 0;
+    u64 entrySize = 0;
+};
+
+struct ElfSymbol
+{
+public:
+    u32 name = 0;
+    u8 info = 0;
+    u8 other = 0;
+    u16 sectionIndex = 0;
+    u64 value = 0;
+    u64 size = 0;
+};
+
+struct ElfRelocation
+{
+public:
+    u64 offset = 0;
+    u64 info = 0;
+    i64 addend = 0;
+};
+
+static_assert(sizeof(ElfHeader) == 64 && sizeof(ElfSectionHeader) == 64 && sizeof(ElfSymbol) == 24 && sizeof(ElfRelocation) == 24);
+
+constexpr u32 SectionTypeProgramData = 1;
+constexpr u32 SectionTypeSymbolTable = 2;
+constexpr u32 SectionTypeStringTable = 3;
+constexpr u32 SectionTypeRelocations = 4;
+
+constexpr u64 SectionFlagAllocate = 0x2;
+constexpr u64 SectionFlagExecute = 0x4;
+constexpr u64 SectionFlagInfoLink = 0x40;
+
+constexpr u8 SymbolLocalSection = (0 << 4) | 3;
+constexpr u8 SymbolGlobalFunction = (1 << 4) | 2;
+constexpr u8 SymbolGlobalUndefined = (1 << 4) | 0;
+
+constexpr u32 RelocationPc32 = 2;
+constexpr u32 RelocationPlt32 = 4;
+
+// Indices of the sections we write, in the order of their headers
+struct ElfSection
+{
+public:
+    enum : u16
+    {
+        Null,
+        Text,
+        RoData,
+        RelaText,
+        SymbolTable,
+        StringTable,
+        SectionNameTable,
+        NoteGnuStack,
+        Count
+    };
+};
+
+static u32 AddString(std::string& table, const std::string& string)
+{
+    u32 offset = static_cast<u32>(table.size());
+    table += string;
+    table += '\0';
+
+    return offset;
+}
+
+bool ObjectFile::Save(Module* module, const std::string& path)
+{
+    JitObject object;
+    if (!Jit::TranslateObject(module, object))
+        return false;
+
+    std::string stringTable(1, '\0');
+    std::vector<ElfSymbol> symbols(1);
+
+    // Relocations against the string data go through the section symbol of .rodata
+    u32 roDataSymbol = static_cast<u32>(symbols.size());
+    {
+        ElfSymbol& symbol = symbols.emplace_back();
+        symbol.info = SymbolLocalSection;
+        symbol.sectionIndex = ElfSection::RoData;
+    }
+
+    u32 firstGlobalSymbol = static_cast<u32>(symbols.size());
+
+    for (const JitSymbol& function : object.functions)
+    {
+        ElfSymbol& symbol = symbols.emplace_back();
+        symbol.name = AddString(stringTable, function.name);
+        symbol.info = SymbolGlobalFunction;
+        symbol.sectionIndex = ElfSection::Text;
+        symbol.value = function.codeOffset;
+        symbol.size = function.size;
+    }
+
+    // Everything the code references but doesn't define is left for the linker, one undefined symbol per name
+    robin_hood::unordered_map<std::string, u32> externalSymbols;
+    std::vector<ElfRelocation> relocations;
+
+    for (const JitRelocation& jitRelocation : object.relocations)
+    {
+        ElfRelocation& relocation = relocations.emplace_back();
+        relocation.offset = jitRelocation.codeOffset;
+        relocation.addend = jitRelocation.addend;
+
+        if (jitRelocation.symbol.empty())
+        {
+            relocation.info = (static_cast<u64>(roDataSymbol) << 32) | RelocationPc32;
+            continue;
+        }
+
+        auto itr = externalSymbols.find(jitRelocation.symbol);
+        if (itr == externalSymbols.end())
+        {
+            u32 symbolIndex = static_cast<u32>(symbols.size());
+
+            ElfSymbol& symbol = symbols.emplace_back();
+            symbol.name = AddString(stringTable, jitRelocation.symbol);
+            symbol.info = SymbolGlobalUndefined;
+
+            itr = externalSymbols.insert({ jitRelocation.symbol, symbolIndex }).first;
+        }
+
+        relocation.info = (static_cast<u64>(itr->second) << 32) | RelocationPlt32;
+    }
+
+    std::string sectionNameTable(1, '\0');
+    ElfSectionHeader sections[ElfSection::Count];
+
+    std::vector<u8> buffer(sizeof(ElfHeader));
+    auto Append = [&buffer](const void* data, size_t size, size_t alignment) -> u64
+    {
+        buffer.resize((buffer.size() + alignment - 1) & ~(alignment - 1));
+
+        u64 offset = buffer.size();
+        buffer.insert(buffer.end(), static_cast<const u8*>(data), static_cast<const u8*>(data) + size);
+
+        return offset;
+    };
+
+    {
+        ElfSectionHeader& section = sections[ElfSection::Text];
+        section.name = AddString(sectionNameTable, ".text");
+        section.type = SectionTypeProgramData;
+        section.flags = SectionFlagAllocate | SectionFlagExecute;
+        section.offset = Append(object.code.data(), object.code.size(), 16);
+        section.size = object.code.size();
+        section.alignment = 16;
+    }
+    {
+        ElfSectionHeader& section = sections[ElfSection::RoData];
+        section.name = AddString(sectionNameTable, ".rodata");
+        section.type = SectionTypeProgramData;
+        section.flags = SectionFlagAllocate;
+        section.offset = Append(object.stringData.data(), object.stringData.size(), 1);
+        section.size = object.stringData.size();
+        section.alignment = 1;
+    }
+    {
+        ElfSectionHeader& section = sections[ElfSection::RelaText];
+        section.name = AddString(sectionNameTable, ".rela.text");
+        section.type = SectionTypeRelocations;
+        section.flags = SectionFlagInfoLink;
+        section.offset = Append(relocations.data(), relocations.size() * sizeof(ElfRelocation), 8);
+        section.size = relocations.size() * sizeof(ElfRelocation);
+        section.link = ElfSection::SymbolTable;
+        section.info = ElfSection::Text;
+        section.alignment = 8;
+        section.entrySize = sizeof(ElfRelocation);
+    }
+    {
+        ElfSectionHeader& section = sections[ElfSection::SymbolTable];
+        section.name = AddString(sectionNameTable, ".symtab");
+        section.type = SectionTypeSymbolTable;
+        section.offset = Append(symbols.data(), symbols.size() * sizeof(ElfSymbol), 8);
+        section.size = symbols.size() * sizeof(ElfSymbol);
+        section.link = ElfSection::StringTable;
+        section.info = firstGlobalSymbol;
+        section.alignment = 8;
+        section.entrySize = sizeof(ElfSymbol);
+    }
+    {
+        ElfSectionHeader& section = sections[ElfSection::StringTable];
+        section.name = AddString(sectionNameTable, ".strtab");
+        section.type = SectionTypeStringTable;
+        section.offset = Append(stringTable.data(), stringTable.size(), 1);
+        section.size = stringTable.size();
+        section.alignment = 1;
+    }
+    {
+        // Without it linkers assume the object needs an executable stack
+        ElfSectionHeader& section = sections[ElfSection::NoteGnuStack];
+        section.name = AddString(sectionNameTable, ".note.GNU-stack");
+        section.type = SectionTypeProgramData;
+        section.offset = buffer.size();
+        section.alignment = 1;
+    }
+    {
+        ElfSectionHeader& section = sections[ElfSection::SectionNameTable];
+        section.name = AddString(sectionNameTable, ".shstrtab");
+        section.type = SectionTypeStringTable;
+        section.offset = Append(sectionNameTable.data(), sectionNameTable.size(), 1);
+        section.size = sectionNameTable.size();
+        section.alignment = 1;
+    }
+
+    ElfHeader header;
+    header.sectionHeaderOffset = Append(sections, sizeof(sections), 8);
+    header.numSectionHeaders = ElfSection::Count;
+    header.sectionNameTableIndex = ElfSection::SectionNameTable;
+
+    memcpy(buffer.data(), &header, sizeof(ElfHeader));
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file)
+    {
+        DebugHandler::PrintError("ObjectFile : Failed to open (%s) for writing", path.c_str());
+        return false;
+    }
+
+    file.write(reinterpret_cast<const char*>(buffer.data()), buffer.size());
+    if (!file)
+    {
+        DebugHandler::PrintError("ObjectFile : Failed to write (%s)", path.c_str());
+        return false;
+    }
+
+    DebugHandler::PrintSuccess("ObjectFile : Successfully Saved Module (%s) (Functions: %u, Imports: %u, Bytes: %u)", module->nameHash.name.c_str(), static_cast<u32>(object.functions.size()), static_cast<u32>(externalSymbols.size()), static_cast<u32>(buffer.size()));
+    return true;
+}
+
+std::string ObjectFile::GetSymbolName(Module* module, u32 functionHash)
+{
+    BytecodeInfo& bytecodeInfo = module->bytecodeInfo;
+
+    // Images keep no names for their own functions, the hash is all there is to go by
+    auto itr = bytecodeInfo.functionHashToDeclaration.find(functionHash);
+    if (itr == bytecodeInfo.functionHashToDeclaration.end())
+    {
+        char name[16];
+        snprintf(name, sizeof(name), "nai_%08x", functionHash);
+        return name;
+    }
+
+    NameHashView& nameHash = itr->second->token->nameHash;
+    return "nai_" + std::string(nameHash.name, nameHash.length);
+}
+
+std::string ObjectFile::GetNativeSymbolName(Module* module, u32 functionHash)
+{
+    BytecodeInfo& bytecodeInfo = module->bytecodeInfo;
+
+    auto itr = bytecodeInfo.functionHashToDeclaration.find(functionHash);
+    if (itr == bytecodeInfo.functionHashToDeclaration.end())
+    {
+        char name[24];
+        snprintf(name, sizeof(name), "nai_native_%08x", functionHash);
+        return name;
+    }
+
+    NameHashView& nameHash = itr->second->token->nameHash;
+    return "nai_native_" + std::string(nameHash.name, nameHash.length);
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include "pch/Build.h"
+#include <string>
+
+struct Module;
+
+// Saves a module as a relocatable x86-64 ELF object, to link into a Linux host that runs scripts without the Interpreter or the compiler
+//
+// Every Nai function foo is exported as: void nai_foo(void* userData, u64* registers, u8* memory)
+// - registers holds the 16 VM registers in the order Rax, Rbx, Rcx, Rdx, Rsi, Rdi, Rsp, Rbp, R8 to R15
+// - memory is the VM memory, a VM address is an offset into it. The stack grows down from the address in Rsp, the host points Rsp and Rbp at the end of the stack before the first call
+// - Parameters go in Rcx, Rdx, R8 and R9, the fifth and later ones in 8 byte slots on the stack starting at Rsp. The result comes back in Rax
+// - userData is passed through untouched to every function the code calls back into
+//
+// Every native function bar is imported as: void nai_native_bar(void* userData, u64* registers, u8* memory)
+// It reads its parameters and writes its result the same way
+//
+// The host also defines these, with the same signature
+// - nai_memory_new, allocates Rax bytes of VM memory and returns the address in Rax
+// - nai_memory_free, frees the VM memory at the address in Rax
+// - nai_create_string, takes the string as a fourth const char* parameter and returns the VM address of a copy in Rax, the copy may be shared by every call with the same string
+//
+// MemCopy and MemSet call memmove and memset of the C runtime
+class ObjectFile
+{
+public:
+    static constexpr const char* MemoryNewSymbol = "nai_memory_new";
+    static constexpr const char* MemoryFreeSymbol = "nai_memory_free";
+    static constexpr const char* CreateStringSymbol = "nai_create_string";
+
+    static bool Save(Module* module, const std::string& path);
+
+    static std::string GetSymbolName(Module* module, u32 functionHash);
+    static std::string GetNativeSymbolName(Module* module, u32 functionHash);
+};
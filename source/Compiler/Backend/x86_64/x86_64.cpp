@@ -1 +1,1499 @@
-#include "pch/Build.h"
\ No newline at end of file
+#include "pch/Build.h"
+#include "x86_64.h"
+#include "Compiler/Module.h"
+#include "Compiler/Backend/Bytecode/Interpreter.h"
+#include "Utils/ExecutableMemory.h"
+#include "ObjectFile.h"
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+// A rel32 that jumps to a bytecode offset of the function being translated, patched once the function is done
+struct JitPatch
+{
+public:
+    u32 codeOffset = 0;
+    u32 target = 0;
+};
+
+// A call of another function of the module in object code, resolved once every function has been translated
+struct JitCall
+{
+public:
+    u32 codeOffset = 0;
+    u32 functionHash = 0;
+
+    // Tail calls jump past the entry of the callee, straight into its body
+    bool isTail = false;
+};
+
+struct JitContext
+{
+public:
+    std::vector<u8> code;
+    const HostRegister* argumentRegisters = nullptr;
+
+    // Set when translating for an ObjectFile, the code can't hold any absolute address then
+    JitObject* object = nullptr;
+    std::vector<u32> stringOffsets;
+    std::vector<JitCall> calls;
+
+    // Exit copies the host registers back into the register file first, ExitNoStore is for when it already holds them
+    u32 exitOffset = 0;
+    u32 exitNoStoreOffset = 0;
+
+    // Code offset of every instruction of the function being translated, indexed by its bytecode offset
+    std::vector<u32> instructionOffsets;
+    std::vector<JitPatch> patches;
+};
+
+thread_local JitContext* Jit::_context = nullptr;
+
+constexpr HostRegister RegisterFile = HostRegister::R14;
+constexpr HostRegister MemoryBase = HostRegister::R15;
+constexpr HostRegister StackPointer = HostRegister::R12;
+constexpr HostRegister BasePointer = HostRegister::R13;
+
+// Rax and Rdx are never given to a VM register, they are the scratch registers and Div needs them anyway
+constexpr HostRegister RegisterMap[] =
+{
+    HostRegister::None, // None
+    HostRegister::Rdi, // Rax
+    HostRegister::Rbx, // Rbx
+    HostRegister::Rcx, // Rcx
+    HostRegister::Rbp, // Rdx
+    HostRegister::Rsi, // Rsi
+    HostRegister::None, // Rdi
+    StackPointer, // Rsp
+    BasePointer, // Rbp
+    HostRegister::R8, // R8
+    HostRegister::R9, // R9
+    HostRegister::R10, // R10
+    HostRegister::R11, // R11
+    HostRegister::None, // R12
+    HostRegister::None, // R13
+    HostRegister::None, // R14
+    HostRegister::None // R15
+};
+
+// Object files always target Linux, the Jit targets whatever it runs on
+constexpr HostRegister SystemVArgumentRegisters[] = { HostRegister::Rdi, HostRegister::Rsi, HostRegister::Rdx, HostRegister::Rcx };
+#ifdef _WIN32
+constexpr HostRegister ArgumentRegisters[] = { HostRegister::Rcx, HostRegister::Rdx, HostRegister::R8, HostRegister::R9 };
+#else
+constexpr const HostRegister* ArgumentRegisters = SystemVArgumentRegisters;
+#endif
+
+// Callee saved on either ABI, Enter pushes all of them so the translated code is free to use every register
+constexpr HostRegister SavedRegisters[] = { HostRegister::Rbx, HostRegister::Rbp, HostRegister::Rsi, HostRegister::Rdi, HostRegister::R12, HostRegister::R13, HostRegister::R14, HostRegister::R15 };
+
+// Shadow space for helpers on Windows followed by our own slots, keeps the host stack 16 byte aligned at every call
+constexpr i32 FrameSize = 56;
+constexpr i32 InterpreterSlot = 32;
+constexpr i32 CompareFlagSlot = 40;
+
+// Condition codes of Jcc and SETcc, comparisons in Nai are unsigned
+constexpr u8 ConditionBelow = 0x2;
+constexpr u8 ConditionAboveOrEqual = 0x3;
+constexpr u8 ConditionEqual = 0x4;
+constexpr u8 ConditionNotEqual = 0x5;
+constexpr u8 ConditionBelowOrEqual = 0x6;
+constexpr u8 ConditionAbove = 0x7;
+constexpr u8 ConditionAlways = 0xFF;
+
+// Opcodes of the "register, register or memory" form, the byte form is always one less
+constexpr u8 OpcodeAdd = 0x03;
+constexpr u8 OpcodeOr = 0x0B;
+constexpr u8 OpcodeSub = 0x2B;
+constexpr u8 OpcodeXor = 0x33;
+constexpr u8 OpcodeCmp = 0x3B;
+
+// Opcode extensions of the immediate forms
+constexpr u8 ExtensionAdd = 0;
+constexpr u8 ExtensionSub = 5;
+constexpr u8 ExtensionShl = 4;
+constexpr u8 ExtensionShr = 5;
+
+static HostOperand Direct(HostRegister reg)
+{
+    HostOperand operand;
+    operand.reg = reg;
+    return operand;
+}
+
+static HostOperand Memory(HostRegister base, HostRegister index, i32 displacement)
+{
+    HostOperand operand;
+    operand.isMemory = true;
+    operand.base = base;
+    operand.index = index;
+    operand.displacement = displacement;
+    return operand;
+}
+
+static HostOperand Memory(HostRegister base, i32 displacement)
+{
+    return Memory(base, HostRegister::None, displacement);
+}
+
+void Jit::Process(Module* module)
+{
+    JitInfo& jitInfo = module->jitInfo;
+    if (!jitInfo.isEnabled)
+        return;
+
+    BytecodeInfo& bytecodeInfo = module->bytecodeInfo;
+
+    // Frames that are still running keep their machine code until the Interpreter releases it
+    jitInfo.retiredCode.insert(jitInfo.retiredCode.end(), jitInfo.code.begin(), jitInfo.code.end());
+    jitInfo.code.clear();
+    jitInfo.enter = nullptr;
+
+    for (auto& itr : bytecodeInfo.functionHashToMemoryInfo)
+    {
+        itr.second.jitCode = nullptr;
+        itr.second.hotness = 0;
+    }
+
+    // Translation trusts what the verifier proved, every jump lands on an instruction and every register is in range
+    if (!bytecodeInfo.isVerified)
+    {
+        DebugHandler::PrintWarning("Jit : Module (%s) failed verification, it runs in the Interpreter", module->nameHash.name.c_str());
+        return;
+    }
+
+    JitContext context;
+    context.argumentRegisters = ArgumentRegisters;
+    _context = &context;
+
+    // Enter goes first, so it sits at the start of the executable memory
+    EmitEnter();
+
+    if (jitInfo.isTiered)
+    {
+        ExecutableMemory* code = CommitCode(module);
+        _context = nullptr;
+
+        if (!code)
+            return;
+
+        jitInfo.enter = reinterpret_cast<JitEnterFunc*>(code->GetData());
+
+        DebugHandler::PrintSuccess("Jit : Successfully Processsed Module (%s) (Tiered, Threshold: %u)", module->nameHash.name.c_str(), jitInfo.promotionThreshold);
+        return;
+    }
+
+    EmitExit();
+
+    std::vector<std::pair<u32, u32>> translatedFunctions;
+    u32 numInterpreted = 0;
+
+    for (auto& itr : bytecodeInfo.functionHashToMemoryInfo)
+    {
+        if (itr.second.isNative)
+            continue;
+
+        u32 codeOffset = static_cast<u32>(context.code.size());
+        if (TranslateFunction(module, itr.first, itr.second))
+        {
+            translatedFunctions.push_back({ itr.first, codeOffset });
+        }
+        else
+        {
+            context.code.resize(codeOffset);
+            numInterpreted++;
+        }
+    }
+
+    ExecutableMemory* code = CommitCode(module);
+    _context = nullptr;
+
+    if (!code)
+        return;
+
+    jitInfo.enter = reinterpret_cast<JitEnterFunc*>(code->GetData());
+
+    for (auto& [functionHash, codeOffset] : translatedFunctions)
+    {
+        bytecodeInfo.functionHashToMemoryInfo[functionHash].jitCode = code->GetData() + codeOffset;
+    }
+
+    DebugHandler::PrintSuccess("Jit : Successfully Processsed Module (%s) (Functions: %u, Interpreted: %u, Bytes: %u)", module->nameHash.name.c_str(), static_cast<u32>(translatedFunctions.size()), numInterpreted, static_cast<u32>(context.code.size()));
+}
+
+bool Jit::Promote(Module* module, u32 functionHash)
+{
+    JitInfo& jitInfo = module->jitInfo;
+    BytecodeInfo& bytecodeInfo = module->bytecodeInfo;
+
+    if (!jitInfo.enter || !bytecodeInfo.isVerified)
+        return false;
+
+    auto itr = bytecodeInfo.functionHashToMemoryInfo.find(functionHash);
+    if (itr == bytecodeInfo.functionHashToMemoryInfo.end() || itr->second.isNative || itr->second.jitCode)
+        return false;
+
+    JitContext context;
+    context.argumentRegisters = ArgumentRegisters;
+    _context = &context;
+
+    // Each promoted function gets its own block, the exits have to be in reach of its rel32 jumps
+    EmitExit();
+
+    u32 codeOffset = static_cast<u32>(context.code.size());
+    if (!TranslateFunction(module, functionHash, itr->second))
+    {
+        _context = nullptr;
+        return false;
+    }
+
+    ExecutableMemory* code = CommitCode(module);
+    _context = nullptr;
+
+    if (!code)
+        return false;
+
+    // Frames already running the function finish in the Interpreter, its next entry runs the machine code
+    itr->second.jitCode = code->GetData() + codeOffset;
+
+#if NAI_DEBUG
+    DebugHandler::Print("Jit : Promoted Function (%u) in Module (%s) (Hotness: %u, Bytes: %u)", functionHash, module->nameHash.name.c_str(), itr->second.hotness, static_cast<u32>(context.code.size()));
+#endif // NAI_DEBUG
+
+    return true;
+}
+
+bool Jit::TranslateObject(Module* module, JitObject& object)
+{
+    BytecodeInfo& bytecodeInfo = module->bytecodeInfo;
+    if (!bytecodeInfo.isVerified)
+    {
+        DebugHandler::PrintError("Jit : Module (%s) failed verification, it can't be saved as an object file", module->nameHash.name.c_str());
+        return false;
+    }
+
+    JitContext context;
+    context.argumentRegisters = SystemVArgumentRegisters;
+    context.object = &object;
+
+    // The host gets C strings, so every string is followed by its terminator
+    for (u32 i = 0; i < bytecodeInfo.stringTable.GetNumStrings(); i++)
+    {
+        const std::string& string = bytecodeInfo.stringTable.GetString(i);
+
+        context.stringOffsets.push_back(static_cast<u32>(object.stringData.size()));
+        object.stringData.insert(object.stringData.end(), string.begin(), string.end());
+        object.stringData.push_back(0);
+    }
+
+    _context = &context;
+
+    u32 enterOffset = static_cast<u32>(context.code.size());
+    EmitEnter();
+    EmitExit();
+
+    // Sorted so the same module always produces the same object
+    std::vector<u32> functionHashes;
+    for (auto& itr : bytecodeInfo.functionHashToMemoryInfo)
+    {
+        if (!itr.second.isNative)
+        {
+            functionHashes.push_back(itr.first);
+        }
+    }
+
+    std::sort(functionHashes.begin(), functionHashes.end());
+
+    // Entry and body offset of every function, calls go to the entry and tail calls to the body
+    robin_hood::unordered_map<u32, std::pair<u32, u32>> functionHashToOffsets;
+
+    for (u32 functionHash : functionHashes)
+    {
+        JitSymbol& symbol = object.functions.emplace_back();
+        symbol.name = ObjectFile::GetSymbolName(module, functionHash);
+        symbol.codeOffset = static_cast<u32>(context.code.size());
+
+        // The exported entry hands Enter the body, which follows right after the jmp
+        HostRegister argument = context.argumentRegisters[3];
+        EmitByte(0x48 | ((static_cast<u8>(argument) & 8) ? 0x04 : 0));
+        EmitByte(0x8D);
+        EmitByte(0x05 | ((static_cast<u8>(argument) & 7) << 3));
+        EmitU32(5);
+        EmitJumpTo(ConditionAlways, enterOffset);
+
+        u32 bodyOffset = static_cast<u32>(context.code.size());
+        if (!TranslateFunction(module, functionHash, bytecodeInfo.functionHashToMemoryInfo[functionHash]))
+        {
+            DebugHandler::PrintError("Jit : Function (%s) of Module (%s) can't be translated, it can't be saved as an object file", symbol.name.c_str(), module->nameHash.name.c_str());
+            _context = nullptr;
+            return false;
+        }
+
+        symbol.size = static_cast<u32>(context.code.size()) - symbol.codeOffset;
+        functionHashToOffsets[functionHash] = { symbol.codeOffset, bodyOffset };
+    }
+
+    _context = nullptr;
+
+    for (const JitCall& call : context.calls)
+    {
+        auto itr = functionHashToOffsets.find(call.functionHash);
+        if (itr == functionHashToOffsets.end())
+        {
+            // Natives are left for the linker, the host defines them
+            JitRelocation& relocation = object.relocations.emplace_back();
+            relocation.codeOffset = call.codeOffset;
+            relocation.symbol = ObjectFile::GetNativeSymbolName(module, call.functionHash);
+            relocation.addend = -4;
+            continue;
+        }
+
+        u32 target = call.isTail ? itr->second.second : itr->second.first;
+        i32 relative = static_cast<i32>(target) - static_cast<i32>(call.codeOffset + 4);
+        memcpy(&context.code[call.codeOffset], &relative, sizeof(i32));
+    }
+
+    object.code = std::move(context.code);
+    return true;
+}
+
+ExecutableMemory* Jit::CommitCode(Module* module)
+{
+    ExecutableMemory* code = new ExecutableMemory();
+    if (!code->Assign(_context->code.data(), _context->code.size()))
+    {
+        DebugHandler::PrintError("Jit : Failed to allocate executable memory for Module (%s), it runs in the Interpreter", module->nameHash.name.c_str());
+        delete code;
+        return nullptr;
+    }
+
+    module->jitInfo.code.push_back(code);
+    return code;
+}
+
+bool Jit::TranslateFunction(Module* module, u32 functionHash, const FunctionMemoryInfo& memoryInfo)
+{
+    JitContext& context = *_context;
+
+    u8* instructions = memoryInfo.instructions;
+    u32 size = memoryInfo.numInstructionBytes;
+
+    context.instructionOffsets.assign(static_cast<size_t>(size) + 1, 0);
+    context.patches.clear();
+
+    // Tail calls jump here too, the register file holds every VM register at this point
+    EmitReloadRegisters();
+
+    for (u32 offset = 0; offset < size;)
+    {
+        ByteOpcode* opcode = reinterpret_cast<ByteOpcode*>(instructions + offset);
+        context.instructionOffsets[offset] = static_cast<u32>(context.code.size());
+
+        if (!TranslateInstruction(module, opcode, offset, memoryInfo))
+        {
+#if NAI_DEBUG
+            DebugHandler::Print("Jit : Function (%u) runs in the Interpreter, can't translate (%s) at offset (%u)", functionHash, ByteOpcode::GetKindName(opcode->kind), offset);
+#else
+            (void)functionHash;
+#endif // NAI_DEBUG
+            return false;
+        }
+
+        offset += ByteOpcode::GetKindSize(opcode->kind);
+    }
+
+    // Running off the end returns just like Ret does
+    context.instructionOffsets[size] = static_cast<u32>(context.code.size());
+    EmitJumpTo(ConditionAlways, context.exitOffset);
+
+    for (const JitPatch& patch : context.patches)
+    {
+        i32 relative = static_cast<i32>(context.instructionOffsets[patch.target]) - static_cast<i32>(patch.codeOffset + 4);
+        memcpy(&context.code[patch.codeOffset], &relative, sizeof(i32));
+    }
+
+    return true;
+}
+
+bool Jit::TranslateInstruction(Module* module, ByteOpcode* opcode, u32 offset, const FunctionMemoryInfo& memoryInfo)
+{
+    switch (opcode->kind)
+    {
+        case ByteOpcode::Kind::PushRegister:
+        {
+            PushRegister* push = reinterpret_cast<PushRegister*>(opcode);
+
+            EmitArithmeticImmediate(ExtensionSub, Direct(StackPointer), 8);
+
+            HostRegister source = GetHostRegister(push->reg);
+            if (source == HostRegister::None)
+            {
+                EmitLoadRegister(HostRegister::Rax, push->reg);
+                source = HostRegister::Rax;
+            }
+
+            EmitMove(8, Memory(MemoryBase, StackPointer, 0), source);
+            return true;
+        }
+        case ByteOpcode::Kind::PushNumber:
+        {
+            PushNumber* push = reinterpret_cast<PushNumber*>(opcode);
+            if (!IsSupportedSize(push->size))
+                return false;
+
+            EmitArithmeticImmediate(ExtensionSub, Direct(StackPointer), push->size);
+            EmitMoveImmediate(HostRegister::Rax, push->number);
+            EmitMove(push->size, Memory(MemoryBase, StackPointer, 0), HostRegister::Rax);
+            return true;
+        }
+        case ByteOpcode::Kind::PopRegister:
+        {
+            PopRegister* pop = reinterpret_cast<PopRegister*>(opcode);
+
+            EmitMove(8, HostRegister::Rax, Memory(MemoryBase, StackPointer, 0));
+            EmitStoreRegister(pop->reg, HostRegister::Rax, 8);
+            EmitArithmeticImmediate(ExtensionAdd, Direct(StackPointer), 8);
+            return true;
+        }
+        case ByteOpcode::Kind::PopNoRegister:
+        {
+            PopNoRegister* pop = reinterpret_cast<PopNoRegister*>(opcode);
+
+            EmitArithmeticImmediate(ExtensionAdd, Direct(StackPointer), pop->size);
+            return true;
+        }
+
+        case ByteOpcode::Kind::JumpAbsolute:
+        case ByteOpcode::Kind::JumpRelative:
+        case ByteOpcode::Kind::JumpFunctionEnd:
+        {
+            // All three share the flags, only where they go differs
+            JumpAbsolute* jump = reinterpret_cast<JumpAbsolute*>(opcode);
+
+            u32 target = memoryInfo.cleanupAddress;
+            if (opcode->kind == ByteOpcode::Kind::JumpAbsolute)
+            {
+                target = static_cast<u32>(jump->address);
+            }
+            else if (opcode->kind == ByteOpcode::Kind::JumpRelative)
+            {
+                target = static_cast<u32>(static_cast<i64>(offset) + reinterpret_cast<JumpRelative*>(opcode)->address);
+            }
+
+            if (!jump->flags.isConditional)
+            {
+                EmitJump(ConditionAlways, target);
+                return true;
+            }
+
+            EmitInstruction(1, false, { 0x80 }, 7, Memory(HostRegister::Rsp, CompareFlagSlot));
+            EmitByte(static_cast<u8>(jump->flags.condition));
+            EmitJump(ConditionEqual, target);
+            return true;
+        }
+
+        case ByteOpcode::Kind::LoadRelative:
+        {
+            LoadRelative* load = reinterpret_cast<LoadRelative*>(opcode);
+            if (!IsSupportedSize(load->GetSize()))
+                return false;
+
+            EmitLoadMemory(HostRegister::Rax, Memory(MemoryBase, BasePointer, -load->source), load->GetSize());
+            EmitStoreRegister(load->GetDestination(), HostRegister::Rax, load->GetSize());
+            return true;
+        }
+        case ByteOpcode::Kind::LoadRegister:
+        {
+            LoadRegister* load = reinterpret_cast<LoadRegister*>(opcode);
+            if (!IsSupportedSize(load->GetSize()))
+                return false;
+
+            EmitLoadRegister(HostRegister::Rax, load->source);
+            EmitLoadMemory(HostRegister::Rax, Memory(MemoryBase, HostRegister::Rax, 0), load->GetSize());
+            EmitStoreRegister(load->GetDestination(), HostRegister::Rax, load->GetSize());
+            return true;
+        }
+        case ByteOpcode::Kind::LoadAddress:
+        {
+            LoadAddress* load = reinterpret_cast<LoadAddress*>(opcode);
+            if (!load->flags.loadRelative)
+                return false;
+
+            if (load->flags.isPointer)
+            {
+                EmitMove(8, HostRegister::Rax, Memory(MemoryBase, BasePointer, -load->source));
+            }
+            else
+            {
+                EmitMove(8, HostRegister::Rax, Direct(BasePointer));
+                EmitArithmeticImmediate(ExtensionSub, Direct(HostRegister::Rax), load->source);
+            }
+
+            EmitStoreRegister(load->GetDestination(), HostRegister::Rax, 8);
+            return true;
+        }
+
+        case ByteOpcode::Kind::MemoryNew:
+        {
+            if (_context->object)
+            {
+                EmitObjectCall(ObjectFile::MemoryNewSymbol);
+            }
+            else
+            {
+                EmitHelperCall(reinterpret_cast<const void*>(&Jit::AllocateHeap));
+            }
+
+            EmitReloadRegisters();
+            return true;
+        }
+        case ByteOpcode::Kind::MemoryFree:
+        {
+            if (_context->object)
+            {
+                EmitObjectCall(ObjectFile::MemoryFreeSymbol);
+            }
+            else
+            {
+                EmitHelperCall(reinterpret_cast<const void*>(&Jit::FreeHeap));
+            }
+
+            EmitReloadRegisters();
+            return true;
+        }
+        case ByteOpcode::Kind::MemCopy:
+        {
+            MemCopy* copy = reinterpret_cast<MemCopy*>(opcode);
+
+            if (!_context->object)
+            {
+                EmitHelperCall(reinterpret_cast<const void*>(&Jit::CopyMemory), reinterpret_cast<u64>(opcode));
+                EmitReloadRegisters();
+                return true;
+            }
+
+            // Arguments are read from the register file, the argument registers hold VM registers themselves
+            const HostRegister* arguments = _context->argumentRegisters;
+            EmitSpillRegisters();
+
+            EmitMove(8, arguments[0], GetRegisterFileOperand(copy->destination));
+            EmitArithmetic(OpcodeAdd, 8, arguments[0], Direct(MemoryBase));
+            EmitMove(8, arguments[1], GetRegisterFileOperand(copy->source));
+            EmitArithmetic(OpcodeAdd, 8, arguments[1], Direct(MemoryBase));
+
+            if (copy->sizeRegister != Register::None)
+            {
+                EmitMove(8, arguments[2], GetRegisterFileOperand(copy->sizeRegister));
+            }
+            else
+            {
+                EmitMoveImmediate(arguments[2], copy->size);
+            }
+
+            JitRelocation& relocation = _context->object->relocations.emplace_back();
+            relocation.codeOffset = EmitCallRelative();
+            relocation.symbol = "memmove";
+            relocation.addend = -4;
+
+            EmitReloadRegisters();
+            return true;
+        }
+        case ByteOpcode::Kind::MemSet:
+        {
+            MemSet* set = reinterpret_cast<MemSet*>(opcode);
+
+            if (!_context->object)
+            {
+                EmitHelperCall(reinterpret_cast<const void*>(&Jit::SetMemory), reinterpret_cast<u64>(opcode));
+                EmitReloadRegisters();
+                return true;
+            }
+
+            const HostRegister* arguments = _context->argumentRegisters;
+            EmitSpillRegisters();
+
+            EmitMove(8, arguments[0], GetRegisterFileOperand(set->destination));
+            EmitArithmetic(OpcodeAdd, 8, arguments[0], Direct(MemoryBase));
+
+            if (set->valueRegister != Register::None)
+            {
+                EmitZeroExtend(1, arguments[1], GetRegisterFileOperand(set->valueRegister));
+            }
+            else
+            {
+                EmitMoveImmediate(arguments[1], set->value);
+            }
+
+            if (set->sizeRegister != Register::None)
+            {
+                EmitMove(8, arguments[2], GetRegisterFileOperand(set->sizeRegister));
+            }
+            else
+            {
+                EmitMoveImmediate(arguments[2], set->size);
+            }
+
+            JitRelocation& relocation = _context->object->relocations.emplace_back();
+            relocation.codeOffset = EmitCallRelative();
+            relocation.symbol = "memset";
+            relocation.addend = -4;
+
+            EmitReloadRegisters();
+            return true;
+        }
+        case ByteOpcode::Kind::CreateStringOnHeap:
+        {
+            CreateStringOnHeap* createString = reinterpret_cast<CreateStringOnHeap*>(opcode);
+
+            if (!_context->object)
+            {
+                EmitHelperCall(reinterpret_cast<const void*>(&Jit::CreateString), reinterpret_cast<u64>(module), createString->strIndex);
+                EmitReloadRegisters();
+                return true;
+            }
+
+            // lea of the string in the string data as the fourth argument
+            EmitObjectArguments();
+
+            HostRegister argument = _context->argumentRegisters[3];
+            EmitByte(0x48 | ((static_cast<u8>(argument) & 8) ? 0x04 : 0));
+            EmitByte(0x8D);
+            EmitByte(0x05 | ((static_cast<u8>(argument) & 7) << 3));
+
+            JitRelocation& stringRelocation = _context->object->relocations.emplace_back();
+            stringRelocation.codeOffset = static_cast<u32>(_context->code.size());
+            stringRelocation.addend = static_cast<i64>(_context->stringOffsets[createString->strIndex]) - 4;
+            EmitU32(0);
+
+            JitRelocation& relocation = _context->object->relocations.emplace_back();
+            relocation.codeOffset = EmitCallRelative();
+            relocation.symbol = ObjectFile::CreateStringSymbol;
+            relocation.addend = -4;
+
+            EmitReloadRegisters();
+            return true;
+        }
+
+        case ByteOpcode::Kind::FunctionCall:
+        {
+            FunctionCall* call = reinterpret_cast<FunctionCall*>(opcode);
+
+            if (_context->object)
+            {
+                // Resolved by TranslateObject once every function has its offset
+                EmitObjectArguments();
+
+                JitCall& objectCall = _context->calls.emplace_back();
+                objectCall.codeOffset = EmitCallRelative();
+                objectCall.functionHash = call->callhash;
+            }
+            else
+            {
+                EmitHelperCall(reinterpret_cast<const void*>(&Jit::CallFunction), reinterpret_cast<u64>(module), call->callhash);
+            }
+
+            EmitReloadRegisters();
+            return true;
+        }
+        case ByteOpcode::Kind::TailCall:
+        {
+            ::TailCall* call = reinterpret_cast<::TailCall*>(opcode);
+
+            if (_context->object)
+            {
+                auto itr = module->bytecodeInfo.functionHashToMemoryInfo.find(call->callhash);
+                if (itr == module->bytecodeInfo.functionHashToMemoryInfo.end())
+                    return false;
+
+                JitCall& objectCall = _context->calls.emplace_back();
+                objectCall.functionHash = call->callhash;
+
+                // A native callee leaves its results in the register file, a Nai callee's body reloads from it
+                if (itr->second.isNative)
+                {
+                    EmitObjectArguments();
+                    objectCall.codeOffset = EmitCallRelative();
+                    EmitJumpTo(ConditionAlways, _context->exitNoStoreOffset);
+                }
+                else
+                {
+                    EmitSpillRegisters();
+                    EmitByte(0xE9);
+                    objectCall.codeOffset = static_cast<u32>(_context->code.size());
+                    objectCall.isTail = true;
+                    EmitU32(0);
+                }
+
+                return true;
+            }
+
+            // A translated callee is jumped to and reuses our host frame, anything else already ran inside the helper
+            EmitHelperCall(reinterpret_cast<const void*>(&Jit::TailCall), reinterpret_cast<u64>(module), call->callhash);
+            EmitInstruction(8, false, { 0x85 }, static_cast<u8>(HostRegister::Rax), Direct(HostRegister::Rax));
+            EmitJumpTo(ConditionEqual, _context->exitNoStoreOffset);
+            EmitInstruction(4, false, { 0xFF }, 4, Direct(HostRegister::Rax));
+            return true;
+        }
+        case ByteOpcode::Kind::Ret:
+        {
+            EmitJumpTo(ConditionAlways, _context->exitOffset);
+            return true;
+        }
+
+        case ByteOpcode::Kind::MoveNToR:
+        {
+            MoveNToR* move = reinterpret_cast<MoveNToR*>(opcode);
+            if (!IsSupportedSize(move->size))
+                return false;
+
+            EmitMoveImmediate(HostRegister::Rax, move->source);
+            EmitStoreRegister(move->destination, HostRegister::Rax, move->size);
+            return true;
+        }
+        case ByteOpcode::Kind::MoveNToA:
+        {
+            MoveNToA* move = reinterpret_cast<MoveNToA*>(opcode);
+            if (!IsSupportedSize(move->size))
+                return false;
+
+            // The Interpreter reads addresses of the A forms of Move as an i32
+            EmitSignExtend32(HostRegister::Rdx, GetOperand(move->destination));
+            EmitMoveImmediate(HostRegister::Rax, move->source);
+            EmitMove(move->size, Memory(MemoryBase, HostRegister::Rdx, 0), HostRegister::Rax);
+            return true;
+        }
+        case ByteOpcode::Kind::MoveRToR:
+        {
+            MoveRToR* move = reinterpret_cast<MoveRToR*>(opcode);
+            if (!IsSupportedSize(move->size))
+                return false;
+
+            HostRegister source = GetHostRegister(move->source);
+            HostRegister destination = GetHostRegister(move->destination);
+            if (move->size == 8 && source != HostRegister::None && destination != HostRegister::None)
+            {
+                EmitMove(8, destination, Direct(source));
+                return true;
+            }
+
+            EmitLoadRegister(HostRegister::Rax, move->source);
+            EmitStoreRegister(move->destination, HostRegister::Rax, move->size);
+            return true;
+        }
+        case ByteOpcode::Kind::MoveRToA:
+        {
+            MoveRToA* move = reinterpret_cast<MoveRToA*>(opcode);
+            if (!IsSupportedSize(move->size))
+                return false;
+
+            EmitSignExtend32(HostRegister::Rdx, GetOperand(move->destination));
+            EmitLoadRegister(HostRegister::Rax, move->source);
+            EmitMove(move->size, Memory(MemoryBase, HostRegister::Rdx, 0), HostRegister::Rax);
+            return true;
+        }
+        case ByteOpcode::Kind::MoveAToR:
+        {
+            MoveAToR* move = reinterpret_cast<MoveAToR*>(opcode);
+            if (!IsSupportedSize(move->size))
+                return false;
+
+            EmitSignExtend32(HostRegister::Rax, GetOperand(move->source));
+            EmitLoadMemory(HostRegister::Rax, Memory(MemoryBase, HostRegister::Rax, 0), move->size);
+            EmitStoreRegister(move->destination, HostRegister::Rax, move->size);
+            return true;
+        }
+        case ByteOpcode::Kind::MoveAToA:
+        {
+            MoveAToA* move = reinterpret_cast<MoveAToA*>(opcode);
+            if (!IsSupportedSize(move->size))
+                return false;
+
+            EmitSignExtend32(HostRegister::Rax, GetOperand(move->source));
+            EmitSignExtend32(HostRegister::Rdx, GetOperand(move->destination));
+            EmitLoadMemory(HostRegister::Rax, Memory(MemoryBase, HostRegister::Rax, 0), move->size);
+            EmitMove(move->size, Memory(MemoryBase, HostRegister::Rdx, 0), HostRegister::Rax);
+            return true;
+        }
+
+        case ByteOpcode::Kind::AddNToR:
+        case ByteOpcode::Kind::SubNToR:
+        {
+            bool isAdd = opcode->kind == ByteOpcode::Kind::AddNToR;
+
+            u64 source = isAdd ? reinterpret_cast<AddNToR*>(opcode)->source : reinterpret_cast<SubNToR*>(opcode)->source;
+            Register destination = isAdd ? reinterpret_cast<AddNToR*>(opcode)->destination : reinterpret_cast<SubNToR*>(opcode)->destination;
+            u8 size = isAdd ? reinterpret_cast<AddNToR*>(opcode)->size : reinterpret_cast<SubNToR*>(opcode)->size;
+
+            if (!IsSupportedSize(size))
+                return false;
+
+            // Moving Rsp and stepping loop counters, worth a single instruction
+            HostRegister reg = GetHostRegister(destination);
+            if (size == 8 && reg != HostRegister::None && source <= 0x7FFFFFFF)
+            {
+                EmitArithmeticImmediate(isAdd ? ExtensionAdd : ExtensionSub, Direct(reg), static_cast<i32>(source));
+                return true;
+            }
+
+            EmitLoadRegister(HostRegister::Rax, destination);
+            EmitMoveImmediate(HostRegister::Rdx, source);
+            EmitArithmetic(isAdd ? OpcodeAdd : OpcodeSub, 8, HostRegister::Rax, Direct(HostRegister::Rdx));
+            EmitStoreRegister(destination, HostRegister::Rax, size);
+            return true;
+        }
+        case ByteOpcode::Kind::AddNToA:
+        {
+            AddNToA* add = reinterpret_cast<AddNToA*>(opcode);
+            if (!IsSupportedSize(add->size) || add->source > 0x7FFFFFFF)
+                return false;
+
+            EmitLoadRegister(HostRegister::Rdx, add->destination);
+            EmitMove(8, HostRegister::Rax, Memory(MemoryBase, HostRegister::Rdx, 0));
+            EmitArithmeticImmediate(ExtensionAdd, Direct(HostRegister::Rax), static_cast<i32>(add->source));
+            EmitMove(add->size, Memory(MemoryBase, HostRegister::Rdx, 0), HostRegister::Rax);
+            return true;
+        }
+        case ByteOpcode::Kind::AddRToR:
+        case ByteOpcode::Kind::SubRToR:
+        case ByteOpcode::Kind::MulRToR:
+        {
+            // Same layout for all three, Register source followed by Register destination
+            AddRToR* add = reinterpret_cast<AddRToR*>(opcode);
+            if (!IsSupportedSize(add->size))
+                return false;
+
+            EmitLoadRegister(HostRegister::Rax, add->destination);
+
+            if (opcode->kind == ByteOpcode::Kind::MulRToR)
+            {
+                EmitMultiply(HostRegister::Rax, GetOperand(add->source));
+            }
+            else
+            {
+                EmitArithmetic(opcode->kind == ByteOpcode::Kind::AddRToR ? OpcodeAdd : OpcodeSub, 8, HostRegister::Rax, GetOperand(add->source));
+            }
+
+            EmitStoreRegister(add->destination, HostRegister::Rax, add->size);
+            return true;
+        }
+        case ByteOpcode::Kind::AddRToA:
+        {
+            AddRToA* add = reinterpret_cast<AddRToA*>(opcode);
+            if (!IsSupportedSize(add->size))
+                return false;
+
+            EmitLoadRegister(HostRegister::Rdx, add->destination);
+            EmitMove(8, HostRegister::Rax, Memory(MemoryBase, HostRegister::Rdx, 0));
+            EmitArithmetic(OpcodeAdd, 8, HostRegister::Rax, GetOperand(add->source));
+            EmitMove(add->size, Memory(MemoryBase, HostRegister::Rdx, 0), HostRegister::Rax);
+            return true;
+        }
+        case ByteOpcode::Kind::AddAToR:
+        {
+            AddAToR* add = reinterpret_cast<AddAToR*>(opcode);
+            if (!IsSupportedSize(add->size))
+                return false;
+
+            EmitLoadRegister(HostRegister::Rdx, add->source);
+            EmitMove(8, HostRegister::Rdx, Memory(MemoryBase, HostRegister::Rdx, 0));
+            EmitLoadRegister(HostRegister::Rax, add->destination);
+            EmitArithmetic(OpcodeAdd, 8, HostRegister::Rax, Direct(HostRegister::Rdx));
+            EmitStoreRegister(add->destination, HostRegister::Rax, add->size);
+            return true;
+        }
+        case ByteOpcode::Kind::AddAToA:
+        {
+            AddAToA* add = reinterpret_cast<AddAToA*>(opcode);
+            if (!IsSupportedSize(add->size))
+                return false;
+
+            EmitLoadRegister(HostRegister::Rdx, add->source);
+            EmitMove(8, HostRegister::Rax, Memory(MemoryBase, HostRegister::Rdx, 0));
+            EmitLoadRegister(HostRegister::Rdx, add->destination);
+            EmitArithmetic(OpcodeAdd, 8, HostRegister::Rax, Memory(MemoryBase, HostRegister::Rdx, 0));
+            EmitMove(add->size, Memory(MemoryBase, HostRegister::Rdx, 0), HostRegister::Rax);
+            return true;
+        }
+
+        case ByteOpcode::Kind::DivRToR:
+        {
+            DivRToR* div = reinterpret_cast<DivRToR*>(opcode);
+            if (!IsSupportedSize(div->size))
+                return false;
+
+            // The Interpreter divides the whole registers and keeps size bytes of the quotient
+            EmitLoadRegister(HostRegister::Rax, div->destination);
+            EmitArithmetic(OpcodeXor, 4, HostRegister::Rdx, Direct(HostRegister::Rdx));
+            EmitDivide(8, GetOperand(div->source));
+            EmitStoreRegister(div->destination, HostRegister::Rax, div->size);
+            return true;
+        }
+        case ByteOpcode::Kind::ModuloRToR:
+        {
+            ModuloRToR* modulo = reinterpret_cast<ModuloRToR*>(opcode);
+            if (!IsSupportedSize(modulo->size))
+                return false;
+
+            HostOperand source = GetOperand(modulo->source);
+            EmitZeroExtend(modulo->size, HostRegister::Rax, GetOperand(modulo->destination));
+
+            // Byte division leaves the remainder in Ah, everything wider leaves it in Rdx
+            if (modulo->size == 1)
+            {
+                EmitDivide(1, source);
+                EmitShift(ExtensionShr, HostRegister::Rax, 8);
+                EmitStoreRegister(modulo->destination, HostRegister::Rax, 1);
+                return true;
+            }
+
+            EmitArithmetic(OpcodeXor, 4, HostRegister::Rdx, Direct(HostRegister::Rdx));
+            EmitDivide(modulo->size, source);
+            EmitStoreRegister(modulo->destination, HostRegister::Rdx, modulo->size);
+            return true;
+        }
+
+        case ByteOpcode::Kind::CmpE_RToR:
+        case ByteOpcode::Kind::CmpNE_RToR:
+        case ByteOpcode::Kind::CmpL_RToR:
+        case ByteOpcode::Kind::CmpLE_RToR:
+        case ByteOpcode::Kind::CmpG_RToR:
+        case ByteOpcode::Kind::CmpGE_RToR:
+        case ByteOpcode::Kind::CmpLE_NToR:
+        {
+            u8 condition = ConditionEqual;
+            u8 size = 0;
+            Register destination = Register::None;
+
+            switch (opcode->kind)
+            {
+                case ByteOpcode::Kind::CmpLE_NToR:
+                {
+                    CmpLE_NToR* cmp = reinterpret_cast<CmpLE_NToR*>(opcode);
+                    if (!IsSupportedSize(cmp->size))
+                        return false;
+
+                    // The Interpreter compares against the immediate truncated to size
+                    u64 mask = cmp->size == 8 ? ~0ull : (1ull << (cmp->size * 8)) - 1;
+                    EmitLoadRegister(HostRegister::Rax, cmp->destination);
+                    EmitMoveImmediate(HostRegister::Rdx, cmp->source & mask);
+                    EmitArithmetic(OpcodeCmp, cmp->size, HostRegister::Rax, Direct(HostRegister::Rdx));
+
+                    condition = ConditionBelowOrEqual;
+                    size = cmp->size;
+                    destination = cmp->destination;
+                    break;
+                }
+
+                default:
+                {
+                    // Every register to register comparison has the same layout
+                    CmpE_RToR* cmp = reinterpret_cast<CmpE_RToR*>(opcode);
+                    if (!IsSupportedSize(cmp->size))
+                        return false;
+
+                    EmitLoadRegister(HostRegister::Rax, cmp->destination);
+                    EmitArithmetic(OpcodeCmp, cmp->size, HostRegister::Rax, GetOperand(cmp->source));
+
+                    switch (opcode->kind)
+                    {
+                        case ByteOpcode::Kind::CmpNE_RToR: condition = ConditionNotEqual; break;
+                        case ByteOpcode::Kind::CmpL_RToR: condition = ConditionBelow; break;
+                        case ByteOpcode::Kind::CmpLE_RToR: condition = ConditionBelowOrEqual; break;
+                        case ByteOpcode::Kind::CmpG_RToR: condition = ConditionAbove; break;
+                        case ByteOpcode::Kind::CmpGE_RToR: condition = ConditionAboveOrEqual; break;
+                        default: condition = ConditionEqual; break;
+                    }
+
+                    size = cmp->size;
+                    destination = cmp->destination;
+                    break;
+                }
+            }
+
+            // The flag is kept for the jumps and the result is written to the destination, just like the Interpreter does
+            EmitSetCondition(condition, HostRegister::Rdx);
+            EmitMove(1, Memory(HostRegister::Rsp, CompareFlagSlot), HostRegister::Rdx);
+            EmitZeroExtend(1, HostRegister::Rdx, Direct(HostRegister::Rdx));
+            EmitStoreRegister(destination, HostRegister::Rdx, size);
+            return true;
+        }
+
+        default:
+        {
+            return false;
+        }
+    }
+}
+
+void Jit::EmitEnter()
+{
+    for (HostRegister reg : SavedRegisters)
+    {
+        EmitPush(reg);
+    }
+
+    EmitArithmeticImmediate(ExtensionSub, Direct(HostRegister::Rsp), FrameSize);
+
+    const HostRegister* arguments = _context->argumentRegisters;
+    EmitMove(8, Memory(HostRegister::Rsp, InterpreterSlot), arguments[0]);
+    EmitMove(8, RegisterFile, Direct(arguments[1]));
+    EmitMove(8, MemoryBase, Direct(arguments[2]));
+
+    EmitInstruction(1, false, { 0xC6 }, 0, Memory(HostRegister::Rsp, CompareFlagSlot));
+    EmitByte(0);
+
+    EmitInstruction(4, false, { 0xFF }, 4, Direct(arguments[3]));
+}
+
+void Jit::EmitExit()
+{
+    _context->exitOffset = static_cast<u32>(_context->code.size());
+    EmitSpillRegisters();
+
+    _context->exitNoStoreOffset = static_cast<u32>(_context->code.size());
+    EmitArithmeticImmediate(ExtensionAdd, Direct(HostRegister::Rsp), FrameSize);
+
+    for (size_t i = sizeof(SavedRegisters) / sizeof(HostRegister); i > 0; i--)
+    {
+        EmitPop(SavedRegisters[i - 1]);
+    }
+
+    EmitByte(0xC3);
+}
+
+void Jit::EmitSpillRegisters()
+{
+    for (u32 i = 1; i <= static_cast<u32>(Register::Count); i++)
+    {
+        if (RegisterMap[i] != HostRegister::None)
+        {
+            EmitMove(8, Memory(RegisterFile, (i - 1) * 8), RegisterMap[i]);
+        }
+    }
+}
+
+void Jit::EmitReloadRegisters()
+{
+    for (u32 i = 1; i <= static_cast<u32>(Register::Count); i++)
+    {
+        if (RegisterMap[i] != HostRegister::None)
+        {
+            EmitMove(8, RegisterMap[i], Memory(RegisterFile, (i - 1) * 8));
+        }
+    }
+}
+
+void Jit::EmitHelperCall(const void* helper, u64 argument1, u64 argument2)
+{
+    // Helpers see the VM registers through the Interpreter, and may clobber any caller saved host register
+    EmitSpillRegisters();
+
+    const HostRegister* arguments = _context->argumentRegisters;
+    EmitMove(8, arguments[0], Memory(HostRegister::Rsp, InterpreterSlot));
+    EmitMoveImmediate(arguments[1], argument1);
+    EmitMoveImmediate(arguments[2], argument2);
+
+    EmitMoveImmediate(HostRegister::Rax, reinterpret_cast<u64>(helper));
+    EmitInstruction(4, false, { 0xFF }, 2, Direct(HostRegister::Rax));
+}
+
+void Jit::EmitObjectArguments()
+{
+    EmitSpillRegisters();
+
+    const HostRegister* arguments = _context->argumentRegisters;
+    EmitMove(8, arguments[0], Memory(HostRegister::Rsp, InterpreterSlot));
+    EmitMove(8, arguments[1], Direct(RegisterFile));
+    EmitMove(8, arguments[2], Direct(MemoryBase));
+}
+
+void Jit::EmitObjectCall(const char* symbol)
+{
+    EmitObjectArguments();
+
+    JitRelocation& relocation = _context->object->relocations.emplace_back();
+    relocation.codeOffset = EmitCallRelative();
+    relocation.symbol = symbol;
+    relocation.addend = -4;
+}
+
+u32 Jit::EmitCallRelative()
+{
+    EmitByte(0xE8);
+
+    u32 codeOffset = static_cast<u32>(_context->code.size());
+    EmitU32(0);
+
+    return codeOffset;
+}
+
+void Jit::EmitLoadRegister(HostRegister destination, Register source)
+{
+    HostOperand operand = GetOperand(source);
+    if (!operand.isMemory && operand.reg == destination)
+        return;
+
+    EmitMove(8, destination, operand);
+}
+
+void Jit::EmitStoreRegister(Register destination, HostRegister source, u8 size)
+{
+    HostOperand operand = GetOperand(destination);
+    if (operand.isMemory || size == 1 || size == 2)
+    {
+        EmitMove(size, operand, source);
+        return;
+    }
+
+    if (size == 8)
+    {
+        if (operand.reg != source)
+        {
+            EmitMove(8, operand.reg, Direct(source));
+        }
+        return;
+    }
+
+    // A 32 bit move would clear the upper half, which the Interpreter keeps
+    EmitMove(4, source, Direct(source));
+    EmitShift(ExtensionShr, operand.reg, 32);
+    EmitShift(ExtensionShl, operand.reg, 32);
+    EmitArithmetic(OpcodeOr, 8, operand.reg, Direct(source));
+}
+
+void Jit::EmitLoadMemory(HostRegister destination, const HostOperand& source, u8 size)
+{
+    EmitZeroExtend(size, destination, source);
+}
+
+void Jit::EmitJump(u8 condition, u32 target)
+{
+    if (condition == ConditionAlways)
+    {
+        EmitByte(0xE9);
+    }
+    else
+    {
+        EmitByte(0x0F);
+        EmitByte(0x80 | condition);
+    }
+
+    JitPatch& patch = _context->patches.emplace_back();
+    patch.codeOffset = static_cast<u32>(_context->code.size());
+    patch.target = target;
+
+    EmitU32(0);
+}
+
+void Jit::EmitJumpTo(u8 condition, u32 codeOffset)
+{
+    if (condition == ConditionAlways)
+    {
+        EmitByte(0xE9);
+    }
+    else
+    {
+        EmitByte(0x0F);
+        EmitByte(0x80 | condition);
+    }
+
+    i32 relative = static_cast<i32>(codeOffset) - static_cast<i32>(_context->code.size() + 4);
+    EmitU32(static_cast<u32>(relative));
+}
+
+HostOperand Jit::GetOperand(Register reg)
+{
+    HostRegister hostRegister = GetHostRegister(reg);
+    if (hostRegister != HostRegister::None)
+        return Direct(hostRegister);
+
+    return GetRegisterFileOperand(reg);
+}
+
+HostOperand Jit::GetRegisterFileOperand(Register reg)
+{
+    return Memory(RegisterFile, (static_cast<i32>(reg) - 1) * 8);
+}
+
+HostRegister Jit::GetHostRegister(Register reg)
+{
+    return RegisterMap[static_cast<u32>(reg)];
+}
+
+bool Jit::IsSupportedSize(u8 size)
+{
+    // The generator only ever emits these, anything else stays in the Interpreter
+    return size == 1 || size == 2 || size == 4 || size == 8;
+}
+
+void Jit::EmitByte(u8 value)
+{
+    _context->code.push_back(value);
+}
+
+void Jit::EmitU32(u32 value)
+{
+    size_t offset = _context->code.size();
+    _context->code.resize(offset + sizeof(u32));
+    memcpy(&_context->code[offset], &value, sizeof(u32));
+}
+
+void Jit::EmitU64(u64 value)
+{
+    size_t offset = _context->code.size();
+    _context->code.resize(offset + sizeof(u64));
+    memcpy(&_context->code[offset], &value, sizeof(u64));
+}
+
+void Jit::EmitInstruction(u8 size, bool forceRex, std::initializer_list<u8> opcode, u8 reg, const HostOperand& rm)
+{
+    if (size == 2)
+    {
+        EmitByte(0x66);
+    }
+
+    u8 rmRegister = static_cast<u8>(rm.isMemory ? rm.base : rm.reg);
+    u8 indexRegister = rm.isMemory && rm.index != HostRegister::None ? static_cast<u8>(rm.index) : 0;
+
+    u8 rex = 0x40;
+    rex |= size == 8 ? 0x08 : 0;
+    rex |= (reg & 8) ? 0x04 : 0;
+    rex |= (indexRegister & 8) ? 0x02 : 0;
+    rex |= (rmRegister & 8) ? 0x01 : 0;
+
+    // Without a Rex prefix byte registers 4 to 7 are Ah to Bh instead of Spl to Dil
+    if (rex != 0x40 || forceRex || size == 1)
+    {
+        EmitByte(rex);
+    }
+
+    for (u8 byte : opcode)
+    {
+        EmitByte(byte);
+    }
+
+    if (!rm.isMemory)
+    {
+        EmitByte(0xC0 | ((reg & 7) << 3) | (rmRegister & 7));
+        return;
+    }
+
+    // Always a 32 bit displacement, which keeps Rbp and R13 as a base free of their special case
+    if (rm.index != HostRegister::None)
+    {
+        assert(rm.index != HostRegister::Rsp);
+
+        EmitByte(0x84 | ((reg & 7) << 3));
+        EmitByte(((indexRegister & 7) << 3) | (rmRegister & 7));
+    }
+    else if ((rmRegister & 7) == 4)
+    {
+        EmitByte(0x84 | ((reg & 7) << 3));
+        EmitByte(0x24);
+    }
+    else
+    {
+        EmitByte(0x80 | ((reg & 7) << 3) | (rmRegister & 7));
+    }
+
+    EmitU32(static_cast<u32>(rm.displacement));
+}
+
+void Jit::EmitMove(u8 size, HostRegister destination, const HostOperand& source)
+{
+    EmitInstruction(size, false, { static_cast<u8>(size == 1 ? 0x8A : 0x8B) }, static_cast<u8>(destination), source);
+}
+
+void Jit::EmitMove(u8 size, const HostOperand& destination, HostRegister source)
+{
+    EmitInstruction(size, false, { static_cast<u8>(size == 1 ? 0x88 : 0x89) }, static_cast<u8>(source), destination);
+}
+
+void Jit::EmitMoveImmediate(HostRegister destination, u64 value)
+{
+    u8 reg = static_cast<u8>(destination);
+
+    // A 32 bit move clears the upper half for us
+    if (value <= 0xFFFFFFFF)
+    {
+        if (reg & 8)
+        {
+            EmitByte(0x41);
+        }
+
+        EmitByte(0xB8 | (reg & 7));
+        EmitU32(static_cast<u32>(value));
+        return;
+    }
+
+    EmitByte(0x48 | ((reg & 8) ? 0x01 : 0));
+    EmitByte(0xB8 | (reg & 7));
+    EmitU64(value);
+}
+
+void Jit::EmitZeroExtend(u8 size, HostRegister destination, const HostOperand& source)
+{
+    switch (size)
+    {
+        case 1:
+        {
+            EmitInstruction(4, true, { 0x0F, 0xB6 }, static_cast<u8>(destination), source);
+            break;
+        }
+        case 2:
+        {
+            EmitInstruction(4, false, { 0x0F, 0xB7 }, static_cast<u8>(destination), source);
+            break;
+        }
+
+        default:
+        {
+            // 32 bit moves zero extend on their own
+            EmitMove(size, destination, source);
+            break;
+        }
+    }
+}
+
+void Jit::EmitSignExtend32(HostRegister destination, const HostOperand& source)
+{
+    EmitInstruction(8, false, { 0x63 }, static_cast<u8>(destination), source);
+}
+
+void Jit::EmitArithmetic(u8 opcode, u8 size, HostRegister destination, const HostOperand& source)
+{
+    EmitInstruction(size, false, { static_cast<u8>(size == 1 ? opcode - 1 : opcode) }, static_cast<u8>(destination), source);
+}
+
+void Jit::EmitArithmeticImmediate(u8 extension, const HostOperand& destination, i32 value)
+{
+    EmitInstruction(8, false, { 0x81 }, extension, destination);
+    EmitU32(static_cast<u32>(value));
+}
+
+void Jit::EmitShift(u8 extension, HostRegister reg, u8 count)
+{
+    EmitInstruction(8, false, { 0xC1 }, extension, Direct(reg));
+    EmitByte(count);
+}
+
+void Jit::EmitMultiply(HostRegister destination, const HostOperand& source)
+{
+    EmitInstruction(8, false, { 0x0F, 0xAF }, static_cast<u8>(destination), source);
+}
+
+void Jit::EmitDivide(u8 size, const HostOperand& source)
+{
+    EmitInstruction(size, false, { static_cast<u8>(size == 1 ? 0xF6 : 0xF7) }, 6, source);
+}
+
+void Jit::EmitSetCondition(u8 condition, HostRegister reg)
+{
+    EmitInstruction(1, false, { 0x0F, static_cast<u8>(0x90 | condition) }, 0, Direct(reg));
+}
+
+void Jit::EmitPush(HostRegister reg)
+{
+    u8 index = static_cast<u8>(reg);
+    if (index & 8)
+    {
+        EmitByte(0x41);
+    }
+
+    EmitByte(0x50 | (index & 7));
+}
+
+void Jit::EmitPop(HostRegister reg)
+{
+    u8 index = static_cast<u8>(reg);
+    if (index & 8)
+    {
+        EmitByte(0x41);
+    }
+
+    EmitByte(0x58 | (index & 7));
+}
+
+void Jit::CallFunction(Interpreter* interpreter, Module* module, u32 functionHash)
+{
+    interpreter->CallFunction(module, functionHash);
+}
+
+const u8* Jit::TailCall(Interpreter* interpreter, Module* module, u32 functionHash)
+{
+    if (interpreter->_hasPendingReload)
+    {
+        interpreter->ApplyReloads();
+    }
+
+    interpreter->CountHotness(module, functionHash, 1);
+
+    auto itr = module->bytecodeInfo.functionHashToMemoryInfo.find(functionHash);
+    if (itr == module->bytecodeInfo.functionHashToMemoryInfo.end())
+    {
+        DebugHandler::PrintError("Interpreter : Called a Function that no longer exists in Module (%s)", module->nameHash.name.c_str());
+        exit(1);
+    }
+
+    // Our frame is already gone, the callee takes over the running Interpret call and returns to our caller
+    interpreter->_callStack.top() = functionHash;
+
+    FunctionMemoryInfo memoryInfo = itr->second;
+    if (memoryInfo.isNative)
+    {
+        interpreter->CallNative(module, functionHash);
+        return nullptr;
+    }
+
+    if (memoryInfo.jitCode)
+    {
+        interpreter->CheckStackBounds(memoryInfo);
+        return memoryInfo.jitCode;
+    }
+
+    // The callee couldn't be translated, it runs to completion here and we return straight to our caller after
+    interpreter->RunFunction(module, memoryInfo);
+    return nullptr;
+}
+
+void Jit::AllocateHeap(Interpreter* interpreter)
+{
+    u64* rax = interpreter->GetRegister(Register::Rax);
+
+    size_t address = 0;
+    interpreter->AllocateHeap(*rax, address);
+    *rax = address;
+}
+
+void Jit::FreeHeap(Interpreter* interpreter)
+{
+    interpreter->FreeHeap(*interpreter->GetRegister(Register::Rax));
+}
+
+void Jit::CopyMemory(Interpreter* interpreter, const MemCopy* opcode)
+{
+    u8* memory = interpreter->GetMemory();
+
+    u64 sourceAddress = *interpreter->GetRegister(opcode->source);
+    u64 destinationAddress = *interpreter->GetRegister(opcode->destination);
+    u64 size = opcode->sizeRegister != Register::None ? *interpreter->GetRegister(opcode->sizeRegister) : opcode->size;
+
+    memmove(&memory[destinationAddress], &memory[sourceAddress], size);
+}
+
+void Jit::SetMemory(Interpreter* interpreter, const MemSet* opcode)
+{
+    u8* memory = interpreter->GetMemory();
+
+    u64 destinationAddress = *interpreter->GetRegister(opcode->destination);
+    u8 value = opcode->valueRegister != Register::None ? static_cast<u8>(*interpreter->GetRegister(opcode->valueRegister)) : opcode->value;
+    u64 size = opcode->sizeRegister != Register::None ? *interpreter->GetRegister(opcode->sizeRegister) : opcode->size;
+
+    memset(&memory[destinationAddress], value, size);
+}
+
+void Jit::CreateString(Interpreter* interpreter, Module* module, u32 strIndex)
+{
+    *interpreter->GetRegister(Register::Rax) = interpreter->GetStringAddress(module, static_cast<u16>(strIndex));
+}
@@ -1,2 +1,157 @@
 #pragma once
 #include "pch/Build.h"
+#include "Compiler/Backend/Bytecode/ByteOpcode.h"
+#include <initializer_list>
+#include <string>
+#include <vector>
+
+struct Module;
+struct FunctionMemoryInfo;
+struct JitContext;
+class Interpreter;
+class ExecutableMemory;
+
+// In the order x86-64 encodes them
+enum class HostRegister : u8
+{
+    Rax,
+    Rcx,
+    Rdx,
+    Rbx,
+    Rsp,
+    Rbp,
+    Rsi,
+    Rdi,
+
+    R8,
+    R9,
+    R10,
+    R11,
+    R12,
+    R13,
+    R14,
+    R15,
+
+    None = 0xFF
+};
+
+// A register, or the memory at base + index + displacement
+struct HostOperand
+{
+public:
+    bool isMemory = false;
+    HostRegister reg = HostRegister::None;
+    HostRegister base = HostRegister::None;
+    HostRegister index = HostRegister::None;
+    i32 displacement = 0;
+};
+
+// A rel32 in the code of a JitObject that the linker fills in
+struct JitRelocation
+{
+public:
+    u32 codeOffset = 0;
+
+    // External symbol the rel32 refers to, empty when it refers to the string data instead
+    std::string symbol;
+    i64 addend = 0;
+};
+
+struct JitSymbol
+{
+public:
+    std::string name;
+    u32 codeOffset = 0;
+    u32 size = 0;
+};
+
+// Position independent machine code of a whole module, see ObjectFile for the calling convention
+struct JitObject
+{
+public:
+    std::vector<u8> code;
+    std::vector<u8> stringData;
+    std::vector<JitSymbol> functions;
+    std::vector<JitRelocation> relocations;
+};
+
+// Translates verified bytecode into x86-64 machine code, one block of executable memory per module
+// VM registers live in host registers where there is room for them and in the Interpreter's register file otherwise
+// VM memory is addressed through a base register, the machine code reads and writes the Interpreter's memory directly
+// Calls, heap allocations and strings go through the Interpreter so both run the same call stack
+class Jit
+{
+public:
+    // Translates every function of a verified module, the ones that can't be translated keep running in the Interpreter
+    // Tiered modules only get the Enter stub here, their functions are translated by Promote
+    static void Process(Module* module);
+
+    // Translates a single function of a tiered module, the Interpreter calls this once the function got hot
+    static bool Promote(Module* module, u32 functionHash);
+
+    // Translates every function for an ObjectFile, fails when any of them can't be translated since there is no Interpreter to fall back on
+    static bool TranslateObject(Module* module, JitObject& object);
+
+private:
+    static bool TranslateFunction(Module* module, u32 functionHash, const FunctionMemoryInfo& memoryInfo);
+    static bool TranslateInstruction(Module* module, ByteOpcode* opcode, u32 offset, const FunctionMemoryInfo& memoryInfo);
+    static ExecutableMemory* CommitCode(Module* module);
+
+    // Enter sets up the host frame every translated function shares and jumps to the code, Exit tears it down again
+    static void EmitEnter();
+    static void EmitExit();
+
+    // Host registers holding a VM register are copied to the register file around anything that reads it from there
+    static void EmitSpillRegisters();
+    static void EmitReloadRegisters();
+    static void EmitHelperCall(const void* helper, u64 argument1 = 0, u64 argument2 = 0);
+
+    // Object code calls through a rel32 instead, with the arguments Enter takes
+    static void EmitObjectArguments();
+    static void EmitObjectCall(const char* symbol);
+    static u32 EmitCallRelative();
+
+    // Loads or stores a VM register, stores only write the low size bytes just like the Interpreter does
+    static void EmitLoadRegister(HostRegister destination, Register source);
+    static void EmitStoreRegister(Register destination, HostRegister source, u8 size);
+    static void EmitLoadMemory(HostRegister destination, const HostOperand& source, u8 size);
+
+    static void EmitJump(u8 condition, u32 target);
+    static void EmitJumpTo(u8 condition, u32 codeOffset);
+
+    static HostOperand GetOperand(Register reg);
+    static HostRegister GetHostRegister(Register reg);
+    static bool IsSupportedSize(u8 size);
+    static HostOperand GetRegisterFileOperand(Register reg);
+
+    // Instruction encoding
+    static void EmitByte(u8 value);
+    static void EmitU32(u32 value);
+    static void EmitU64(u64 value);
+    static void EmitInstruction(u8 size, bool forceRex, std::initializer_list<u8> opcode, u8 reg, const HostOperand& rm);
+    static void EmitMove(u8 size, HostRegister destination, const HostOperand& source);
+    static void EmitMove(u8 size, const HostOperand& destination, HostRegister source);
+    static void EmitMoveImmediate(HostRegister destination, u64 value);
+    static void EmitZeroExtend(u8 size, HostRegister destination, const HostOperand& source);
+    static void EmitSignExtend32(HostRegister destination, const HostOperand& source);
+    static void EmitArithmetic(u8 opcode, u8 size, HostRegister destination, const HostOperand& source);
+    static void EmitArithmeticImmediate(u8 extension, const HostOperand& destination, i32 value);
+    static void EmitShift(u8 extension, HostRegister reg, u8 count);
+    static void EmitMultiply(HostRegister destination, const HostOperand& source);
+    static void EmitDivide(u8 size, const HostOperand& source);
+    static void EmitSetCondition(u8 condition, HostRegister reg);
+    static void EmitPush(HostRegister reg);
+    static void EmitPop(HostRegister reg);
+
+    // Called from the machine code, the Interpreter's state is only touched through these
+    static void CallFunction(Interpreter* interpreter, Module* module, u32 functionHash);
+    static const u8* TailCall(Interpreter* interpreter, Module* module, u32 functionHash);
+    static void AllocateHeap(Interpreter* interpreter);
+    static void FreeHeap(Interpreter* interpreter);
+    static void CopyMemory(Interpreter* interpreter, const MemCopy* opcode);
+    static void SetMemory(Interpreter* interpreter, const MemSet* opcode);
+    static void CreateString(Interpreter* interpreter, Module* module, u32 strIndex);
+
+private:
+    static thread_local JitContext* _context;
+};
@@ -0,0 +1,130 @@
+#include "pch/Build.h"
+#include "CompileCache.h"
+#include "Compiler.h"
+#include "Utils/StringUtils.h"
+
+#include <filesystem>
+
+#ifdef _WIN32
+#include <Windows.h>
+#endif
+
+bool CompileCache::GetKey(Module* module, const char* source, size_t size, u64& key)
+{
+    u64 compilerHash = 0;
+    if (!GetCompilerHash(compilerHash))
+    {
+        DebugHandler::PrintWarning("CompileCache : Failed to identify the compiler executable, compiling without the cache");
+        return false;
+    }
+
+    key = StringUtils::fnv1a_64(source, size);
+
+    u32 imageVersion = BytecodeImage::Version;
+    key = StringUtils::fnv1a_64(&compilerHash, sizeof(u64), key);
+    key = StringUtils::fnv1a_64(&imageVersion, sizeof(u32), key);
+
+    // The same source generates different code with the IR enabled
+    bool isIREnabled = module->irInfo.isEnabled;
+    key = StringUtils::fnv1a_64(&isIREnabled, sizeof(bool), key);
+
+    // Functions no entry point reaches aren't part of the image
+    std::vector<u32>& entryPoints = module->reachabilityInfo.entryPoints;
+    if (entryPoints.size())
+    {
+        key = StringUtils::fnv1a_64(entryPoints.data(), entryPoints.size() * sizeof(u32), key);
+    }
+
+    return true;
+}
+
+bool CompileCache::TryLoad(const std::string& directory, u64 key, Module* module)
+{
+    std::string path = GetPath(directory, key);
+
+    // A miss is the common case, so don't let BytecodeImage report it as an error
+    std::error_code errorCode;
+    if (!std::filesystem::exists(path, errorCode))
+        return false;
+
+    return BytecodeImage::Load(module, path);
+}
+
+bool CompileCache::Store(const std::string& directory, u64 key, Module* module)
+{
+    std::error_code errorCode;
+    std::filesystem::create_directories(directory, errorCode);
+    if (errorCode)
+    {
+        DebugHandler::PrintError("CompileCache : Failed to create cache directory (%s)", directory.c_str());
+        return false;
+    }
+
+    // Written next to its final name and renamed into place, so other compilers never see a partial image
+    std::string path = GetPath(directory, key);
+    std::string temporaryPath = path + ".tmp";
+
+    if (!BytecodeImage::Save(module, temporaryPath))
+        return false;
+
+    std::filesystem::rename(temporaryPath, path, errorCode);
+    if (errorCode)
+    {
+        DebugHandler::PrintError("CompileCache : Failed to move (%s) into the cache", temporaryPath.c_str());
+        std::filesystem::remove(temporaryPath, errorCode);
+        return false;
+    }
+
+    return true;
+}
+
+bool CompileCache::Copy(const std::string& directory, u64 key, const std::string& path)
+{
+    std::error_code errorCode;
+    std::filesystem::copy_file(GetPath(directory, key), path, std::filesystem::copy_options::overwrite_existing, errorCode);
+    if (errorCode)
+    {
+        DebugHandler::PrintError("CompileCache : Failed to copy the cached image to (%s)", path.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+bool CompileCache::GetCompilerHash(u64& hash)
+{
+    std::error_code errorCode;
+
+#ifdef _WIN32
+    char executablePath[MAX_PATH];
+    DWORD length = GetModuleFileNameA(nullptr, executablePath, MAX_PATH);
+    if (length == 0 || length == MAX_PATH)
+        return false;
+
+    std::filesystem::path path(std::string(executablePath, length));
+#else
+    std::filesystem::path path = std::filesystem::read_symlink("/proc/self/exe", errorCode);
+    if (errorCode)
+        return false;
+#endif
+
+    u64 size = static_cast<u64>(std::filesystem::file_size(path, errorCode));
+    if (errorCode)
+        return false;
+
+    i64 writeTime = static_cast<i64>(std::filesystem::last_write_time(path, errorCode).time_since_epoch().count());
+    if (errorCode)
+        return false;
+
+    hash = StringUtils::fnv1a_64(&size, sizeof(u64));
+    hash = StringUtils::fnv1a_64(&writeTime, sizeof(i64), hash);
+    return true;
+}
+
+std::string CompileCache::GetPath(const std::string& directory, u64 key)
+{
+    char fileName[32];
+    snprintf(fileName, sizeof(fileName), "%016llx.naib", static_cast<unsigned long long>(key));
+
+    return (std::filesystem::path(directory) / fileName).string();
+}
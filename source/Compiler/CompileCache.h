@@ -0,0 +1,26 @@
+#pragma once
+#include "pch/Build.h"
+#include <string>
+
+struct Module;
+
+// Content-addressed store of bytecode images in a local directory
+// A module whose source and compiler build hash to a key that is already stored can skip the whole pipeline
+class CompileCache
+{
+public:
+    // Call before the module is parsed, a hit skips the whole front end
+    // False when we can't tell which build of the compiler is running, the cache can't be used then
+    static bool GetKey(Module* module, const char* source, size_t size, u64& key);
+
+    static bool TryLoad(const std::string& directory, u64 key, Module* module);
+    static bool Store(const std::string& directory, u64 key, Module* module);
+
+    // Copies a stored image to path, the same file saving the image of the loaded module would write
+    static bool Copy(const std::string& directory, u64 key, const std::string& path);
+
+private:
+    // Size and write time of our own executable, so every rebuild of the compiler starts from an empty cache
+    static bool GetCompilerHash(u64& hash);
+    static std::string GetPath(const std::string& directory, u64 key);
+};
@@ -4,11 +4,21 @@
 #include "Utils/BucketArray.h"
 
 #include "Module.h"
+#include "NativeBinding.h"
+#include "Incremental.h"
+#include "CompileCache.h"
 #include "Frontend/Lexer.h"
 #include "Frontend/Parser.h"
+#include "Frontend/Reachability.h"
 #include "Frontend/Typer.h"
+#include "Frontend/Folder.h"
+#include "IR/Optimizer.h"
 #include "Backend/Bytecode/Bytecode.h"
+#include "Backend/Bytecode/BytecodeVerifier.h"
 #include "Backend/Bytecode/Interpreter.h"
+#include "Backend/Bytecode/BytecodeImage.h"
+#include "Backend/x86_64/x86_64.h"
+#include "Backend/x86_64/ObjectFile.h"
 
 struct Compiler
 {
@@ -0,0 +1,692 @@
+#include "pch/Build.h"
+#include "Folder.h"
+#include "../Module.h"
+#include "Utils/JobUtils.h"
+
+thread_local FolderContext* Folder::_context = nullptr;
+
+void Folder::Process(Module* module)
+{
+    std::vector<Declaration*> declarations;
+
+    ListNode* node;
+    ListIterate(&module->parserInfo.block->scope->declarations, node)
+    {
+        Declaration* declaration = ListGetStructPtr(node, Declaration, listNode);
+        declarations.push_back(declaration);
+    }
+
+    Process(module, declarations);
+}
+
+void Folder::Process(Module* module, const std::vector<Declaration*>& declarations)
+{
+    std::vector<Declaration*> functions;
+    for (Declaration* declaration : declarations)
+    {
+        if (declaration->kind == Declaration::Kind::Function && !declaration->function.flags.nativeCall && !declaration->function.flags.unreachable)
+        {
+            functions.push_back(declaration);
+        }
+    }
+
+    // Function bodies don't share any expressions, so they can be folded independently
+    std::atomic<u32> numFolded = 0;
+    JobUtils::ParallelFor(functions.size(), [&](size_t index)
+    {
+        FolderContext context;
+        _context = &context;
+
+        FoldFunction(module, functions[index]);
+        numFolded += context.numFolded;
+
+        _context = nullptr;
+    });
+
+    DebugHandler::PrintSuccess("Folder : Successfully Processsed Module (%s) (Functions: %u, Folded: %u)", module->nameHash.name.c_str(), static_cast<u32>(functions.size()), numFolded.load());
+}
+
+void Folder::FoldFunction(Module* module, Declaration* declaration)
+{
+    Function* function = &declaration->function;
+
+    CollectLocals(function->body->compound.scope);
+
+    // Analyze first, a local can only be propagated once we know nothing else writes to it or takes its address
+    AnalyzeStatement(module, function->body);
+    FoldStatement(module, function->body);
+}
+
+void Folder::CollectLocals(Scope* scope)
+{
+    ListNode* node;
+    ListIterate(&scope->declarations, node)
+    {
+        Declaration* declaration = ListGetStructPtr(node, Declaration, listNode);
+
+        if (declaration->kind == Declaration::Kind::Variable && declaration->type->IsBasic())
+        {
+            _context->locals[declaration];
+        }
+    }
+
+    ListIterate(&scope->scopeChildren, node)
+    {
+        Scope* subScope = ListGetStructPtr(node, Scope, listNode);
+        CollectLocals(subScope);
+    }
+}
+
+void Folder::AnalyzeStatement(Module* module, Statement* statement)
+{
+    switch (statement->kind)
+    {
+        case Statement::Kind::Compound:
+        {
+            ListNode* node;
+            ListIterate(&statement->compound.statements, node)
+            {
+                Statement* stmt = ListGetStructPtr(node, Statement, listNode);
+                AnalyzeStatement(module, stmt);
+            }
+            break;
+        }
+        case Statement::Kind::Expression:
+        {
+            AnalyzeExpression(module, statement->expression);
+            break;
+        }
+        case Statement::Kind::Return:
+        {
+            if (statement->returnStmt.expression)
+            {
+                AnalyzeExpression(module, statement->returnStmt.expression);
+            }
+            break;
+        }
+        case Statement::Kind::Conditional:
+        {
+            Conditional* conditional = &statement->conditional;
+
+            AnalyzeExpression(module, conditional->condition);
+            AnalyzeStatement(module, conditional->trueBody);
+
+            if (conditional->falseBody)
+            {
+                AnalyzeStatement(module, conditional->falseBody);
+            }
+            break;
+        }
+        case Statement::Kind::Loop:
+        {
+            // The condition comes first, so a local assigned in the body and read in the condition counts as read before assigned
+            AnalyzeExpression(module, statement->loop.condition);
+            AnalyzeStatement(module, statement->loop.body);
+            break;
+        }
+
+        default:
+        {
+            break;
+        }
+    }
+}
+
+void Folder::AnalyzeExpression(Module* module, Expression* expression)
+{
+    switch (expression->kind)
+    {
+        case Expression::Kind::Primary:
+        {
+            if (expression->primary.kind != Primary::Kind::Identifier)
+                break;
+
+            auto itr = _context->locals.find(expression->primary.declaration);
+            if (itr != _context->locals.end() && itr->second.numAssignments == 0)
+            {
+                itr->second.isReadBeforeAssigned = true;
+            }
+            break;
+        }
+        case Expression::Kind::Unary:
+        {
+            if (expression->unary.kind == Unary::Kind::AddressOf)
+            {
+                MarkAddressTaken(expression->unary.operand);
+            }
+
+            AnalyzeExpression(module, expression->unary.operand);
+            break;
+        }
+        case Expression::Kind::Binary:
+        {
+            Binary* binary = &expression->binary;
+
+            // && and || evaluate the left hand side first and skip the right one when the left decides the result
+            if (binary->kind == Binary::Kind::LogicalAnd || binary->kind == Binary::Kind::LogicalOr)
+            {
+                AnalyzeExpression(module, binary->left);
+                AnalyzeExpression(module, binary->right);
+                break;
+            }
+
+            // Bytecode evaluates the right hand side first
+            AnalyzeExpression(module, binary->right);
+
+            if (binary->kind == Binary::Kind::Assign && binary->left->kind == Expression::Kind::Primary)
+            {
+                auto itr = _context->locals.find(binary->left->primary.declaration);
+                if (itr != _context->locals.end())
+                {
+                    itr->second.numAssignments++;
+                }
+            }
+            else
+            {
+                AnalyzeExpression(module, binary->left);
+            }
+            break;
+        }
+        case Expression::Kind::Call:
+        {
+            ListNode* node;
+            ListIterate(&expression->call.arguments, node)
+            {
+                Expression* argument = ListGetStructPtr(node, Expression, listNode);
+                AnalyzeExpression(module, argument);
+            }
+            break;
+        }
+        case Expression::Kind::Dot:
+        {
+            // Members are accessed through the address of the struct
+            MarkAddressTaken(expression->dot.expression);
+            AnalyzeExpression(module, expression->dot.expression);
+            break;
+        }
+        case Expression::Kind::MemoryNew:
+        case Expression::Kind::MemoryFree:
+        {
+            AnalyzeExpression(module, expression->memory.expression);
+            break;
+        }
+
+        default:
+        {
+            break;
+        }
+    }
+}
+
+void Folder::MarkAddressTaken(Expression* expression)
+{
+    while (expression->kind == Expression::Kind::Dot)
+    {
+        expression = expression->dot.expression;
+    }
+
+    if (expression->kind != Expression::Kind::Primary || expression->primary.kind != Primary::Kind::Identifier)
+        return;
+
+    auto itr = _context->locals.find(expression->primary.declaration);
+    if (itr != _context->locals.end())
+    {
+        itr->second.isAddressTaken = true;
+    }
+}
+
+void Folder::FoldStatement(Module* module, Statement* statement)
+{
+    switch (statement->kind)
+    {
+        case Statement::Kind::Compound:
+        {
+            ListNode* node;
+            ListIterate(&statement->compound.statements, node)
+            {
+                Statement* stmt = ListGetStructPtr(node, Statement, listNode);
+                FoldStatement(module, stmt);
+            }
+            break;
+        }
+        case Statement::Kind::Expression:
+        {
+            statement->expression = FoldExpression(module, statement->expression);
+            break;
+        }
+        case Statement::Kind::Return:
+        {
+            if (statement->returnStmt.expression)
+            {
+                statement->returnStmt.expression = FoldExpression(module, statement->returnStmt.expression);
+            }
+            break;
+        }
+        case Statement::Kind::Conditional:
+        {
+            Conditional* conditional = &statement->conditional;
+
+            conditional->condition = FoldExpression(module, conditional->condition);
+            FoldStatement(module, conditional->trueBody);
+
+            if (conditional->falseBody)
+            {
+                FoldStatement(module, conditional->falseBody);
+            }
+            break;
+        }
+        case Statement::Kind::Loop:
+        {
+            statement->loop.condition = FoldExpression(module, statement->loop.condition);
+            FoldStatement(module, statement->loop.body);
+            break;
+        }
+
+        default:
+        {
+            break;
+        }
+    }
+}
+
+Expression* Folder::FoldExpression(Module* module, Expression* expression)
+{
+    switch (expression->kind)
+    {
+        case Expression::Kind::Primary:
+        {
+            return FoldExpressionPrimary(module, expression);
+        }
+        case Expression::Kind::Unary:
+        {
+            // The operand of AddressOf is never a propagated local, those are excluded by the analysis
+            expression->unary.operand = FoldExpression(module, expression->unary.operand);
+            return expression;
+        }
+        case Expression::Kind::Binary:
+        {
+            return FoldExpressionBinary(module, expression);
+        }
+        case Expression::Kind::Call:
+        {
+            return FoldExpressionCall(module, expression);
+        }
+        case Expression::Kind::Dot:
+        {
+            expression->dot.expression = FoldExpression(module, expression->dot.expression);
+            return expression;
+        }
+        case Expression::Kind::MemoryNew:
+        case Expression::Kind::MemoryFree:
+        {
+            expression->memory.expression = FoldExpression(module, expression->memory.expression);
+            return expression;
+        }
+
+        default:
+        {
+            return expression;
+        }
+    }
+}
+
+Expression* Folder::FoldExpressionPrimary(Module* /*module*/, Expression* expression)
+{
+    Primary* primary = &expression->primary;
+    if (primary->kind != Primary::Kind::Identifier)
+        return expression;
+
+    FolderLocal* local = GetPropagatableLocal(expression);
+    if (!local || !local->isConstant)
+        return expression;
+
+    ReplaceWithNumber(expression, primary->token, local->value);
+    return expression;
+}
+
+Expression* Folder::FoldExpressionBinary(Module* module, Expression* expression)
+{
+    Binary* binary = &expression->binary;
+
+    if (binary->kind == Binary::Kind::LogicalAnd || binary->kind == Binary::Kind::LogicalOr)
+        return FoldExpressionLogical(module, expression);
+
+    if (binary->kind == Binary::Kind::Assign)
+    {
+        binary->right = FoldExpression(module, binary->right);
+
+        if (binary->left->kind != Expression::Kind::Primary)
+        {
+            binary->left = FoldExpression(module, binary->left);
+            return expression;
+        }
+
+        // Uses are only replaced after this point, the analysis already made sure none of them come before it
+        FolderLocal* local = GetPropagatableLocal(binary->left);
+        if (local && binary->right->kind == Expression::Kind::Primary && binary->right->primary.kind == Primary::Kind::Number)
+        {
+            local->isConstant = true;
+            local->value = Truncate(binary->left->type, binary->right->primary.number);
+        }
+
+        return expression;
+    }
+
+    binary->right = FoldExpression(module, binary->right);
+    binary->left = FoldExpression(module, binary->left);
+
+    // Pointer arithmetic still gets its operands folded, but the result depends on the pointer
+    Type* type = expression->type;
+    if (!type->IsBasic())
+        return expression;
+
+    Expression* left = binary->left;
+    Expression* right = binary->right;
+
+    bool isLeftNumber = left->kind == Expression::Kind::Primary && left->primary.kind == Primary::Kind::Number;
+    bool isRightNumber = right->kind == Expression::Kind::Primary && right->primary.kind == Primary::Kind::Number;
+
+    if (isLeftNumber && isRightNumber)
+    {
+        u64 result;
+        if (Evaluate(binary->kind, type, left->primary.number, right->primary.number, result))
+        {
+            ReplaceWithNumber(expression, binary->op, result);
+        }
+
+        return expression;
+    }
+
+    // Identities can only drop the binary if the operand we keep already has the type the binary had
+    bool keepsLeftType = left->type == type;
+    bool keepsRightType = right->type == type;
+
+    switch (binary->kind)
+    {
+        case Binary::Kind::Add:
+        {
+            if (IsNumber(right, 0) && keepsLeftType)
+            {
+                _context->numFolded++;
+                return left;
+            }
+
+            if (IsNumber(left, 0) && keepsRightType)
+            {
+                _context->numFolded++;
+                return right;
+            }
+            break;
+        }
+        case Binary::Kind::Subtract:
+        {
+            if (IsNumber(right, 0) && keepsLeftType)
+            {
+                _context->numFolded++;
+                return left;
+            }
+            break;
+        }
+        case Binary::Kind::Multiply:
+        {
+            if (IsNumber(right, 1) && keepsLeftType)
+            {
+                _context->numFolded++;
+                return left;
+            }
+
+            if (IsNumber(left, 1) && keepsRightType)
+            {
+                _context->numFolded++;
+                return right;
+            }
+
+            // Dropping an operand also drops its side effects
+            if ((IsNumber(right, 0) && IsPure(left)) || (IsNumber(left, 0) && IsPure(right)))
+            {
+                ReplaceWithNumber(expression, binary->op, 0);
+            }
+            break;
+        }
+        case Binary::Kind::Divide:
+        {
+            if (IsNumber(right, 1) && keepsLeftType)
+            {
+                _context->numFolded++;
+                return left;
+            }
+            break;
+        }
+        case Binary::Kind::Modulo:
+        {
+            if (IsNumber(right, 1) && IsPure(left))
+            {
+                ReplaceWithNumber(expression, binary->op, 0);
+            }
+            break;
+        }
+
+        default:
+        {
+            break;
+        }
+    }
+
+    return expression;
+}
+
+Expression* Folder::FoldExpressionLogical(Module* module, Expression* expression)
+{
+    Binary* binary = &expression->binary;
+
+    binary->left = FoldExpression(module, binary->left);
+    binary->right = FoldExpression(module, binary->right);
+
+    Expression* left = binary->left;
+    Expression* right = binary->right;
+
+    bool isLeftNumber = left->kind == Expression::Kind::Primary && left->primary.kind == Primary::Kind::Number;
+    bool isRightNumber = right->kind == Expression::Kind::Primary && right->primary.kind == Primary::Kind::Number;
+
+    if (!isLeftNumber)
+        return expression;
+
+    // Evaluate would truncate the operands to bool, only their comparison against zero matters here
+    bool isLeftTrue = !IsNumber(left, 0);
+    bool isAnd = binary->kind == Binary::Kind::LogicalAnd;
+
+    // false && x and true || x never evaluate x
+    if (isLeftTrue != isAnd)
+    {
+        ReplaceWithNumber(expression, binary->op, isLeftTrue ? 1 : 0);
+    }
+    else if (isRightNumber)
+    {
+        ReplaceWithNumber(expression, binary->op, IsNumber(right, 0) ? 0 : 1);
+    }
+
+    return expression;
+}
+
+Expression* Folder::FoldExpressionCall(Module* module, Expression* expression)
+{
+    ListNode* node;
+    ListIterate(&expression->call.arguments, node)
+    {
+        Expression* argument = ListGetStructPtr(node, Expression, listNode);
+
+        Expression* folded = FoldExpression(module, argument);
+        if (folded != argument)
+        {
+            // Take over the argument's place in the list
+            List::AddNode(&folded->listNode, argument->listNode.prev, argument->listNode.next);
+            node = &folded->listNode;
+        }
+    }
+
+    return expression;
+}
+
+FolderLocal* Folder::GetPropagatableLocal(Expression* expression)
+{
+    assert(expression->kind == Expression::Kind::Primary);
+
+    if (expression->primary.kind != Primary::Kind::Identifier)
+        return nullptr;
+
+    auto itr = _context->locals.find(expression->primary.declaration);
+    if (itr == _context->locals.end())
+        return nullptr;
+
+    FolderLocal* local = &itr->second;
+    if (local->numAssignments != 1 || local->isAddressTaken || local->isReadBeforeAssigned)
+        return nullptr;
+
+    return local;
+}
+
+bool Folder::IsNumber(Expression* expression, u64 value)
+{
+    if (expression->kind != Expression::Kind::Primary || expression->primary.kind != Primary::Kind::Number)
+        return false;
+
+    return Truncate(expression->type, expression->primary.number) == Truncate(expression->type, value);
+}
+
+bool Folder::IsPure(Expression* expression)
+{
+    switch (expression->kind)
+    {
+        case Expression::Kind::Primary:
+        {
+            // Strings are allocated on the heap when evaluated
+            return expression->primary.kind != Primary::Kind::String;
+        }
+        case Expression::Kind::Unary:
+        {
+            return IsPure(expression->unary.operand);
+        }
+        case Expression::Kind::Binary:
+        {
+            if (expression->binary.kind == Binary::Kind::Assign)
+                return false;
+
+            return IsPure(expression->binary.left) && IsPure(expression->binary.right);
+        }
+        case Expression::Kind::Dot:
+        {
+            return IsPure(expression->dot.expression);
+        }
+
+        default:
+        {
+            return false;
+        }
+    }
+}
+
+bool Folder::Evaluate(Binary::Kind kind, Type* type, u64 left, u64 right, u64& result)
+{
+    left = Truncate(type, left);
+    right = Truncate(type, right);
+
+    // The interpreter divides and compares unsigned, folding negative signed operands would give a different answer than running it
+    bool hasNegativeOperand = type->IsSigned() && (static_cast<i64>(left) < 0 || static_cast<i64>(right) < 0);
+
+    switch (kind)
+    {
+        case Binary::Kind::Add:
+        {
+            result = left + right;
+            break;
+        }
+        case Binary::Kind::Subtract:
+        {
+            result = left - right;
+            break;
+        }
+        case Binary::Kind::Multiply:
+        {
+            result = left * right;
+            break;
+        }
+        case Binary::Kind::Equal:
+        {
+            result = left == right;
+            break;
+        }
+        case Binary::Kind::NotEqual:
+        {
+            result = left != right;
+            break;
+        }
+
+        case Binary::Kind::Divide:
+        case Binary::Kind::Modulo:
+        {
+            // Leave division by zero for the interpreter to report
+            if (right == 0 || hasNegativeOperand)
+                return false;
+
+            result = kind == Binary::Kind::Divide ? left / right : left % right;
+            break;
+        }
+
+        case Binary::Kind::LessThan:
+        case Binary::Kind::LessEqual:
+        case Binary::Kind::GreaterThan:
+        case Binary::Kind::GreaterEqual:
+        {
+            if (hasNegativeOperand)
+                return false;
+
+            if (kind == Binary::Kind::LessThan)
+                result = left < right;
+            else if (kind == Binary::Kind::LessEqual)
+                result = left <= right;
+            else if (kind == Binary::Kind::GreaterThan)
+                result = left > right;
+            else
+                result = left >= right;
+            break;
+        }
+
+        default:
+        {
+            return false;
+        }
+    }
+
+    result = Truncate(type, result);
+    return true;
+}
+
+u64 Folder::Truncate(Type* type, u64 value)
+{
+    if (!type->IsBasic() || type->size >= 8)
+        return value;
+
+    u32 numBits = type->size * 8;
+    u64 mask = (1ull << numBits) - 1;
+
+    value &= mask;
+
+    // Sign extend, so the value reads the same no matter what width it is loaded at
+    if (type->IsSigned() && (value >> (numBits - 1)) & 1)
+    {
+        value |= ~mask;
+    }
+
+    return value;
+}
+
+void Folder::ReplaceWithNumber(Expression* expression, Token* token, u64 value)
+{
+    // The type is left alone, Bytecode sizes the surrounding operations by it
+    expression->kind = Expression::Kind::Primary;
+    expression->primary.kind = Primary::Kind::Number;
+    expression->primary.token = token;
+    expression->primary.number = value;
+
+    _context->numFolded++;
+}
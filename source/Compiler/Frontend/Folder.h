@@ -0,0 +1,45 @@
+#pragma once
+#include "pch/Build.h"
+#include "../Tree.h"
+#include <vector>
+
+struct Module;
+struct FolderContext;
+struct FolderLocal;
+
+// Runs between the Typer and Bytecode, evaluates constant subexpressions in place and propagates locals that are only ever assigned a constant
+// Folded expressions keep the type the Typer gave them, so Bytecode sees the same widths it would have without folding
+class Folder
+{
+public:
+    static void Process(Module* module);
+
+    // Folds a subset of the global declarations, the rest of the module is left as it is
+    static void Process(Module* module, const std::vector<Declaration*>& declarations);
+
+private:
+    static void FoldFunction(Module* module, Declaration* declaration);
+    static void CollectLocals(Scope* scope);
+
+    static void AnalyzeStatement(Module* module, Statement* statement);
+    static void AnalyzeExpression(Module* module, Expression* expression);
+    static void MarkAddressTaken(Expression* expression);
+
+    static void FoldStatement(Module* module, Statement* statement);
+    static Expression* FoldExpression(Module* module, Expression* expression);
+    static Expression* FoldExpressionPrimary(Module* module, Expression* expression);
+    static Expression* FoldExpressionBinary(Module* module, Expression* expression);
+    static Expression* FoldExpressionLogical(Module* module, Expression* expression);
+    static Expression* FoldExpressionCall(Module* module, Expression* expression);
+
+    static FolderLocal* GetPropagatableLocal(Expression* expression);
+    static bool IsNumber(Expression* expression, u64 value);
+    static bool IsPure(Expression* expression);
+    static bool Evaluate(Binary::Kind kind, Type* type, u64 left, u64 right, u64& result);
+    static u64 Truncate(Type* type, u64 value);
+    static void ReplaceWithNumber(Expression* expression, Token* token, u64 value);
+
+private:
+    // Locals of the function this thread is folding
+    static thread_local FolderContext* _context;
+};
@@ -3,6 +3,7 @@
 #include "../Module.h"
 #include "../Tree.h"
 #include "Typer.h"
+#include "TypeTable.h"
 
 i8 GetBinaryPrecedence(Token::Kind kind)
 {
@@ -27,6 +28,12 @@ i8 GetBinaryPrecedence(Token::Kind kind)
     case Token::Kind::Op_NotEqual:
         return 19;
 
+    case Token::Kind::Op_And:
+        return 12;
+
+    case Token::Kind::Op_Or:
+        return 11;
+
     case Token::Kind::Op_Assign:
         return 1;
 
@@ -50,6 +57,10 @@ Binary::Kind GetBinaryKind(Token::Kind kind)
         return Binary::Kind::GreaterThan;
     case Token::Kind::Op_GreaterEqual:
         return Binary::Kind::GreaterEqual;
+    case Token::Kind::Op_And:
+        return Binary::Kind::LogicalAnd;
+    case Token::Kind::Op_Or:
+        return Binary::Kind::LogicalOr;
     case Token::Kind::Op_Add:
         return Binary::Kind::Add;
     case Token::Kind::Op_Subtract:
@@ -296,11 +307,21 @@ bool Parser::TryParseDeclaration(Module* module, Statement*& stmt)
         }
         else
         {
-            function->returnType = Type::Create(Type::Kind::Void);
+            function->returnType = Type_Void;
         }
 
-        function->body = ParseStatementCompound(module);
         declaration->function.flags.nativeCall = false;
+        declaration->function.flags.alwaysInline = false;
+        declaration->function.flags.neverInline = false;
+        declaration->function.flags.unreachable = false;
+        declaration->function.flags.intrinsic = false;
+
+        while (module->lexerInfo.PeekToken()->kind == Token::Kind::Hashtag)
+        {
+            ParseFunctionDirective(module, function);
+        }
+
+        function->body = ParseStatementCompound(module);
 
         ExitScope(module);
         DeclarationPushToCurrentScope(module, declaration);
@@ -310,6 +331,35 @@ bool Parser::TryParseDeclaration(Module* module, Statement*& stmt)
     return false;
 }
 
+void Parser::ParseFunctionDirective(Module* module, Function* function)
+{
+    module->lexerInfo.SkipToken(Token::Kind::Hashtag);
+
+    Token* token = module->lexerInfo.ConsumeToken();
+    if (token->kind != Token::Kind::Identifier)
+    {
+        module->lexerInfo.Error(token, "Expecting a directive after '#' but got '%s'", Token::GetTokenKindName(token->kind));
+    }
+
+    if (token->nameHash.hash == "inline"_djb2)
+    {
+        function->flags.alwaysInline = true;
+    }
+    else if (token->nameHash.hash == "no_inline"_djb2)
+    {
+        function->flags.neverInline = true;
+    }
+    else
+    {
+        module->lexerInfo.Error(token, "Unknown function directive (#%.*s)", token->nameHash.length, token->nameHash.name);
+    }
+
+    if (function->flags.alwaysInline && function->flags.neverInline)
+    {
+        module->lexerInfo.Error(token, "A function cannot be both #inline and #no_inline");
+    }
+}
+
 Statement* Parser::ParseStatement(Module* module)
 {
     Token* token = module->lexerInfo.PeekToken();
@@ -885,9 +935,7 @@ Type* Parser::ParseTypeSuffix(Module* module, Type* type)
     {
         module->lexerInfo.SkipToken(Token::Kind::Op_Multiply);
 
-        Type* typePtr = Type::CreatePointer();
-        typePtr->pointer.type = type;
-
+        Type* typePtr = TypeTable::GetPointer(type);
         return ParseTypeSuffix(module, typePtr);
     }
     else if (token->kind == Token::Kind::Bracket_Open)
@@ -902,13 +950,12 @@ Type* Parser::ParseTypeSuffix(Module* module, Type* type)
             module->lexerInfo.Error(token, "Array Index must be compile time constant");
         }
 
-        Type* typePtr = Type::CreatePointer();
-        typePtr->pointer.count = token->number;
+        u64 count = token->number;
 
         module->lexerInfo.SkipToken(Token::Kind::Number);
         module->lexerInfo.SkipToken(Token::Kind::Bracket_Close);
 
-        typePtr->pointer.type = type;
+        Type* typePtr = TypeTable::GetPointer(type, count);
         return ParseTypeSuffix(module, typePtr);
     }
 
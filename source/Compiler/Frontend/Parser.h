@@ -10,6 +10,7 @@ struct StructMember;
 struct Declaration;
 struct Expression;
 struct Loop;
+struct Function;
 
 class Parser
 {
@@ -18,6 +19,7 @@ public:
 
 private:
     friend struct NativeFunction;
+    friend class Incremental;
 
     static Statement* ParseBlock(Module* module);
     static Scope* EnterScope(Module* module);
@@ -39,6 +41,7 @@ private:
     static void DeclarationPushToCurrentScope(Module* module, Declaration* declaration);
     static Declaration* FindDeclarationInScope(Declaration* declaration, Scope* scope);
     static void ParseFunctionArgument(Module* module);
+    static void ParseFunctionDirective(Module* module, Function* function);
     static Statement* ParseStatementLoop(Module* module);
     static Statement* ParseStatementConditional(Module* module);
     static Statement* ParseStatementExpression(Module* module);
@@ -0,0 +1,162 @@
+#include "pch/Build.h"
+#include "Reachability.h"
+#include "../Module.h"
+
+void Reachability::Process(Module* module)
+{
+    ReachabilityInfo& reachabilityInfo = module->reachabilityInfo;
+
+    // Calls are resolved by name, so the untyped tree is enough to follow them
+    robin_hood::unordered_map<u32, Declaration*> nameHashToFunction;
+    std::vector<Declaration*> functions;
+
+    ListNode* node;
+    ListIterate(&module->parserInfo.block->scope->declarations, node)
+    {
+        Declaration* declaration = ListGetStructPtr(node, Declaration, listNode);
+        if (declaration->kind != Declaration::Kind::Function)
+            continue;
+
+        declaration->function.flags.unreachable = reachabilityInfo.entryPoints.size() > 0;
+
+        nameHashToFunction[declaration->token->nameHash.hash] = declaration;
+        functions.push_back(declaration);
+    }
+
+    std::vector<u32> worklist = reachabilityInfo.entryPoints;
+    u32 numReachable = 0;
+
+    while (worklist.size())
+    {
+        u32 nameHash = worklist.back();
+        worklist.pop_back();
+
+        // Calls to functions that don't exist are reported by the Typer
+        auto itr = nameHashToFunction.find(nameHash);
+        if (itr == nameHashToFunction.end())
+            continue;
+
+        Function* function = &itr->second->function;
+        if (!function->flags.unreachable)
+            continue;
+
+        function->flags.unreachable = false;
+        numReachable++;
+
+        if (!function->flags.nativeCall)
+        {
+            CollectCalls(function->body, worklist);
+        }
+    }
+
+    if (reachabilityInfo.entryPoints.empty())
+    {
+        numReachable = static_cast<u32>(functions.size());
+    }
+
+    DebugHandler::PrintSuccess("Reachability : Successfully Processsed Module (%s) (Functions: %u, Reachable: %u)", module->nameHash.name.c_str(), static_cast<u32>(functions.size()), numReachable);
+}
+
+void Reachability::CollectCalls(Statement* statement, std::vector<u32>& calls)
+{
+    switch (statement->kind)
+    {
+        case Statement::Kind::Compound:
+        {
+            ListNode* node;
+            ListIterate(&statement->compound.statements, node)
+            {
+                Statement* stmt = ListGetStructPtr(node, Statement, listNode);
+                CollectCalls(stmt, calls);
+            }
+            break;
+        }
+        case Statement::Kind::Expression:
+        {
+            CollectCallsExpression(statement->expression, calls);
+            break;
+        }
+        case Statement::Kind::Return:
+        {
+            if (statement->returnStmt.expression)
+            {
+                CollectCallsExpression(statement->returnStmt.expression, calls);
+            }
+            break;
+        }
+        case Statement::Kind::Conditional:
+        {
+            Conditional* conditional = &statement->conditional;
+
+            CollectCallsExpression(conditional->condition, calls);
+            CollectCalls(conditional->trueBody, calls);
+
+            if (conditional->falseBody)
+            {
+                CollectCalls(conditional->falseBody, calls);
+            }
+            break;
+        }
+        case Statement::Kind::Loop:
+        {
+            if (statement->loop.condition)
+            {
+                CollectCallsExpression(statement->loop.condition, calls);
+            }
+
+            CollectCalls(statement->loop.body, calls);
+            break;
+        }
+
+        default:
+        {
+            break;
+        }
+    }
+}
+
+void Reachability::CollectCallsExpression(Expression* expression, std::vector<u32>& calls)
+{
+    switch (expression->kind)
+    {
+        case Expression::Kind::Unary:
+        {
+            CollectCallsExpression(expression->unary.operand, calls);
+            break;
+        }
+        case Expression::Kind::Binary:
+        {
+            CollectCallsExpression(expression->binary.left, calls);
+            CollectCallsExpression(expression->binary.right, calls);
+            break;
+        }
+        case Expression::Kind::Call:
+        {
+            calls.push_back(expression->call.token->nameHash.hash);
+
+            ListNode* node;
+            ListIterate(&expression->call.arguments, node)
+            {
+                Expression* argument = ListGetStructPtr(node, Expression, listNode);
+                CollectCallsExpression(argument, calls);
+            }
+            break;
+        }
+        case Expression::Kind::Dot:
+        {
+            CollectCallsExpression(expression->dot.expression, calls);
+            break;
+        }
+        case Expression::Kind::MemoryNew:
+        case Expression::Kind::MemoryFree:
+        {
+            CollectCallsExpression(expression->memory.expression, calls);
+            break;
+        }
+
+        default:
+        {
+            break;
+        }
+    }
+}
@@ -0,0 +1,19 @@
+#pragma once
+#include "pch/Build.h"
+#include "../Tree.h"
+#include <vector>
+
+struct Module;
+
+// Runs between the Parser and the Typer, walks the calls from the module's entry points and flags every global function none of them reaches
+// The Typer, Folder, Optimizer and Bytecode skip flagged functions, so they cost no compile time and don't end up in the module's code
+// Modules without entry points keep every function, Incremental never flags any since a reloaded module can be called into anywhere
+class Reachability
+{
+public:
+    static void Process(Module* module);
+
+private:
+    static void CollectCalls(Statement* statement, std::vector<u32>& calls);
+    static void CollectCallsExpression(Expression* expression, std::vector<u32>& calls);
+};
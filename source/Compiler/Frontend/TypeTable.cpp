@@ -0,0 +1,142 @@
+#include "pch/Build.h"
+#include "TypeTable.h"
+#include "../Tree.h"
+
+robin_hood::unordered_map<u64, std::vector<Type*>> TypeTable::_pointerTypes;
+robin_hood::unordered_map<u64, std::vector<Type*>> TypeTable::_functionTypes;
+std::shared_mutex TypeTable::_mutex;
+
+bool TypeTable::IsCanonical(Type* type)
+{
+    // Structs are nominal, so they are unique from the moment they are declared even if their layout isn't resolved yet
+    return type->isResolved || type->kind == Type::Kind::Struct;
+}
+
+Type* TypeTable::GetPointer(Type* type, u64 count)
+{
+    assert(type);
+
+    // Pointers to types that are not known yet can't be shared, the Typer interns them once the pointee resolves
+    if (!IsCanonical(type))
+    {
+        Type* pointerType = Type::CreatePointer();
+        pointerType->pointer.type = type;
+        pointerType->pointer.count = count;
+
+        return pointerType;
+    }
+
+    u64 hash = HashPointer(type, count);
+
+    {
+        std::shared_lock lock(_mutex);
+
+        auto itr = _pointerTypes.find(hash);
+        if (itr != _pointerTypes.end())
+        {
+            for (Type* pointerType : itr->second)
+            {
+                if (pointerType->pointer.type == type && pointerType->pointer.count == count)
+                    return pointerType;
+            }
+        }
+    }
+
+    std::unique_lock lock(_mutex);
+
+    // Another thread may have added it while we were waiting for the lock
+    std::vector<Type*>& bucket = _pointerTypes[hash];
+    for (Type* pointerType : bucket)
+    {
+        if (pointerType->pointer.type == type && pointerType->pointer.count == count)
+            return pointerType;
+    }
+
+    Type* pointerType = Type::CreatePointer();
+    pointerType->pointer.type = type;
+    pointerType->pointer.count = count;
+    pointerType->isResolved = true;
+
+    bucket.push_back(pointerType);
+    return pointerType;
+}
+
+Type* TypeTable::GetFunction(Type* returnType, const std::vector<Type*>& argumentTypes)
+{
+    assert(returnType && returnType->isResolved);
+
+    u64 hash = HashFunction(returnType, argumentTypes);
+
+    {
+        std::shared_lock lock(_mutex);
+
+        auto itr = _functionTypes.find(hash);
+        if (itr != _functionTypes.end())
+        {
+            for (Type* functionType : itr->second)
+            {
+                if (IsSameFunction(functionType, returnType, argumentTypes))
+                    return functionType;
+            }
+        }
+    }
+
+    std::unique_lock lock(_mutex);
+
+    std::vector<Type*>& bucket = _functionTypes[hash];
+    for (Type* functionType : bucket)
+    {
+        if (IsSameFunction(functionType, returnType, argumentTypes))
+            return functionType;
+    }
+
+    Type* functionType = Type::CreateFunction();
+    functionType->function.returnType = returnType;
+    functionType->function.numArgumentTypes = static_cast<u32>(argumentTypes.size());
+    functionType->isResolved = true;
+
+    if (functionType->function.numArgumentTypes)
+    {
+        functionType->function.argumentTypes = new Type*[argumentTypes.size()];
+        memcpy(functionType->function.argumentTypes, argumentTypes.data(), argumentTypes.size() * sizeof(Type*));
+    }
+
+    bucket.push_back(functionType);
+    return functionType;
+}
+
+u64 TypeTable::HashPointer(Type* type, u64 count)
+{
+    u64 hash = reinterpret_cast<u64>(type);
+    hash ^= count + 0x9e3779b97f4a7c15 + (hash << 6) + (hash >> 2);
+
+    return hash;
+}
+
+u64 TypeTable::HashFunction(Type* returnType, const std::vector<Type*>& argumentTypes)
+{
+    u64 hash = reinterpret_cast<u64>(returnType);
+
+    for (Type* argumentType : argumentTypes)
+    {
+        hash ^= reinterpret_cast<u64>(argumentType) + 0x9e3779b97f4a7c15 + (hash << 6) + (hash >> 2);
+    }
+
+    return hash;
+}
+
+bool TypeTable::IsSameFunction(Type* functionType, Type* returnType, const std::vector<Type*>& argumentTypes)
+{
+    FunctionType* function = &functionType->function;
+
+    if (function->returnType != returnType || function->numArgumentTypes != argumentTypes.size())
+        return false;
+
+    for (u32 i = 0; i < function->numArgumentTypes; i++)
+    {
+        if (function->argumentTypes[i] != argumentTypes[i])
+            return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,28 @@
+#pragma once
+#include "pch/Build.h"
+#include "robin_hood.h"
+#include <vector>
+#include <shared_mutex>
+
+struct Type;
+
+// Hash-consed storage for structural types (pointers, arrays and function signatures)
+// Two structurally equal types will always resolve to the same Type*, so type equality is a pointer comparison
+class TypeTable
+{
+public:
+    static bool IsCanonical(Type* type);
+    static Type* GetPointer(Type* type, u64 count = 0);
+    static Type* GetFunction(Type* returnType, const std::vector<Type*>& argumentTypes);
+
+private:
+    static u64 HashPointer(Type* type, u64 count);
+    static u64 HashFunction(Type* returnType, const std::vector<Type*>& argumentTypes);
+    static bool IsSameFunction(Type* functionType, Type* returnType, const std::vector<Type*>& argumentTypes);
+
+private:
+    static robin_hood::unordered_map<u64, std::vector<Type*>> _pointerTypes;
+    static robin_hood::unordered_map<u64, std::vector<Type*>> _functionTypes;
+
+    static std::shared_mutex _mutex;
+};
@@ -1,7 +1,10 @@
 #include "pch/Build.h"
 #include "Typer.h"
+#include "TypeTable.h"
 #include "../Module.h"
+#include "Utils/JobUtils.h"
 
+Type* Type_Void = Type::CreateVoid();
 Type* Type_Char = Type::CreateBasic(1, 1, true, true);
 Type* Type_Bool = Type::CreateBasic(1, 1, true, true);
 Type* Type_U8 = Type::CreateBasic(1, 1, true, false);
@@ -13,40 +16,197 @@ Type* Type_I16 = Type::CreateBasic(2, 2, true, true);
 Type* Type_I32 = Type::CreateBasic(4, 4, true, true);
 Type* Type_I64 = Type::CreateBasic(8, 8, true, true);
 
+thread_local TyperContext* Typer::_context = nullptr;
+
 void Typer::Process(Module* module)
 {
-    module->typerInfo.currentScope = nullptr;
+    std::vector<Declaration*> declarations;
+
+    ListNode* node;
+    ListIterate(&module->parserInfo.block->scope->declarations, node)
+    {
+        Declaration* declaration = ListGetStructPtr(node, Declaration, listNode);
+        declarations.push_back(declaration);
+    }
+
+    Process(module, declarations);
+}
+
+void Typer::Process(Module* module, const std::vector<Declaration*>& declarations)
+{
+    TyperInfo& typerInfo = module->typerInfo;
+    typerInfo.context.currentScope = nullptr;
+
+    _context = &typerInfo.context;
+
+    Scope* globalScope = module->parserInfo.block->scope;
+
+    // Stage 1 (Serial) : Struct layouts and function signatures, types are queued ahead of functions
+    for (Declaration* declaration : declarations)
+    {
+        if (declaration->kind == Declaration::Kind::Type)
+        {
+            QueueDeclaration(module, declaration);
+        }
+    }
+
+    for (Declaration* declaration : declarations)
+    {
+        if (declaration->kind == Declaration::Kind::Function)
+        {
+            QueueDeclaration(module, declaration);
+        }
+    }
 
-    u32 passes = 0;
+    u32 numDeclarations = static_cast<u32>(typerInfo.worklist.size());
+    u32 numTyped = 0;
 
-    while (module->typerInfo.typeResolved && module->typerInfo.unresolvedTypes)
+    // The worklist grows while we iterate, declarations are re-queued when something they wait on resolves
+    for (size_t i = 0; i < typerInfo.worklist.size(); i++)
     {
-        module->typerInfo.typeResolved = false;
-        module->typerInfo.unresolvedTypes = false;
+        Declaration* declaration = typerInfo.worklist[i];
+
+        // A declaration waiting on several dependencies can be queued more than once
+        if (typerInfo.pendingDeclarations.find(declaration) == typerInfo.pendingDeclarations.end())
+            continue;
+
+        numTyped++;
+
+        if (TypeDeclaration(module, declaration))
+        {
+            ResolvedDeclaration(module, declaration);
+        }
+        else
+        {
+            WaitForDependencies(module, declaration);
+        }
+    }
+
+    if (typerInfo.pendingDeclarations.size())
+    {
+        for (auto& itr : typerInfo.pendingDeclarations)
+        {
+            Declaration* declaration = itr.first;
+            DebugHandler::PrintError("Typer : Could not resolve (%.*s) (Line: %u, Column: %u)", declaration->token->nameHash.length, declaration->token->nameHash.name, declaration->token->line, declaration->token->column);
+        }
+
+        DebugHandler::PrintError("Typer : Failed to type Module (%s)", module->nameHash.name.c_str());
+        exit(1);
+    }
 
-        TypeScope(module, module->parserInfo.block->scope);
+    typerInfo.worklist.clear();
+    _context = nullptr;
 
-        passes++;
+    // Stage 2 (Parallel) : With every layout and signature known, function bodies no longer depend on each other
+    std::vector<Declaration*> functions;
+    for (Declaration* declaration : declarations)
+    {
+        if (declaration->kind == Declaration::Kind::Function && !declaration->function.flags.nativeCall && !declaration->function.flags.unreachable)
+        {
+            functions.push_back(declaration);
+        }
     }
 
-    if (module->typerInfo.unresolvedTypes)
+    std::atomic<bool> failedToType = false;
+    JobUtils::ParallelFor(functions.size(), [&](size_t index)
+    {
+        Declaration* declaration = functions[index];
+
+        TyperContext context;
+        _context = &context;
+
+        EnterScope(module, globalScope);
+        ResolveTypeFunctionBody(module, declaration);
+        ExitScope(module);
+
+        if (context.unresolvedTypes)
+        {
+            DebugHandler::PrintError("Typer : Could not resolve the body of (%.*s) (Line: %u, Column: %u)", declaration->token->nameHash.length, declaration->token->nameHash.name, declaration->token->line, declaration->token->column);
+            failedToType = true;
+        }
+
+        _context = nullptr;
+    });
+
+    if (failedToType)
     {
         DebugHandler::PrintError("Typer : Failed to type Module (%s)", module->nameHash.name.c_str());
         exit(1);
     }
 
-    DebugHandler::PrintSuccess("Typer : Successfully Processsed Module (%s) (Passes: %u)", module->nameHash.name.c_str(), passes);
+    DebugHandler::PrintSuccess("Typer : Successfully Processsed Module (%s) (Declarations: %u, Typed: %u, Function Bodies: %u)", module->nameHash.name.c_str(), numDeclarations, numTyped, static_cast<u32>(functions.size()));
+}
+
+void Typer::QueueDeclaration(Module* module, Declaration* declaration)
+{
+    module->typerInfo.pendingDeclarations[declaration];
+    module->typerInfo.worklist.push_back(declaration);
+}
+
+bool Typer::TypeDeclaration(Module* module, Declaration* declaration)
+{
+    _context->unresolvedTypes = false;
+    _context->dependencies.clear();
+
+    EnterScope(module, module->parserInfo.block->scope);
+
+    if (declaration->kind == Declaration::Kind::Type)
+    {
+        ResolveTypeDeclaration(module, declaration);
+    }
+    else
+    {
+        ResolveTypeFunctionSignature(module, declaration);
+    }
+
+    ExitScope(module);
+
+    return !_context->unresolvedTypes && declaration->type->isResolved;
+}
+
+void Typer::ResolvedDeclaration(Module* module, Declaration* declaration)
+{
+    TyperInfo& typerInfo = module->typerInfo;
+
+    auto itr = typerInfo.pendingDeclarations.find(declaration);
+    assert(itr != typerInfo.pendingDeclarations.end());
+
+    std::vector<Declaration*> waitingDeclarations = std::move(itr->second);
+    typerInfo.pendingDeclarations.erase(itr);
+
+    for (Declaration* waitingDeclaration : waitingDeclarations)
+    {
+        typerInfo.worklist.push_back(waitingDeclaration);
+    }
+}
+
+void Typer::WaitForDependencies(Module* module, Declaration* declaration)
+{
+    TyperInfo& typerInfo = module->typerInfo;
+
+    // Declarations without pending dependencies can never resolve, they stay pending and get reported by Process
+    for (Declaration* dependency : _context->dependencies)
+    {
+        if (dependency == declaration)
+            continue;
+
+        auto itr = typerInfo.pendingDeclarations.find(dependency);
+        if (itr == typerInfo.pendingDeclarations.end())
+            continue;
+
+        itr->second.push_back(declaration);
+    }
 }
 
-void Typer::EnterScope(Module* module, Scope* scope)
+void Typer::EnterScope(Module* /*module*/, Scope* scope)
 {
-    module->typerInfo.currentScope = scope;
+    _context->currentScope = scope;
 }
 
-void Typer::ExitScope(Module* module)
+void Typer::ExitScope(Module* /*module*/)
 {
-    assert(module->typerInfo.currentScope);
-    module->typerInfo.currentScope = module->typerInfo.currentScope->parent;
+    assert(_context->currentScope);
+    _context->currentScope = _context->currentScope->parent;
 }
 
 bool Typer::IsValidType(Type* type)
@@ -79,9 +239,9 @@ Declaration* Typer::LookupInScope(Scope* scope, u32 nameHash)
     return nullptr;
 }
 
-Declaration* Typer::LookupInCurrentScope(Module* module, u32 nameHash)
+Declaration* Typer::LookupInCurrentScope(Module* /*module*/, u32 nameHash)
 {
-    return LookupInScope(module->typerInfo.currentScope, nameHash);
+    return LookupInScope(_context->currentScope, nameHash);
 }
 
 StructMember* Typer::LookupMemberInStruct(u32 nameHash, Type* type)
@@ -102,14 +262,27 @@ StructMember* Typer::LookupMemberInStruct(u32 nameHash, Type* type)
     return nullptr;
 }
 
-void Typer::ResolvedType(Module* module)
+Declaration* Typer::LookupTypeDeclaration(Module* module, Type* type)
 {
-    module->typerInfo.typeResolved = true;
+    assert(type->kind == Type::Kind::Unknown);
+
+    Declaration* declaration = LookupInCurrentScope(module, type->unknown.token->nameHash.hash);
+    if (!declaration || declaration->kind != Declaration::Kind::Type)
+    {
+        module->lexerInfo.Error(type->unknown.token, "This type is undeclared");
+    }
+
+    return declaration;
 }
 
-void Typer::UnresolvedType(Module* module)
+void Typer::UnresolvedType(Module* /*module*/, Declaration* dependency)
 {
-    module->typerInfo.unresolvedTypes = true;
+    _context->unresolvedTypes = true;
+
+    if (dependency)
+    {
+        _context->dependencies.push_back(dependency);
+    }
 }
 
 u32 Typer::AlignNumber(u32 number, u32 alignment)
@@ -215,7 +388,7 @@ void Typer::TypeScope(Module* module, Scope* scope)
         {
             if (!declaration->function.returnType)
             {
-                declaration->function.returnType = Type::Create(Type::Kind::Void);
+                declaration->function.returnType = Type_Void;
             }
 
             ResolveTypeFunction(module, declaration);
@@ -238,17 +411,23 @@ Type* Typer::ResolveType(Module* module, Type* type)
         }
         case Type::Kind::Pointer:
         {
-            if (type->pointer.type->kind == Type::Kind::Void)
+            Type* pointeeType = type->pointer.type;
+
+            // A pointer only needs to know what it points at, it doesn't have to wait for the struct layout
+            if (pointeeType->kind == Type::Kind::Unknown)
             {
-                type->isResolved = true;
-                return type;
+                pointeeType = LookupTypeDeclaration(module, pointeeType)->type;
+            }
+            else
+            {
+                pointeeType = ResolveType(module, pointeeType);
             }
 
-            type->pointer.type = ResolveType(module, type->pointer.type);
-
-            if (type->pointer.type->isResolved)
-                type->isResolved = true;
+            // Once the pointee is known we swap to the canonical pointer type
+            if (TypeTable::IsCanonical(pointeeType))
+                return TypeTable::GetPointer(pointeeType, type->pointer.count);
 
+            type->pointer.type = pointeeType;
             return type;
         }
 
@@ -270,19 +449,7 @@ Type* Typer::ResolveType(Module* module, Type* type)
 
         case Type::Kind::Function:
         {
-            ListNode* node;
-            ListIterate(&type->function.argumentTypes, node)
-            {
-                Type* argumentType = ListGetStructPtr(node, Type, listNode);
-                Type* newType = ResolveType(module, argumentType);
-
-                newType->listNode.next = argumentType->listNode.next;
-                newType->listNode.prev = argumentType->listNode.prev;
-
-                argumentType->listNode.next->prev = &newType->listNode;
-                argumentType->listNode.prev->next = &newType->listNode;
-            }
-
+            // Function types are interned by ResolveTypeFunctionSignature once the signature is resolved
             return type;
         }
 
@@ -321,24 +488,16 @@ Type* Typer::ResolveTypeStruct(Module* module, Type* type)
 
 Type* Typer::ResolveTypeUnknown(Module* module, Type* type)
 {
-    assert(type->kind == Type::Kind::Unknown);
+    Declaration* declaration = LookupTypeDeclaration(module, type);
 
-    Declaration* declaration = LookupInCurrentScope(module, type->unknown.token->nameHash.hash);
-    if (!declaration || declaration->kind != Declaration::Kind::Type)
-    {
-        module->lexerInfo.Error(type->unknown.token, "This type is undeclared");
-    }
-
-    if (IsValidType(declaration->type))
-    {
-        ResolvedType(module);
-        return declaration->type;
-    }
-    else
+    // The declaration gets re-queued once the type we are waiting on has been resolved
+    if (!declaration->type->isResolved)
     {
-        UnresolvedType(module);
+        UnresolvedType(module, declaration);
         return type;
     }
+
+    return declaration->type;
 }
 
 void Typer::ResolveTypeDeclaration(Module* module, Declaration* declaration)
@@ -356,20 +515,59 @@ void Typer::ResolveTypeDeclaration(Module* module, Declaration* declaration)
 }
 
 void Typer::ResolveTypeFunction(Module* module, Declaration* declaration)
+{
+    ResolveTypeFunctionSignature(module, declaration);
+    ResolveTypeFunctionBody(module, declaration);
+}
+
+void Typer::ResolveTypeFunctionSignature(Module* module, Declaration* declaration)
 {
     assert(declaration->kind == Declaration::Kind::Function);
     Function* function = &declaration->function;
 
     TypeScope(module, function->scope);
     EnterScope(module, function->scope);
-    declaration->type = ResolveType(module, declaration->type);
+
+    Type* returnType = function->returnType;
+    function->returnType = ResolveType(module, function->returnType);
+
+    ExitScope(module);
+
+    // The struct would live in the callee's frame, which is gone by the time the caller reads it
+    if (function->returnType->kind == Type::Kind::Struct && returnType->kind == Type::Kind::Unknown)
+    {
+        module->lexerInfo.Error(returnType->unknown.token, "Structs cannot be returned by value, return a pointer instead");
+    }
+
+    if (declaration->type->isResolved || !function->returnType->isResolved)
+        return;
+
+    std::vector<Type*> argumentTypes;
+
+    ListNode* node;
+    ListIterate(&function->scope->declarations, node)
+    {
+        Declaration* parameter = ListGetStructPtr(node, Declaration, listNode);
+        if (!parameter->type->isResolved)
+            return;
+
+        argumentTypes.push_back(parameter->type);
+    }
+
+    declaration->type = TypeTable::GetFunction(function->returnType, argumentTypes);
+}
+
+void Typer::ResolveTypeFunctionBody(Module* module, Declaration* declaration)
+{
+    assert(declaration->kind == Declaration::Kind::Function);
+    Function* function = &declaration->function;
+
+    EnterScope(module, function->scope);
 
     assert(function->scope != function->body->compound.scope);
     TypeScope(module, function->body->compound.scope);
     ResolveTypeStatement(module, function->body);
 
-    function->returnType = ResolveType(module, function->returnType);
-
     ExitScope(module);
 }
 
@@ -550,23 +748,19 @@ void Typer::ResolveTypeExpressionPrimary(Module* module, Expression* expression)
         if (IsValidType(primary->declaration->type))
         {
             expression->type = primary->declaration->type;
-            ResolvedType(module);
         }
         else
         {
-            UnresolvedType(module);
+            UnresolvedType(module, primary->declaration);
         }
     }
     else if (primary->kind == Primary::Kind::Number)
     {
         expression->type = Type_U64;
-        ResolvedType(module);
     }
     else if (primary->kind == Primary::Kind::String)
     {
-        expression->type = Type::CreatePointer();
-        expression->type->pointer.type = Type_Char;
-        ResolvedType(module);
+        expression->type = TypeTable::GetPointer(Type_Char);
     }
 }
 
@@ -580,16 +774,14 @@ void Typer::ResolveTypeExpressionUnary(Module* module, Expression* expression)
 
     if (!unary->operand->type)
     {
-        UnresolvedType(module);
+        UnresolvedType(module, nullptr);
         return;
     }
 
     if (unary->kind == Unary::Kind::AddressOf)
     {
-        expression->type = Type::CreatePointer();
-        expression->type->pointer.type = unary->operand->type;
+        expression->type = TypeTable::GetPointer(unary->operand->type);
 
-        ResolvedType(module);
     }
     else if (unary->kind == Unary::Kind::Deref)
     {
@@ -606,7 +798,6 @@ void Typer::ResolveTypeExpressionUnary(Module* module, Expression* expression)
         }
 
         expression->type = type->pointer.type;
-        ResolvedType(module);
     }
 }
 
@@ -626,8 +817,15 @@ void Typer::ResolveTypeExpressionBinary(Module* module, Expression* expression)
     if (!leftType || !rightType)
         return;
 
+    // Both sides are only ever tested against zero, pointers included
+    if (binary->kind == Binary::Kind::LogicalAnd ||
+        binary->kind == Binary::Kind::LogicalOr)
+    {
+        expression->type = Type_Bool;
+        return;
+    }
+
     expression->type = binary->left->type;
-    ResolvedType(module);
 
     // Check for pointer arithmetic, if so normalize so the pointer is on the left
     if (binary->kind == Binary::Kind::Add ||
@@ -688,7 +886,7 @@ void Typer::ResolveTypeExpressionCall(Module* module, Expression* expression)
 
     if (!call->expression->type)
     {
-        UnresolvedType(module);
+        UnresolvedType(module, nullptr);
         return;
     }
 
@@ -705,8 +903,14 @@ void Typer::ResolveTypeExpressionCall(Module* module, Expression* expression)
     Declaration* decl = LookupInCurrentScope(module, call->expression->primary.token->nameHash.hash);
     if (decl)
     {
+        // Wait for the callee's signature, it is resolved first thing when the callee gets typed
+        if (!decl->function.returnType->isResolved)
+        {
+            UnresolvedType(module, decl);
+            return;
+        }
+
         expression->type = decl->function.returnType;
-        ResolvedType(module);
     }
     else
     {
@@ -758,7 +962,6 @@ void Typer::ResolveTypeExpressionDot(Module* module, Expression* expression)
 
         dot->offset = member->offset;
         expression->type = member->type;
-        ResolvedType(module);
     }
 }
 
@@ -775,7 +978,7 @@ void Typer::ResolveTypeExpressionMemory(Module* module, Expression* expression)
         // MemoryFree does not return a value
         else
         {
-            expression->type = Type::Create(Type::Kind::Void);
+            expression->type = Type_Void;
         }
     }
 
@@ -787,7 +990,7 @@ void Typer::ResolveTypeExpressionMemory(Module* module, Expression* expression)
 
     if (!memory->expression->type)
     {
-        UnresolvedType(module);
+        UnresolvedType(module, nullptr);
         return;
     }
 
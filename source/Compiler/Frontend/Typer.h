@@ -1,7 +1,9 @@
 #pragma once
 #include "pch/Build.h"
 #include "../Tree.h"
+#include <vector>
 
+extern Type* Type_Void;
 extern Type* Type_Char;
 extern Type* Type_Bool;
 extern Type* Type_U8;
@@ -14,6 +16,7 @@ extern Type* Type_I32;
 extern Type* Type_I64;
 
 struct Module;
+struct TyperContext;
 struct Scope;
 struct Type;
 struct Declaration;
@@ -25,7 +28,15 @@ class Typer
 public:
     static void Process(Module* module);
 
+    // Types a subset of the global declarations, everything else in the global scope must already be typed
+    static void Process(Module* module, const std::vector<Declaration*>& declarations);
+
 private:
+    static void QueueDeclaration(Module* module, Declaration* declaration);
+    static bool TypeDeclaration(Module* module, Declaration* declaration);
+    static void ResolvedDeclaration(Module* module, Declaration* declaration);
+    static void WaitForDependencies(Module* module, Declaration* declaration);
+
     static void EnterScope(Module* module, Scope* scope);
     static void ExitScope(Module* module);
     static bool IsValidType(Type* type);
@@ -33,8 +44,8 @@ private:
     static Declaration* LookupInScope(Scope* scope, u32);
     static Declaration* LookupInCurrentScope(Module* module, u32 nameHash);
     static StructMember* LookupMemberInStruct(u32 nameHash, Type* type);
-    static void ResolvedType(Module* module);
-    static void UnresolvedType(Module* module);
+    static Declaration* LookupTypeDeclaration(Module* module, Type* type);
+    static void UnresolvedType(Module* module, Declaration* dependency);
 
     static u32 AlignNumber(u32 number, u32 alignment);
     static void ComputeStructOffsets(Type* type);
@@ -46,6 +57,8 @@ private:
     static Type* ResolveTypeUnknown(Module* module, Type* type);
     static void ResolveTypeDeclaration(Module* module, Declaration* declaration);
     static void ResolveTypeFunction(Module* module, Declaration* declaration);
+    static void ResolveTypeFunctionSignature(Module* module, Declaration* declaration);
+    static void ResolveTypeFunctionBody(Module* module, Declaration* declaration);
     static void ResolveTypeStatement(Module* module, Statement* statement);
     static void ResolveTypeStatementCompound(Module* module, Statement* statement);
     static void ResolveTypeStatementExpression(Module* module, Statement* statement);
@@ -59,4 +72,8 @@ private:
     static void ResolveTypeExpressionCall(Module* module, Expression* expression);
     static void ResolveTypeExpressionDot(Module* module, Expression* expression);
     static void ResolveTypeExpressionMemory(Module* module, Expression* expression);
+
+private:
+    // Scope and resolution state of the declaration this thread is typing
+    static thread_local TyperContext* _context;
 };
\ No newline at end of file
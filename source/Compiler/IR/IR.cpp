@@ -0,0 +1,281 @@
+#include "pch/Build.h"
+#include "IR.h"
+
+#include <algorithm>
+
+bool IRInstruction::HasValue()
+{
+    switch (kind)
+    {
+        case Kind::Store:
+        case Kind::MemoryFree:
+        case Kind::Jump:
+        case Kind::Branch:
+        case Kind::Return:
+        {
+            return false;
+        }
+        case Kind::Call:
+        {
+            // Calls to void functions
+            return size > 0;
+        }
+
+        default:
+        {
+            return true;
+        }
+    }
+}
+
+bool IRInstruction::HasSideEffects()
+{
+    switch (kind)
+    {
+        case Kind::Store:
+        case Kind::Call:
+        case Kind::MemoryNew:
+        case Kind::MemoryFree:
+        case Kind::Jump:
+        case Kind::Branch:
+        case Kind::Return:
+        {
+            return true;
+        }
+
+        default:
+        {
+            return false;
+        }
+    }
+}
+
+bool IRInstruction::IsTerminator()
+{
+    return kind == Kind::Jump || kind == Kind::Branch || kind == Kind::Return;
+}
+
+bool IRInstruction::IsBinary()
+{
+    return kind >= Kind::Add && kind <= Kind::GreaterEqual;
+}
+
+bool IRInstruction::IsCommutative()
+{
+    return kind == Kind::Add || kind == Kind::Multiply || kind == Kind::Equal || kind == Kind::NotEqual;
+}
+
+bool IRInstruction::IsComparison()
+{
+    return kind >= Kind::Equal && kind <= Kind::GreaterEqual;
+}
+
+IRInstruction* IRInstruction::Resolve()
+{
+    IRInstruction* value = this;
+    while (value->kind == Kind::Copy)
+    {
+        value = value->operands[0];
+    }
+
+    return value;
+}
+
+const char* IRInstruction::GetKindName(Kind kind)
+{
+    switch (kind)
+    {
+        case Kind::None: return "None";
+        case Kind::Constant: return "Constant";
+        case Kind::FrameAddress: return "FrameAddress";
+        case Kind::Parameter: return "Parameter";
+        case Kind::Phi: return "Phi";
+        case Kind::Copy: return "Copy";
+        case Kind::String: return "String";
+        case Kind::Load: return "Load";
+        case Kind::Store: return "Store";
+        case Kind::Add: return "Add";
+        case Kind::Subtract: return "Subtract";
+        case Kind::Multiply: return "Multiply";
+        case Kind::Divide: return "Divide";
+        case Kind::Modulo: return "Modulo";
+        case Kind::Equal: return "Equal";
+        case Kind::NotEqual: return "NotEqual";
+        case Kind::LessThan: return "LessThan";
+        case Kind::LessEqual: return "LessEqual";
+        case Kind::GreaterThan: return "GreaterThan";
+        case Kind::GreaterEqual: return "GreaterEqual";
+        case Kind::Call: return "Call";
+        case Kind::MemoryNew: return "MemoryNew";
+        case Kind::MemoryFree: return "MemoryFree";
+        case Kind::Jump: return "Jump";
+        case Kind::Branch: return "Branch";
+        case Kind::Return: return "Return";
+
+        default: return "Invalid";
+    }
+}
+
+IRInstruction* IRBlock::GetTerminator()
+{
+    if (instructions.size() == 0)
+        return nullptr;
+
+    IRInstruction* instruction = instructions.back();
+    if (!instruction->IsTerminator())
+        return nullptr;
+
+    return instruction;
+}
+
+u32 IRBlock::GetSuccessors(IRBlock* successors[2])
+{
+    IRInstruction* terminator = GetTerminator();
+    if (!terminator)
+        return 0;
+
+    switch (terminator->kind)
+    {
+        case IRInstruction::Kind::Jump:
+        {
+            successors[0] = terminator->targets[0];
+            return 1;
+        }
+        case IRInstruction::Kind::Branch:
+        {
+            successors[0] = terminator->targets[0];
+            successors[1] = terminator->targets[1];
+            return 2;
+        }
+
+        default:
+        {
+            return 0;
+        }
+    }
+}
+
+u32 IRBlock::GetPredecessorIndex(IRBlock* predecessor)
+{
+    auto itr = std::find(predecessors.begin(), predecessors.end(), predecessor);
+    assert(itr != predecessors.end());
+
+    return static_cast<u32>(itr - predecessors.begin());
+}
+
+void IRBlock::RemovePredecessor(IRBlock* predecessor)
+{
+    u32 index = GetPredecessorIndex(predecessor);
+    predecessors.erase(predecessors.begin() + index);
+
+    for (IRInstruction* instruction : instructions)
+    {
+        if (instruction->kind != IRInstruction::Kind::Phi)
+            break;
+
+        instruction->operands.erase(instruction->operands.begin() + index);
+    }
+}
+
+void IRBlock::ReplacePhi(IRInstruction* phi, IRInstruction* value)
+{
+    assert(phi->kind == IRInstruction::Kind::Phi && phi->block == this);
+
+    phi->kind = IRInstruction::Kind::Copy;
+    phi->operands.clear();
+    phi->operands.push_back(value);
+
+    instructions.erase(std::find(instructions.begin(), instructions.end(), phi));
+
+    auto itr = instructions.begin();
+    while (itr != instructions.end() && (*itr)->kind == IRInstruction::Kind::Phi)
+    {
+        ++itr;
+    }
+
+    instructions.insert(itr, phi);
+}
+
+void IRBlock::InsertBeforeTerminator(IRInstruction* instruction)
+{
+    assert(GetTerminator());
+
+    instruction->block = this;
+    instructions.insert(instructions.end() - 1, instruction);
+}
+
+IRFunction::~IRFunction()
+{
+    for (IRBlock* block : blocks)
+    {
+        delete block;
+    }
+
+    for (IRInstruction* instruction : _instructions)
+    {
+        delete instruction;
+    }
+}
+
+IRBlock* IRFunction::CreateBlock()
+{
+    IRBlock* block = new IRBlock();
+    block->id = _numBlocks++;
+
+    blocks.push_back(block);
+    return block;
+}
+
+IRInstruction* IRFunction::CreateInstruction(IRInstruction::Kind kind, u8 size)
+{
+    IRInstruction* instruction = new IRInstruction();
+    instruction->kind = kind;
+    instruction->id = numInstructions++;
+    instruction->size = size;
+
+    _instructions.push_back(instruction);
+    return instruction;
+}
+
+IRInstruction* IRFunction::CreateConstant(u64 number)
+{
+    IRInstruction* instruction = CreateInstruction(IRInstruction::Kind::Constant, 8);
+    instruction->number = number;
+
+    return instruction;
+}
+
+IRInstruction* IRFunction::CreateFrameAddress(Declaration* inDeclaration)
+{
+    IRInstruction* instruction = CreateInstruction(IRInstruction::Kind::FrameAddress, 8);
+    instruction->declaration = inDeclaration;
+    instruction->isPointer = true;
+
+    return instruction;
+}
+
+void IRFunction::RemoveBlock(IRBlock* block)
+{
+    IRBlock* successors[2];
+    u32 numSuccessors = block->GetSuccessors(successors);
+
+    // A Branch targeting the same block twice is in its predecessors twice, so every edge removes one
+    for (u32 i = 0; i < numSuccessors; i++)
+    {
+        successors[i]->RemovePredecessor(block);
+    }
+
+    blocks.erase(std::find(blocks.begin(), blocks.end(), block));
+    delete block;
+}
+
+u32 IRFunction::GetNumInstructionsInBlocks()
+{
+    u32 count = 0;
+    for (IRBlock* block : blocks)
+    {
+        count += static_cast<u32>(block->instructions.size());
+    }
+
+    return count;
+}
@@ -0,0 +1,151 @@
+#pragma once
+#include "pch/Build.h"
+#include <vector>
+
+struct Declaration;
+struct IRBlock;
+
+// A single SSA value, every instruction defines at most one value and is never reassigned
+struct IRInstruction
+{
+public:
+    enum class Kind : u8
+    {
+        None,
+
+        // Values without a block, Bytecode materializes them at every use
+        Constant,
+        FrameAddress,
+
+        Parameter,
+        Phi,
+        Copy,
+        String,
+
+        Load,
+        Store,
+
+        Add,
+        Subtract,
+        Multiply,
+        Divide,
+        Modulo,
+        Equal,
+        NotEqual,
+        LessThan,
+        LessEqual,
+        GreaterThan,
+        GreaterEqual,
+
+        Call,
+        MemoryNew,
+        MemoryFree,
+
+        // Terminators, every block ends with exactly one of these
+        Jump,
+        Branch,
+        Return,
+
+        Count
+    };
+
+    Kind kind = Kind::None;
+    u32 id = 0;
+
+    // Width in bytes the instruction operates at, binary instructions use the width of their left operand like Bytecode does
+    u8 size = 0;
+    bool isPointer = false;
+
+    IRBlock* block = nullptr;
+
+    // Phi operands line up with the predecessors of their block
+    std::vector<IRInstruction*> operands;
+
+    // Constant value, the parameter index or the element size of MemoryNew
+    u64 number = 0;
+    u32 callHash = 0;
+
+    Declaration* declaration = nullptr;
+    String* string = nullptr;
+
+    // Jump uses the first target, Branch goes to the first when the condition is non zero
+    IRBlock* targets[2] = { nullptr, nullptr };
+
+    // Frame offset handed out by Bytecode when lowering, only for values that didn't get a register
+    i32 slot = 0;
+
+public:
+    bool HasValue();
+    bool HasSideEffects();
+    bool IsTerminator();
+    bool IsBinary();
+    bool IsCommutative();
+
+    // Lowered to a compare, which also leaves its result in the compare flag
+    bool IsComparison();
+
+    // Follows Copy instructions back to the value they copy
+    IRInstruction* Resolve();
+
+    static const char* GetKindName(Kind kind);
+};
+
+struct IRBlock
+{
+public:
+    u32 id = 0;
+
+    // Phis always come first
+    std::vector<IRInstruction*> instructions;
+    std::vector<IRBlock*> predecessors;
+
+    // Analysis state, only valid after IRPasses::ComputeDominators
+    IRBlock* immediateDominator = nullptr;
+    u32 order = 0;
+    bool isReachable = false;
+
+    // Set by Bytecode when lowering
+    u32 address = 0;
+
+public:
+    IRInstruction* GetTerminator();
+    u32 GetSuccessors(IRBlock* successors[2]);
+    u32 GetPredecessorIndex(IRBlock* predecessor);
+
+    void RemovePredecessor(IRBlock* predecessor);
+    void InsertBeforeTerminator(IRInstruction* instruction);
+
+    // Turns a Phi that always has the same value into a Copy of it, moved past the remaining Phis
+    void ReplacePhi(IRInstruction* phi, IRInstruction* value);
+};
+
+struct IRFunction
+{
+public:
+    IRFunction(Declaration* inDeclaration) : declaration(inDeclaration) { }
+    ~IRFunction();
+
+    IRFunction(const IRFunction&) = delete;
+    IRFunction& operator=(const IRFunction&) = delete;
+
+    Declaration* declaration = nullptr;
+
+    // The first block is the entry, it has no predecessors
+    std::vector<IRBlock*> blocks;
+    u32 numInstructions = 0;
+
+public:
+    IRBlock* CreateBlock();
+    IRInstruction* CreateInstruction(IRInstruction::Kind kind, u8 size);
+    IRInstruction* CreateConstant(u64 number);
+    IRInstruction* CreateFrameAddress(Declaration* declaration);
+
+    void RemoveBlock(IRBlock* block);
+    u32 GetNumInstructionsInBlocks();
+
+private:
+    u32 _numBlocks = 0;
+
+    // Owns every instruction, including the ones no longer in a block
+    std::vector<IRInstruction*> _instructions;
+};
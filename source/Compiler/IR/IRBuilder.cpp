@@ -0,0 +1,865 @@
+#include "pch/Build.h"
+#include "IRBuilder.h"
+#include "../Module.h"
+
+thread_local IRBuilderContext* IRBuilder::_context = nullptr;
+
+IRFunction* IRBuilder::Build(Module* module, Declaration* declaration)
+{
+    Function* function = &declaration->function;
+    assert(function->body);
+
+    IRBuilderContext context;
+    _context = &context;
+
+    context.function = new IRFunction(declaration);
+
+    CollectAddressTaken(function->body);
+
+    // The entry block has no predecessors, so it is sealed from the start
+    context.currentBlock = CreateBlock();
+    SealBlock(context.currentBlock);
+
+    BuildParameters(function);
+    BuildStatement(module, function->body);
+
+    // Falling off the end of the function returns like Bytecode's cleanup does
+    EmitReturn(nullptr);
+
+    // The block opened after the final return is the only one without a terminator
+    context.function->RemoveBlock(context.currentBlock);
+    _context = nullptr;
+
+    if (!context.isSupported)
+    {
+        delete context.function;
+        return nullptr;
+    }
+
+    return context.function;
+}
+
+void IRBuilder::CollectAddressTaken(Statement* statement)
+{
+    switch (statement->kind)
+    {
+        case Statement::Kind::Compound:
+        {
+            ListNode* node;
+            ListIterate(&statement->compound.statements, node)
+            {
+                Statement* stmt = ListGetStructPtr(node, Statement, listNode);
+                CollectAddressTaken(stmt);
+            }
+            break;
+        }
+        case Statement::Kind::Expression:
+        {
+            CollectAddressTakenExpression(statement->expression);
+            break;
+        }
+        case Statement::Kind::Return:
+        {
+            if (statement->returnStmt.expression)
+            {
+                CollectAddressTakenExpression(statement->returnStmt.expression);
+            }
+            break;
+        }
+        case Statement::Kind::Conditional:
+        {
+            Conditional* conditional = &statement->conditional;
+
+            CollectAddressTakenExpression(conditional->condition);
+            CollectAddressTaken(conditional->trueBody);
+
+            if (conditional->falseBody)
+            {
+                CollectAddressTaken(conditional->falseBody);
+            }
+            break;
+        }
+        case Statement::Kind::Loop:
+        {
+            CollectAddressTakenExpression(statement->loop.condition);
+            CollectAddressTaken(statement->loop.body);
+            break;
+        }
+
+        default:
+        {
+            break;
+        }
+    }
+}
+
+void IRBuilder::CollectAddressTakenExpression(Expression* expression)
+{
+    switch (expression->kind)
+    {
+        case Expression::Kind::Unary:
+        {
+            if (expression->unary.kind == Unary::Kind::AddressOf)
+            {
+                MarkAddressTaken(expression->unary.operand);
+            }
+
+            CollectAddressTakenExpression(expression->unary.operand);
+            break;
+        }
+        case Expression::Kind::Binary:
+        {
+            CollectAddressTakenExpression(expression->binary.left);
+            CollectAddressTakenExpression(expression->binary.right);
+            break;
+        }
+        case Expression::Kind::Call:
+        {
+            ListNode* node;
+            ListIterate(&expression->call.arguments, node)
+            {
+                Expression* argument = ListGetStructPtr(node, Expression, listNode);
+                CollectAddressTakenExpression(argument);
+            }
+            break;
+        }
+        case Expression::Kind::Dot:
+        {
+            MarkAddressTaken(expression->dot.expression);
+            CollectAddressTakenExpression(expression->dot.expression);
+            break;
+        }
+        case Expression::Kind::MemoryNew:
+        case Expression::Kind::MemoryFree:
+        {
+            CollectAddressTakenExpression(expression->memory.expression);
+            break;
+        }
+
+        default:
+        {
+            break;
+        }
+    }
+}
+
+void IRBuilder::MarkAddressTaken(Expression* expression)
+{
+    while (expression->kind == Expression::Kind::Dot)
+    {
+        expression = expression->dot.expression;
+    }
+
+    if (expression->kind == Expression::Kind::Primary && expression->primary.kind == Primary::Kind::Identifier)
+    {
+        _context->addressTaken[expression->primary.declaration] = true;
+    }
+}
+
+bool IRBuilder::IsRegisterVariable(Declaration* declaration)
+{
+    if (declaration->kind != Declaration::Kind::Variable || !IsScalar(declaration->type))
+        return false;
+
+    return _context->addressTaken.find(declaration) == _context->addressTaken.end();
+}
+
+bool IRBuilder::IsScalar(Type* type)
+{
+    // Arrays live in the frame and have no value of their own
+    if (type->kind == Type::Kind::Pointer)
+        return type->pointer.count == 0;
+
+    return type->kind == Type::Kind::Basic && type->size >= 1 && type->size <= 8;
+}
+
+void IRBuilder::BuildParameters(Function* function)
+{
+    u64 parameterIndex = 0;
+
+    ListNode* node;
+    ListIterate(&function->scope->declarations, node)
+    {
+        Declaration* declaration = ListGetStructPtr(node, Declaration, listNode);
+        if (declaration->kind != Declaration::Kind::Variable)
+            continue;
+
+        u64 index = parameterIndex++;
+        Type* type = declaration->type;
+
+        if (!IsScalar(type))
+        {
+            Unsupported();
+            return;
+        }
+
+        // Parameters past the fourth are passed on the stack, they already have an address in our frame
+        if (!IsRegisterVariable(declaration) && index >= 4)
+            continue;
+
+        IRInstruction* parameter = Emit(IRInstruction::Kind::Parameter, static_cast<u8>(type->size));
+        parameter->number = index;
+        parameter->declaration = declaration;
+        parameter->isPointer = type->IsPointer();
+
+        if (IsRegisterVariable(declaration))
+        {
+            WriteVariable(declaration, _context->currentBlock, parameter);
+        }
+        else
+        {
+            // Passed in a register but its address is taken, so it needs a home in the frame
+            IRInstruction* store = Emit(IRInstruction::Kind::Store, static_cast<u8>(type->size));
+            store->operands.push_back(_context->function->CreateFrameAddress(declaration));
+            store->operands.push_back(parameter);
+            store->isPointer = type->IsPointer();
+        }
+    }
+}
+
+void IRBuilder::BuildStatement(Module* module, Statement* statement)
+{
+    switch (statement->kind)
+    {
+        case Statement::Kind::Compound:
+        {
+            ListNode* node;
+            ListIterate(&statement->compound.statements, node)
+            {
+                Statement* stmt = ListGetStructPtr(node, Statement, listNode);
+                BuildStatement(module, stmt);
+            }
+            break;
+        }
+        case Statement::Kind::Comment:
+        {
+            break;
+        }
+        case Statement::Kind::Expression:
+        {
+            BuildExpression(module, statement->expression);
+            break;
+        }
+        case Statement::Kind::Return:
+        {
+            IRInstruction* value = nullptr;
+            if (statement->returnStmt.expression)
+            {
+                value = BuildExpression(module, statement->returnStmt.expression);
+            }
+
+            EmitReturn(value);
+            break;
+        }
+        case Statement::Kind::Conditional:
+        {
+            BuildConditional(module, &statement->conditional);
+            break;
+        }
+        case Statement::Kind::Loop:
+        {
+            BuildLoop(module, &statement->loop);
+            break;
+        }
+        case Statement::Kind::Continue:
+        {
+            assert(_context->continueBlocks.size());
+            EmitJump(_context->continueBlocks.back());
+            break;
+        }
+        case Statement::Kind::Break:
+        {
+            assert(_context->breakBlocks.size());
+            EmitJump(_context->breakBlocks.back());
+            break;
+        }
+
+        default:
+        {
+            Unsupported();
+            break;
+        }
+    }
+}
+
+void IRBuilder::BuildConditional(Module* module, Conditional* conditional)
+{
+    // Same as Bytecode, a condition the Folder reduced to a number only builds the body that would run
+    Expression* condition = conditional->condition;
+    if (condition->kind == Expression::Kind::Primary && condition->primary.kind == Primary::Kind::Number)
+    {
+        if (condition->primary.number)
+        {
+            BuildStatement(module, conditional->trueBody);
+        }
+        else if (conditional->falseBody)
+        {
+            BuildStatement(module, conditional->falseBody);
+        }
+
+        return;
+    }
+
+    IRBlock* trueBlock = CreateBlock();
+    IRBlock* falseBlock = conditional->falseBody ? CreateBlock() : nullptr;
+    IRBlock* endBlock = CreateBlock();
+
+    BuildBranch(module, condition, trueBlock, falseBlock ? falseBlock : endBlock);
+
+    SealBlock(trueBlock);
+    _context->currentBlock = trueBlock;
+    BuildStatement(module, conditional->trueBody);
+    EmitJump(endBlock);
+
+    if (falseBlock)
+    {
+        SealBlock(falseBlock);
+        _context->currentBlock = falseBlock;
+        BuildStatement(module, conditional->falseBody);
+        EmitJump(endBlock);
+    }
+
+    SealBlock(endBlock);
+    _context->currentBlock = endBlock;
+}
+
+void IRBuilder::BuildLoop(Module* module, Loop* loop)
+{
+    // The header can't be sealed until the body is built, continues and the end of the body jump back to it
+    IRBlock* headerBlock = CreateBlock();
+    IRBlock* bodyBlock = CreateBlock();
+    IRBlock* endBlock = CreateBlock();
+
+    EmitJump(headerBlock);
+    _context->currentBlock = headerBlock;
+
+    Expression* condition = loop->condition;
+    bool isAlwaysTrue = condition->kind == Expression::Kind::Primary && condition->primary.kind == Primary::Kind::Number && condition->primary.number;
+
+    if (isAlwaysTrue)
+    {
+        EmitJump(bodyBlock);
+    }
+    else
+    {
+        BuildBranch(module, condition, bodyBlock, endBlock);
+    }
+
+    SealBlock(bodyBlock);
+    _context->currentBlock = bodyBlock;
+
+    _context->continueBlocks.push_back(headerBlock);
+    _context->breakBlocks.push_back(endBlock);
+    {
+        BuildStatement(module, loop->body);
+        EmitJump(headerBlock);
+    }
+    _context->continueBlocks.pop_back();
+    _context->breakBlocks.pop_back();
+
+    SealBlock(headerBlock);
+    SealBlock(endBlock);
+    _context->currentBlock = endBlock;
+}
+
+void IRBuilder::BuildBranch(Module* module, Expression* condition, IRBlock* onTrue, IRBlock* onFalse)
+{
+    if (condition->kind == Expression::Kind::Binary && (condition->binary.kind == Binary::Kind::LogicalAnd || condition->binary.kind == Binary::Kind::LogicalOr))
+    {
+        Binary* binary = &condition->binary;
+
+        // The right hand side is only reached when the left one doesn't decide the result
+        IRBlock* rightBlock = CreateBlock();
+        if (binary->kind == Binary::Kind::LogicalAnd)
+        {
+            BuildBranch(module, binary->left, rightBlock, onFalse);
+        }
+        else
+        {
+            BuildBranch(module, binary->left, onTrue, rightBlock);
+        }
+
+        SealBlock(rightBlock);
+        _context->currentBlock = rightBlock;
+
+        BuildBranch(module, binary->right, onTrue, onFalse);
+        return;
+    }
+
+    IRInstruction* value = BuildExpression(module, condition);
+    EmitBranch(value, static_cast<u8>(condition->type->size), onTrue, onFalse);
+}
+
+IRInstruction* IRBuilder::BuildExpression(Module* module, Expression* expression)
+{
+    switch (expression->kind)
+    {
+        case Expression::Kind::Primary:
+        {
+            return BuildExpressionPrimary(module, expression);
+        }
+        case Expression::Kind::Unary:
+        {
+            return BuildExpressionUnary(module, expression);
+        }
+        case Expression::Kind::Binary:
+        {
+            return BuildExpressionBinary(module, expression);
+        }
+        case Expression::Kind::Call:
+        {
+            return BuildExpressionCall(module, expression);
+        }
+        case Expression::Kind::MemoryNew:
+        {
+            return BuildExpressionMemoryNew(module, expression, 1);
+        }
+        case Expression::Kind::MemoryFree:
+        {
+            IRInstruction* address = BuildExpression(module, expression->memory.expression);
+
+            IRInstruction* memoryFree = Emit(IRInstruction::Kind::MemoryFree, 0);
+            memoryFree->operands.push_back(address);
+            return memoryFree;
+        }
+        case Expression::Kind::Dot:
+        {
+            IRInstruction* address = BuildAddress(module, expression);
+            return BuildLoad(address, expression->type);
+        }
+
+        default:
+        {
+            return Unsupported();
+        }
+    }
+}
+
+IRInstruction* IRBuilder::BuildExpressionPrimary(Module* /*module*/, Expression* expression)
+{
+    Primary* primary = &expression->primary;
+
+    switch (primary->kind)
+    {
+        case Primary::Kind::Number:
+        {
+            return _context->function->CreateConstant(primary->number);
+        }
+        case Primary::Kind::Identifier:
+        {
+            Declaration* declaration = primary->declaration;
+            if (declaration->kind != Declaration::Kind::Variable)
+                return Unsupported();
+
+            if (IsRegisterVariable(declaration))
+                return ReadVariable(declaration, _context->currentBlock);
+
+            return BuildLoad(_context->function->CreateFrameAddress(declaration), declaration->type);
+        }
+        case Primary::Kind::String:
+        {
+            IRInstruction* string = Emit(IRInstruction::Kind::String, 8);
+            string->string = primary->string;
+            string->isPointer = true;
+            return string;
+        }
+
+        default:
+        {
+            return Unsupported();
+        }
+    }
+}
+
+IRInstruction* IRBuilder::BuildExpressionUnary(Module* module, Expression* expression)
+{
+    Unary* unary = &expression->unary;
+
+    switch (unary->kind)
+    {
+        case Unary::Kind::Deref:
+        {
+            IRInstruction* address = BuildExpression(module, unary->operand);
+            return BuildLoad(address, expression->type);
+        }
+        case Unary::Kind::AddressOf:
+        {
+            return BuildAddress(module, unary->operand);
+        }
+
+        default:
+        {
+            return Unsupported();
+        }
+    }
+}
+
+IRInstruction* IRBuilder::BuildExpressionBinary(Module* module, Expression* expression)
+{
+    Binary* binary = &expression->binary;
+
+    if (binary->kind == Binary::Kind::LogicalAnd || binary->kind == Binary::Kind::LogicalOr)
+        return BuildExpressionLogical(module, expression);
+
+    if (binary->kind == Binary::Kind::Assign)
+    {
+        Type* type = binary->left->type;
+        if (!IsScalar(type))
+            return Unsupported();
+
+        // Bytecode reports 'New' assigned to anything but a single pointer, so leave those to it
+        if (binary->right->kind == Expression::Kind::MemoryNew && (!type->IsPointer() || type->pointer.type->IsPointer()))
+            return Unsupported();
+
+        bool isRegisterVariable = binary->left->kind == Expression::Kind::Primary && binary->left->primary.kind == Primary::Kind::Identifier && IsRegisterVariable(binary->left->primary.declaration);
+
+        // The address is evaluated before the value, in the same order Bytecode does
+        IRInstruction* address = nullptr;
+        if (!isRegisterVariable)
+        {
+            address = BuildAddress(module, binary->left);
+        }
+
+        IRInstruction* value = nullptr;
+        if (binary->right->kind == Expression::Kind::MemoryNew)
+        {
+            value = BuildExpressionMemoryNew(module, binary->right, type->pointer.type->size);
+        }
+        else
+        {
+            value = BuildExpression(module, binary->right);
+        }
+
+        if (isRegisterVariable)
+        {
+            WriteVariable(binary->left->primary.declaration, _context->currentBlock, value);
+        }
+        else
+        {
+            IRInstruction* store = Emit(IRInstruction::Kind::Store, static_cast<u8>(type->size));
+            store->operands.push_back(address);
+            store->operands.push_back(value);
+            store->isPointer = type->IsPointer();
+        }
+
+        return value;
+    }
+
+    if (binary->left->kind == Expression::Kind::MemoryNew || binary->right->kind == Expression::Kind::MemoryNew)
+        return Unsupported();
+
+    IRInstruction::Kind kind = IRInstruction::Kind::None;
+    switch (binary->kind)
+    {
+        case Binary::Kind::Add: kind = IRInstruction::Kind::Add; break;
+        case Binary::Kind::Subtract: kind = IRInstruction::Kind::Subtract; break;
+        case Binary::Kind::Multiply: kind = IRInstruction::Kind::Multiply; break;
+        case Binary::Kind::Divide: kind = IRInstruction::Kind::Divide; break;
+        case Binary::Kind::Modulo: kind = IRInstruction::Kind::Modulo; break;
+        case Binary::Kind::Equal: kind = IRInstruction::Kind::Equal; break;
+        case Binary::Kind::NotEqual: kind = IRInstruction::Kind::NotEqual; break;
+        case Binary::Kind::LessThan: kind = IRInstruction::Kind::LessThan; break;
+        case Binary::Kind::LessEqual: kind = IRInstruction::Kind::LessEqual; break;
+        case Binary::Kind::GreaterThan: kind = IRInstruction::Kind::GreaterThan; break;
+        case Binary::Kind::GreaterEqual: kind = IRInstruction::Kind::GreaterEqual; break;
+
+        default:
+        {
+            return Unsupported();
+        }
+    }
+
+    // Right before left, calls on either side have to run in the order Bytecode runs them
+    IRInstruction* right = BuildExpression(module, binary->right);
+    IRInstruction* left = BuildExpression(module, binary->left);
+
+    IRInstruction* instruction = Emit(kind, static_cast<u8>(binary->left->type->size));
+    instruction->operands.push_back(left);
+    instruction->operands.push_back(right);
+    return instruction;
+}
+
+IRInstruction* IRBuilder::BuildExpressionLogical(Module* module, Expression* expression)
+{
+    // Used as a value, both outcomes of the branch meet in a Phi of 1 and 0
+    IRBlock* trueBlock = CreateBlock();
+    IRBlock* falseBlock = CreateBlock();
+    IRBlock* endBlock = CreateBlock();
+
+    BuildBranch(module, expression, trueBlock, falseBlock);
+
+    SealBlock(trueBlock);
+    _context->currentBlock = trueBlock;
+    EmitJump(endBlock);
+
+    SealBlock(falseBlock);
+    _context->currentBlock = falseBlock;
+    EmitJump(endBlock);
+
+    SealBlock(endBlock);
+    _context->currentBlock = endBlock;
+
+    IRInstruction* phi = _context->function->CreateInstruction(IRInstruction::Kind::Phi, static_cast<u8>(expression->type->size));
+    phi->block = endBlock;
+    phi->operands.push_back(_context->function->CreateConstant(1));
+    phi->operands.push_back(_context->function->CreateConstant(0));
+
+    endBlock->instructions.insert(endBlock->instructions.begin(), phi);
+    return phi;
+}
+
+IRInstruction* IRBuilder::BuildExpressionCall(Module* module, Expression* expression)
+{
+    Call* call = &expression->call;
+
+    u32 numArguments = 0;
+
+    ListNode* node;
+    ListIterate(&call->arguments, node)
+    {
+        numArguments++;
+    }
+
+    // Arguments are evaluated last to first, like Bytecode does
+    std::vector<IRInstruction*> arguments(numArguments);
+
+    ListIterateReverse(&call->arguments, node)
+    {
+        Expression* argument = ListGetStructPtr(node, Expression, listNode);
+        arguments[--numArguments] = BuildExpression(module, argument);
+    }
+
+    Type* type = expression->type;
+
+    u8 size = 0;
+    if (type && type->kind != Type::Kind::Void)
+    {
+        if (!IsScalar(type))
+            return Unsupported();
+
+        size = static_cast<u8>(type->size);
+    }
+
+    IRInstruction* instruction = Emit(IRInstruction::Kind::Call, size);
+    instruction->operands = std::move(arguments);
+    instruction->callHash = call->token->nameHash.hash;
+    instruction->isPointer = size > 0 && type->IsPointer();
+    return instruction;
+}
+
+IRInstruction* IRBuilder::BuildExpressionMemoryNew(Module* module, Expression* expression, u64 typeSize)
+{
+    IRInstruction* count = BuildExpression(module, expression->memory.expression);
+
+    IRInstruction* instruction = Emit(IRInstruction::Kind::MemoryNew, 8);
+    instruction->operands.push_back(count);
+    instruction->number = typeSize;
+    instruction->isPointer = true;
+    return instruction;
+}
+
+IRInstruction* IRBuilder::BuildAddress(Module* module, Expression* expression)
+{
+    if (expression->kind == Expression::Kind::Primary && expression->primary.kind == Primary::Kind::Identifier)
+    {
+        Declaration* declaration = expression->primary.declaration;
+
+        // Anything that needs an address was kept out of SSA by CollectAddressTaken
+        if (declaration->kind != Declaration::Kind::Variable || IsRegisterVariable(declaration))
+            return Unsupported();
+
+        return _context->function->CreateFrameAddress(declaration);
+    }
+    else if (expression->kind == Expression::Kind::Unary && expression->unary.kind == Unary::Kind::Deref)
+    {
+        return BuildExpression(module, expression->unary.operand);
+    }
+    else if (expression->kind == Expression::Kind::Dot)
+    {
+        IRInstruction* base = BuildAddress(module, expression->dot.expression);
+
+        IRInstruction* address = Emit(IRInstruction::Kind::Add, 8);
+        address->operands.push_back(base);
+        address->operands.push_back(_context->function->CreateConstant(expression->dot.offset));
+        address->isPointer = true;
+        return address;
+    }
+
+    return Unsupported();
+}
+
+IRInstruction* IRBuilder::BuildLoad(IRInstruction* address, Type* type)
+{
+    if (!IsScalar(type))
+        return Unsupported();
+
+    IRInstruction* load = Emit(IRInstruction::Kind::Load, static_cast<u8>(type->size));
+    load->operands.push_back(address);
+    load->isPointer = type->IsPointer();
+    return load;
+}
+
+void IRBuilder::WriteVariable(Declaration* declaration, IRBlock* block, IRInstruction* value)
+{
+    _context->definitions[block->id][declaration] = value;
+}
+
+IRInstruction* IRBuilder::ReadVariable(Declaration* declaration, IRBlock* block)
+{
+    robin_hood::unordered_map<Declaration*, IRInstruction*>& definitions = _context->definitions[block->id];
+
+    auto itr = definitions.find(declaration);
+    if (itr != definitions.end())
+        return itr->second;
+
+    return ReadVariableRecursive(declaration, block);
+}
+
+IRInstruction* IRBuilder::ReadVariableRecursive(Declaration* declaration, IRBlock* block)
+{
+    IRInstruction* value = nullptr;
+
+    if (!_context->isSealed[block->id])
+    {
+        // Not every predecessor is known yet, the operands are filled in when the block is sealed
+        value = _context->function->CreateInstruction(IRInstruction::Kind::Phi, 8);
+        value->block = block;
+        block->instructions.insert(block->instructions.begin(), value);
+
+        _context->incompletePhis[block->id].push_back({ declaration, value });
+    }
+    else if (block->predecessors.size() == 1)
+    {
+        value = ReadVariable(declaration, block->predecessors[0]);
+    }
+    else if (block->predecessors.size() == 0)
+    {
+        // Read before anything was assigned, frame memory would have held whatever was there before
+        value = _context->function->CreateConstant(0);
+    }
+    else
+    {
+        // Written first to break cycles through loops
+        IRInstruction* phi = _context->function->CreateInstruction(IRInstruction::Kind::Phi, 8);
+        phi->block = block;
+        block->instructions.insert(block->instructions.begin(), phi);
+
+        WriteVariable(declaration, block, phi);
+        value = AddPhiOperands(declaration, phi);
+    }
+
+    WriteVariable(declaration, block, value);
+    return value;
+}
+
+IRInstruction* IRBuilder::AddPhiOperands(Declaration* declaration, IRInstruction* phi)
+{
+    for (IRBlock* predecessor : phi->block->predecessors)
+    {
+        phi->operands.push_back(ReadVariable(declaration, predecessor));
+    }
+
+    return TryRemoveTrivialPhi(phi);
+}
+
+IRInstruction* IRBuilder::TryRemoveTrivialPhi(IRInstruction* phi)
+{
+    IRInstruction* same = nullptr;
+
+    for (IRInstruction* operand : phi->operands)
+    {
+        operand = operand->Resolve();
+
+        if (operand == same || operand == phi)
+            continue;
+
+        // Merges at least two different values
+        if (same)
+            return phi;
+
+        same = operand;
+    }
+
+    // Only ever reaches itself, which means the variable is read before it is assigned
+    if (!same)
+    {
+        same = _context->function->CreateConstant(0);
+    }
+
+    // Phis that used this one may have become trivial too, IRPasses::CopyPropagation finds those
+    phi->block->ReplacePhi(phi, same);
+    return same;
+}
+
+void IRBuilder::SealBlock(IRBlock* block)
+{
+    for (auto& incompletePhi : _context->incompletePhis[block->id])
+    {
+        AddPhiOperands(incompletePhi.first, incompletePhi.second);
+    }
+
+    _context->incompletePhis[block->id].clear();
+    _context->isSealed[block->id] = true;
+}
+
+IRBlock* IRBuilder::CreateBlock()
+{
+    IRBlock* block = _context->function->CreateBlock();
+
+    _context->definitions.emplace_back();
+    _context->incompletePhis.emplace_back();
+    _context->isSealed.push_back(false);
+
+    return block;
+}
+
+IRInstruction* IRBuilder::Emit(IRInstruction::Kind kind, u8 size)
+{
+    IRInstruction* instruction = _context->function->CreateInstruction(kind, size);
+    instruction->block = _context->currentBlock;
+
+    _context->currentBlock->instructions.push_back(instruction);
+    return instruction;
+}
+
+void IRBuilder::EmitJump(IRBlock* target)
+{
+    IRInstruction* jump = Emit(IRInstruction::Kind::Jump, 0);
+    jump->targets[0] = target;
+    target->predecessors.push_back(_context->currentBlock);
+
+    // Anything after a jump is unreachable, it still gets a block so it can be built and then removed
+    _context->currentBlock = CreateBlock();
+    SealBlock(_context->currentBlock);
+}
+
+void IRBuilder::EmitBranch(IRInstruction* condition, u8 size, IRBlock* onTrue, IRBlock* onFalse)
+{
+    IRInstruction* branch = Emit(IRInstruction::Kind::Branch, size);
+    branch->operands.push_back(condition);
+    branch->targets[0] = onTrue;
+    branch->targets[1] = onFalse;
+
+    onTrue->predecessors.push_back(_context->currentBlock);
+    onFalse->predecessors.push_back(_context->currentBlock);
+}
+
+void IRBuilder::EmitReturn(IRInstruction* value)
+{
+    IRInstruction* ret = Emit(IRInstruction::Kind::Return, 0);
+    if (value)
+    {
+        ret->operands.push_back(value);
+    }
+
+    _context->currentBlock = CreateBlock();
+    SealBlock(_context->currentBlock);
+}
+
+IRInstruction* IRBuilder::Unsupported()
+{
+    _context->isSupported = false;
+
+    // Keeps the build going, the result is thrown away
+    return _context->function->CreateConstant(0);
+}
@@ -0,0 +1,59 @@
+#pragma once
+#include "pch/Build.h"
+#include "IR.h"
+#include "../Tree.h"
+
+struct Module;
+struct IRBuilderContext;
+
+// Lowers a typed function tree into SSA form, using the construction from Braun et al. "Simple and Efficient Construction of Static Single Assignment Form"
+// Locals are renamed on the fly while the tree is walked, so no dominance frontiers are needed
+class IRBuilder
+{
+public:
+    // Returns nullptr when the function uses something the IR can't express yet
+    static IRFunction* Build(Module* module, Declaration* declaration);
+
+private:
+    static void CollectAddressTaken(Statement* statement);
+    static void CollectAddressTakenExpression(Expression* expression);
+    static void MarkAddressTaken(Expression* expression);
+    static bool IsRegisterVariable(Declaration* declaration);
+    static bool IsScalar(Type* type);
+
+    static void BuildParameters(Function* function);
+    static void BuildStatement(Module* module, Statement* statement);
+    static void BuildConditional(Module* module, Conditional* conditional);
+    static void BuildLoop(Module* module, Loop* loop);
+
+    // Branches to onTrue or onFalse, && and || become a branch per operand instead of a value
+    static void BuildBranch(Module* module, Expression* condition, IRBlock* onTrue, IRBlock* onFalse);
+
+    static IRInstruction* BuildExpression(Module* module, Expression* expression);
+    static IRInstruction* BuildExpressionPrimary(Module* module, Expression* expression);
+    static IRInstruction* BuildExpressionUnary(Module* module, Expression* expression);
+    static IRInstruction* BuildExpressionBinary(Module* module, Expression* expression);
+    static IRInstruction* BuildExpressionLogical(Module* module, Expression* expression);
+    static IRInstruction* BuildExpressionCall(Module* module, Expression* expression);
+    static IRInstruction* BuildExpressionMemoryNew(Module* module, Expression* expression, u64 typeSize);
+    static IRInstruction* BuildAddress(Module* module, Expression* expression);
+    static IRInstruction* BuildLoad(IRInstruction* address, Type* type);
+
+    static void WriteVariable(Declaration* declaration, IRBlock* block, IRInstruction* value);
+    static IRInstruction* ReadVariable(Declaration* declaration, IRBlock* block);
+    static IRInstruction* ReadVariableRecursive(Declaration* declaration, IRBlock* block);
+    static IRInstruction* AddPhiOperands(Declaration* declaration, IRInstruction* phi);
+    static IRInstruction* TryRemoveTrivialPhi(IRInstruction* phi);
+    static void SealBlock(IRBlock* block);
+
+    static IRBlock* CreateBlock();
+    static IRInstruction* Emit(IRInstruction::Kind kind, u8 size);
+    static void EmitJump(IRBlock* target);
+    static void EmitBranch(IRInstruction* condition, u8 size, IRBlock* onTrue, IRBlock* onFalse);
+    static void EmitReturn(IRInstruction* value);
+    static IRInstruction* Unsupported();
+
+private:
+    // Functions are built on worker threads, each with its own context
+    static thread_local IRBuilderContext* _context;
+};
@@ -0,0 +1,294 @@
+#include "pch/Build.h"
+#include "IRInliner.h"
+#include "../Tree.h"
+
+#include <algorithm>
+
+u32 IRInliner::Run(IRFunction* function, const robin_hood::unordered_map<u32, IRFunction*>& callees, const robin_hood::unordered_map<Declaration*, std::vector<u32>>& calleeInlinedCallees, std::vector<u32>& inlinedCallees)
+{
+    std::vector<IRInstruction*> calls;
+    for (IRBlock* block : function->blocks)
+    {
+        for (IRInstruction* instruction : block->instructions)
+        {
+            if (instruction->kind == IRInstruction::Kind::Call)
+                calls.push_back(instruction);
+        }
+    }
+
+    u32 size = GetCost(function);
+    u32 numInlined = 0;
+
+    for (IRInstruction* call : calls)
+    {
+        auto itr = callees.find(call->callHash);
+        if (itr == callees.end())
+            continue;
+
+        IRFunction* callee = itr->second;
+        if (callee == function || !CanInline(callee))
+            continue;
+
+        u32 cost = GetCost(callee);
+        if (!callee->declaration->function.flags.alwaysInline)
+        {
+            if (cost > InlineThreshold || size + cost > MaxCallerSize)
+                continue;
+        }
+
+        Inline(function, call, callee);
+
+        size += cost;
+        numInlined++;
+
+        // Whatever the callee had inlined came along with its body
+        std::vector<u32> hashes = { call->callHash };
+
+        auto inlinedItr = calleeInlinedCallees.find(callee->declaration);
+        if (inlinedItr != calleeInlinedCallees.end())
+        {
+            hashes.insert(hashes.end(), inlinedItr->second.begin(), inlinedItr->second.end());
+        }
+
+        for (u32 hash : hashes)
+        {
+            if (std::find(inlinedCallees.begin(), inlinedCallees.end(), hash) == inlinedCallees.end())
+                inlinedCallees.push_back(hash);
+        }
+    }
+
+    return numInlined;
+}
+
+bool IRInliner::CanInline(IRFunction* callee)
+{
+    if (callee->declaration->function.flags.neverInline)
+        return false;
+
+    u32 calleeHash = callee->declaration->token->nameHash.hash;
+
+    for (IRBlock* block : callee->blocks)
+    {
+        for (IRInstruction* instruction : block->instructions)
+        {
+            // Inlining a recursive function only moves the call one level down
+            if (instruction->kind == IRInstruction::Kind::Call && instruction->callHash == calleeHash)
+                return false;
+
+            // Variables in the frame of the callee have no place in the frame of the caller
+            for (IRInstruction* operand : instruction->operands)
+            {
+                if (operand->kind == IRInstruction::Kind::FrameAddress)
+                    return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+u32 IRInliner::GetCost(IRFunction* callee)
+{
+    u32 cost = 0;
+
+    for (IRBlock* block : callee->blocks)
+    {
+        for (IRInstruction* instruction : block->instructions)
+        {
+            switch (instruction->kind)
+            {
+                // Parameters turn into the arguments and Returns into a Jump, the rest of these cost nothing once lowered or are cleaned up by the passes
+                case IRInstruction::Kind::Parameter:
+                case IRInstruction::Kind::Phi:
+                case IRInstruction::Kind::Copy:
+                case IRInstruction::Kind::Jump:
+                case IRInstruction::Kind::Return:
+                {
+                    break;
+                }
+
+                default:
+                {
+                    cost++;
+                    break;
+                }
+            }
+        }
+    }
+
+    return cost;
+}
+
+void IRInliner::Inline(IRFunction* function, IRInstruction* call, IRFunction* callee)
+{
+    IRBlock* block = call->block;
+    auto blockItr = std::find(function->blocks.begin(), function->blocks.end(), block);
+    size_t blockIndex = blockItr - function->blocks.begin();
+    size_t numBlocks = function->blocks.size();
+
+    // Everything after the call moves into a block the inlined Returns jump to
+    IRBlock* continuation = function->CreateBlock();
+
+    auto callItr = std::find(block->instructions.begin(), block->instructions.end(), call);
+    for (auto itr = callItr + 1; itr != block->instructions.end(); ++itr)
+    {
+        (*itr)->block = continuation;
+        continuation->instructions.push_back(*itr);
+    }
+
+    block->instructions.erase(callItr, block->instructions.end());
+
+    // The successors are entered from the continuation now, their Phi operands keep their index
+    IRBlock* successors[2];
+    u32 numSuccessors = continuation->GetSuccessors(successors);
+
+    for (u32 i = 0; i < numSuccessors; i++)
+    {
+        if (i == 1 && successors[1] == successors[0])
+            break;
+
+        for (IRBlock*& predecessor : successors[i]->predecessors)
+        {
+            if (predecessor == block)
+                predecessor = continuation;
+        }
+    }
+
+    robin_hood::unordered_map<IRBlock*, IRBlock*> blocks;
+    robin_hood::unordered_map<IRInstruction*, IRInstruction*> values;
+
+    for (IRBlock* calleeBlock : callee->blocks)
+    {
+        blocks[calleeBlock] = function->CreateBlock();
+    }
+
+    // Every value is created before any operand is filled in, Phis can refer to values further down
+    std::vector<std::pair<IRInstruction*, IRInstruction*>> clones;
+    std::vector<IRInstruction*> returnValues;
+
+    for (IRBlock* calleeBlock : callee->blocks)
+    {
+        IRBlock* clonedBlock = blocks[calleeBlock];
+
+        for (IRBlock* predecessor : calleeBlock->predecessors)
+        {
+            clonedBlock->predecessors.push_back(blocks[predecessor]);
+        }
+
+        for (IRInstruction* instruction : calleeBlock->instructions)
+        {
+            if (instruction->kind == IRInstruction::Kind::Parameter)
+            {
+                assert(instruction->number < call->operands.size());
+                values[instruction] = call->operands[instruction->number];
+                continue;
+            }
+
+            IRInstruction* clone;
+            if (instruction->kind == IRInstruction::Kind::Return)
+            {
+                clone = function->CreateInstruction(IRInstruction::Kind::Jump, 0);
+                clone->targets[0] = continuation;
+
+                continuation->predecessors.push_back(clonedBlock);
+            }
+            else
+            {
+                clone = function->CreateInstruction(instruction->kind, instruction->size);
+                clone->isPointer = instruction->isPointer;
+                clone->number = instruction->number;
+                clone->callHash = instruction->callHash;
+                clone->declaration = instruction->declaration;
+                clone->string = instruction->string;
+
+                for (u32 i = 0; i < 2; i++)
+                {
+                    if (instruction->targets[i])
+                        clone->targets[i] = blocks[instruction->targets[i]];
+                }
+            }
+
+            clone->block = clonedBlock;
+            clonedBlock->instructions.push_back(clone);
+
+            values[instruction] = clone;
+            clones.push_back({ instruction, clone });
+        }
+    }
+
+    for (auto& pair : clones)
+    {
+        IRInstruction* instruction = pair.first;
+        IRInstruction* clone = pair.second;
+
+        for (IRInstruction* operand : instruction->operands)
+        {
+            IRInstruction* value;
+
+            auto itr = values.find(operand);
+            if (itr != values.end())
+            {
+                value = itr->second;
+            }
+            else
+            {
+                // Constants belong to no block, every function owns its own
+                assert(operand->kind == IRInstruction::Kind::Constant);
+
+                value = function->CreateConstant(operand->number);
+                values[operand] = value;
+            }
+
+            if (instruction->kind == IRInstruction::Kind::Return)
+            {
+                returnValues.push_back(value);
+            }
+            else
+            {
+                clone->operands.push_back(value);
+            }
+        }
+    }
+
+    IRBlock* entry = blocks[callee->blocks[0]];
+    entry->predecessors.push_back(block);
+
+    IRInstruction* jump = function->CreateInstruction(IRInstruction::Kind::Jump, 0);
+    jump->targets[0] = entry;
+    jump->block = block;
+    block->instructions.push_back(jump);
+
+    // The call becomes a Copy of whatever the Return that was taken gave back
+    if (call->HasValue())
+    {
+        IRInstruction* phi = function->CreateInstruction(IRInstruction::Kind::Phi, call->size);
+        phi->isPointer = call->isPointer;
+        phi->block = continuation;
+
+        if (returnValues.size() == continuation->predecessors.size())
+        {
+            phi->operands = std::move(returnValues);
+        }
+        else
+        {
+            // A Return without a value in a function that has one, the value is undefined either way
+            phi->operands.assign(continuation->predecessors.size(), function->CreateConstant(0));
+        }
+
+        call->kind = IRInstruction::Kind::Copy;
+        call->operands.clear();
+        call->operands.push_back(phi);
+        call->callHash = 0;
+        call->block = continuation;
+
+        continuation->instructions.insert(continuation->instructions.begin(), call);
+        continuation->instructions.insert(continuation->instructions.begin(), phi);
+    }
+
+    // Lay the body out right after the call, with the continuation last so the final Return falls through into it
+    std::vector<IRBlock*> createdBlocks(function->blocks.begin() + numBlocks, function->blocks.end());
+    function->blocks.erase(function->blocks.begin() + numBlocks, function->blocks.end());
+
+    std::rotate(createdBlocks.begin(), createdBlocks.begin() + 1, createdBlocks.end());
+    function->blocks.insert(function->blocks.begin() + blockIndex + 1, createdBlocks.begin(), createdBlocks.end());
+}
@@ -0,0 +1,28 @@
+#pragma once
+#include "pch/Build.h"
+#include "robin_hood.h"
+#include "IR.h"
+#include <vector>
+
+// Replaces calls to small functions with a copy of their body, saving the frame setup, argument moves and the call itself
+// Callees marked #inline are always inlined and callees marked #no_inline never are, the rest go through the cost model below
+class IRInliner
+{
+public:
+    // A callee this size or smaller is inlined without being asked to, Phis and Copies don't count towards it
+    static constexpr u32 InlineThreshold = 16;
+
+    // The cost model stops growing a caller past this size, #inline callees are still inlined
+    static constexpr u32 MaxCallerSize = 512;
+
+    // Inlines the calls that are in the function when it starts, the calls inlined bodies bring along are left as calls
+    // callees maps a function hash to the IR of that function, and inlinedCallees receives the hash of every function copied into this one
+    // Returns the number of inlined calls
+    static u32 Run(IRFunction* function, const robin_hood::unordered_map<u32, IRFunction*>& callees, const robin_hood::unordered_map<Declaration*, std::vector<u32>>& calleeInlinedCallees, std::vector<u32>& inlinedCallees);
+
+    static bool CanInline(IRFunction* callee);
+    static u32 GetCost(IRFunction* callee);
+
+private:
+    static void Inline(IRFunction* function, IRInstruction* call, IRFunction* callee);
+};
@@ -0,0 +1,42 @@
+#include "pch/Build.h"
+#include "IRPassManager.h"
+#include "IRPasses.h"
+
+void IRPassManager::AddPass(const char* name, IRPassFunc* pass)
+{
+    _passes.push_back({ name, pass });
+}
+
+u32 IRPassManager::Run(IRFunction* function)
+{
+    ZoneScoped;
+
+    u32 numRounds = 0;
+
+    bool changed = true;
+    while (changed && numRounds < MaxRounds)
+    {
+        changed = false;
+        numRounds++;
+
+        for (Pass& pass : _passes)
+        {
+            changed |= pass.run(function);
+        }
+    }
+
+    return numRounds;
+}
+
+IRPassManager IRPassManager::CreateDefault()
+{
+    IRPassManager passManager;
+
+    // Dead code goes first, the other passes expect every block to be reachable
+    passManager.AddPass("DeadCodeElimination", IRPasses::DeadCodeElimination);
+    passManager.AddPass("CopyPropagation", IRPasses::CopyPropagation);
+    passManager.AddPass("CommonSubexpressionElimination", IRPasses::CommonSubexpressionElimination);
+    passManager.AddPass("LoopInvariantCodeMotion", IRPasses::LoopInvariantCodeMotion);
+
+    return passManager;
+}
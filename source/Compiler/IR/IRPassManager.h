@@ -0,0 +1,34 @@
+#pragma once
+#include "pch/Build.h"
+#include <vector>
+
+struct IRFunction;
+
+// Returns true if the pass changed the function
+typedef bool IRPassFunc(IRFunction* function);
+
+class IRPassManager
+{
+public:
+    void AddPass(const char* name, IRPassFunc* pass);
+
+    // Runs every pass in order, and starts over for as long as one of them keeps changing the function
+    // Returns the number of rounds it took
+    u32 Run(IRFunction* function);
+
+    // Dead code elimination, copy propagation, common subexpression elimination and loop invariant code motion
+    static IRPassManager CreateDefault();
+
+private:
+    // Every pass only ever removes or moves instructions, this is just a guard against two passes undoing each other
+    static constexpr u32 MaxRounds = 8;
+
+    struct Pass
+    {
+    public:
+        const char* name;
+        IRPassFunc* run;
+    };
+
+    std::vector<Pass> _passes;
+};
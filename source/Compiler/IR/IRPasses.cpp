@@ -0,0 +1,605 @@
+#include "pch/Build.h"
+#include "IRPasses.h"
+#include "Utils/StringUtils.h"
+
+#include <algorithm>
+
+bool IRPasses::DeadCodeElimination(IRFunction* function)
+{
+    bool changed = FoldConstantBranches(function);
+    changed |= RemoveUnreachableBlocks(function);
+
+    // Mark everything the side effects depend on, whatever is left unmarked has no observable effect
+    std::vector<bool> isLive(function->numInstructions, false);
+    std::vector<IRInstruction*> worklist;
+
+    for (IRBlock* block : function->blocks)
+    {
+        for (IRInstruction* instruction : block->instructions)
+        {
+            if (instruction->HasSideEffects())
+            {
+                isLive[instruction->id] = true;
+                worklist.push_back(instruction);
+            }
+        }
+    }
+
+    while (worklist.size())
+    {
+        IRInstruction* instruction = worklist.back();
+        worklist.pop_back();
+
+        for (IRInstruction* operand : instruction->operands)
+        {
+            if (isLive[operand->id])
+                continue;
+
+            isLive[operand->id] = true;
+            worklist.push_back(operand);
+        }
+    }
+
+    for (IRBlock* block : function->blocks)
+    {
+        size_t numInstructions = block->instructions.size();
+
+        auto itr = std::remove_if(block->instructions.begin(), block->instructions.end(), [&isLive](IRInstruction* instruction) { return !isLive[instruction->id]; });
+        block->instructions.erase(itr, block->instructions.end());
+
+        changed |= block->instructions.size() != numInstructions;
+    }
+
+    return changed;
+}
+
+bool IRPasses::CopyPropagation(IRFunction* function)
+{
+    bool changed = false;
+
+    for (IRBlock* block : function->blocks)
+    {
+        std::vector<IRInstruction*> phis;
+        for (IRInstruction* instruction : block->instructions)
+        {
+            if (instruction->kind != IRInstruction::Kind::Phi)
+                break;
+
+            phis.push_back(instruction);
+        }
+
+        for (IRInstruction* phi : phis)
+        {
+            IRInstruction* same = nullptr;
+            bool isTrivial = true;
+
+            for (IRInstruction* operand : phi->operands)
+            {
+                operand = operand->Resolve();
+
+                if (operand == same || operand == phi)
+                    continue;
+
+                if (same)
+                {
+                    isTrivial = false;
+                    break;
+                }
+
+                same = operand;
+            }
+
+            if (!isTrivial)
+                continue;
+
+            if (!same)
+            {
+                same = function->CreateConstant(0);
+            }
+
+            block->ReplacePhi(phi, same);
+            changed = true;
+        }
+    }
+
+    for (IRBlock* block : function->blocks)
+    {
+        for (IRInstruction* instruction : block->instructions)
+        {
+            // A Copy keeps pointing at what it copies, it is dead once nothing else uses it
+            if (instruction->kind == IRInstruction::Kind::Copy)
+                continue;
+
+            for (IRInstruction*& operand : instruction->operands)
+            {
+                IRInstruction* value = operand->Resolve();
+                if (value != operand)
+                {
+                    operand = value;
+                    changed = true;
+                }
+            }
+        }
+    }
+
+    return changed;
+}
+
+bool IRPasses::CommonSubexpressionElimination(IRFunction* function)
+{
+    std::vector<IRBlock*> order;
+    ComputeDominators(function, order);
+
+    robin_hood::unordered_map<IRBlock*, std::vector<IRBlock*>> children;
+    for (IRBlock* block : order)
+    {
+        if (block != block->immediateDominator)
+        {
+            children[block->immediateDominator].push_back(block);
+        }
+    }
+
+    robin_hood::unordered_map<u64, std::vector<IRInstruction*>> available;
+    return NumberValues(function->blocks[0], children, available);
+}
+
+bool IRPasses::LoopInvariantCodeMotion(IRFunction* function)
+{
+    std::vector<IRBlock*> order;
+    ComputeDominators(function, order);
+
+    bool changed = false;
+
+    for (IRBlock* header : order)
+    {
+        // Every block with an edge back to the header belongs to the same loop
+        robin_hood::unordered_map<IRBlock*, bool> loop;
+        for (IRBlock* predecessor : header->predecessors)
+        {
+            if (predecessor->isReachable && Dominates(header, predecessor))
+            {
+                CollectLoop(header, predecessor, loop);
+            }
+        }
+
+        if (loop.size() == 0)
+            continue;
+
+        // Only hoist into a single block that does nothing but enter the loop, IRBuilder always creates one
+        IRBlock* preheader = nullptr;
+        u32 numEntries = 0;
+
+        for (IRBlock* predecessor : header->predecessors)
+        {
+            if (loop.find(predecessor) == loop.end())
+            {
+                preheader = predecessor;
+                numEntries++;
+            }
+        }
+
+        if (numEntries != 1)
+            continue;
+
+        IRInstruction* terminator = preheader->GetTerminator();
+        if (!terminator || terminator->kind != IRInstruction::Kind::Jump)
+            continue;
+
+        // Walk the loop in order, so an instruction is hoisted after the ones it depends on
+        for (IRBlock* block : order)
+        {
+            if (loop.find(block) == loop.end())
+                continue;
+
+            for (size_t i = 0; i < block->instructions.size();)
+            {
+                IRInstruction* instruction = block->instructions[i];
+
+                bool isInvariant = IsHoistable(instruction);
+                for (IRInstruction* operand : instruction->operands)
+                {
+                    if (!isInvariant)
+                        break;
+
+                    isInvariant = !operand->block || loop.find(operand->block) == loop.end();
+                }
+
+                if (!isInvariant)
+                {
+                    i++;
+                    continue;
+                }
+
+                block->instructions.erase(block->instructions.begin() + i);
+                preheader->InsertBeforeTerminator(instruction);
+                changed = true;
+            }
+        }
+    }
+
+    return changed;
+}
+
+void IRPasses::ComputeDominators(IRFunction* function, std::vector<IRBlock*>& order)
+{
+    // Cooper, Harvey and Kennedy "A Simple, Fast Dominance Algorithm"
+    for (IRBlock* block : function->blocks)
+    {
+        block->isReachable = false;
+        block->immediateDominator = nullptr;
+    }
+
+    IRBlock* entry = function->blocks[0];
+
+    struct Visit
+    {
+    public:
+        IRBlock* block;
+        u32 successorIndex;
+    };
+
+    std::vector<Visit> stack;
+    stack.push_back({ entry, 0 });
+    entry->isReachable = true;
+
+    order.clear();
+    while (stack.size())
+    {
+        Visit& visit = stack.back();
+
+        IRBlock* successors[2];
+        u32 numSuccessors = visit.block->GetSuccessors(successors);
+
+        if (visit.successorIndex < numSuccessors)
+        {
+            IRBlock* successor = successors[visit.successorIndex++];
+            if (!successor->isReachable)
+            {
+                successor->isReachable = true;
+                stack.push_back({ successor, 0 });
+            }
+
+            continue;
+        }
+
+        order.push_back(visit.block);
+        stack.pop_back();
+    }
+
+    std::reverse(order.begin(), order.end());
+    for (u32 i = 0; i < order.size(); i++)
+    {
+        order[i]->order = i;
+    }
+
+    entry->immediateDominator = entry;
+
+    bool changed = true;
+    while (changed)
+    {
+        changed = false;
+
+        for (size_t i = 1; i < order.size(); i++)
+        {
+            IRBlock* block = order[i];
+            IRBlock* immediateDominator = nullptr;
+
+            for (IRBlock* predecessor : block->predecessors)
+            {
+                if (!predecessor->immediateDominator)
+                    continue;
+
+                immediateDominator = immediateDominator ? Intersect(predecessor, immediateDominator) : predecessor;
+            }
+
+            if (block->immediateDominator != immediateDominator)
+            {
+                block->immediateDominator = immediateDominator;
+                changed = true;
+            }
+        }
+    }
+}
+
+bool IRPasses::Dominates(IRBlock* dominator, IRBlock* block)
+{
+    while (block != dominator)
+    {
+        if (block == block->immediateDominator)
+            return false;
+
+        block = block->immediateDominator;
+    }
+
+    return true;
+}
+
+bool IRPasses::FoldConstantBranches(IRFunction* function)
+{
+    bool changed = false;
+
+    for (IRBlock* block : function->blocks)
+    {
+        IRInstruction* terminator = block->GetTerminator();
+        if (!terminator || terminator->kind != IRInstruction::Kind::Branch)
+            continue;
+
+        IRInstruction* condition = terminator->operands[0]->Resolve();
+        if (condition->kind != IRInstruction::Kind::Constant)
+            continue;
+
+        // Bytecode only compares the low bytes of the condition
+        bool isTrue = Truncate(condition->number, terminator->size) != 0;
+
+        IRBlock* taken = terminator->targets[isTrue ? 0 : 1];
+        IRBlock* skipped = terminator->targets[isTrue ? 1 : 0];
+        skipped->RemovePredecessor(block);
+
+        terminator->kind = IRInstruction::Kind::Jump;
+        terminator->operands.clear();
+        terminator->targets[0] = taken;
+        terminator->targets[1] = nullptr;
+        terminator->size = 0;
+
+        changed = true;
+    }
+
+    return changed;
+}
+
+bool IRPasses::RemoveUnreachableBlocks(IRFunction* function)
+{
+    std::vector<IRBlock*> order;
+    ComputeDominators(function, order);
+
+    if (order.size() == function->blocks.size())
+        return false;
+
+    std::vector<IRBlock*> unreachable;
+    for (IRBlock* block : function->blocks)
+    {
+        if (!block->isReachable)
+        {
+            unreachable.push_back(block);
+        }
+    }
+
+    for (IRBlock* block : unreachable)
+    {
+        function->RemoveBlock(block);
+    }
+
+    return true;
+}
+
+IRBlock* IRPasses::Intersect(IRBlock* a, IRBlock* b)
+{
+    while (a != b)
+    {
+        while (a->order > b->order)
+        {
+            a = a->immediateDominator;
+        }
+
+        while (b->order > a->order)
+        {
+            b = b->immediateDominator;
+        }
+    }
+
+    return a;
+}
+
+bool IRPasses::NumberValues(IRBlock* block, robin_hood::unordered_map<IRBlock*, std::vector<IRBlock*>>& children, robin_hood::unordered_map<u64, std::vector<IRInstruction*>>& available)
+{
+    bool changed = false;
+
+    // Everything added here is only available to the blocks this one dominates
+    std::vector<u64> added;
+    std::vector<IRInstruction*> loads;
+
+    for (IRInstruction* instruction : block->instructions)
+    {
+        switch (instruction->kind)
+        {
+            case IRInstruction::Kind::Load:
+            {
+                auto itr = std::find_if(loads.begin(), loads.end(), [instruction](IRInstruction* load) { return IsEquivalent(load, instruction); });
+                if (itr != loads.end())
+                {
+                    ReplaceWithCopy(instruction, *itr);
+                    changed = true;
+                }
+                else
+                {
+                    loads.push_back(instruction);
+                }
+                continue;
+            }
+            case IRInstruction::Kind::Store:
+            case IRInstruction::Kind::Call:
+            case IRInstruction::Kind::MemoryNew:
+            case IRInstruction::Kind::MemoryFree:
+            {
+                // Nai has no alias analysis, any of these may have written what we loaded
+                loads.clear();
+                continue;
+            }
+
+            default:
+            {
+                break;
+            }
+        }
+
+        if (!instruction->IsBinary())
+            continue;
+
+        u64 hash = HashInstruction(instruction);
+        std::vector<IRInstruction*>& candidates = available[hash];
+
+        auto itr = std::find_if(candidates.begin(), candidates.end(), [instruction](IRInstruction* candidate) { return IsEquivalent(candidate, instruction); });
+        if (itr != candidates.end())
+        {
+            ReplaceWithCopy(instruction, *itr);
+            changed = true;
+            continue;
+        }
+
+        candidates.push_back(instruction);
+        added.push_back(hash);
+    }
+
+    auto itr = children.find(block);
+    if (itr != children.end())
+    {
+        for (IRBlock* child : itr->second)
+        {
+            changed |= NumberValues(child, children, available);
+        }
+    }
+
+    for (auto addedItr = added.rbegin(); addedItr != added.rend(); ++addedItr)
+    {
+        available[*addedItr].pop_back();
+    }
+
+    return changed;
+}
+
+u64 IRPasses::HashValue(IRInstruction* value, u64 hash)
+{
+    value = value->Resolve();
+
+    // Constants and frame addresses are created for every use, so they are compared by what they hold
+    switch (value->kind)
+    {
+        case IRInstruction::Kind::Constant:
+        {
+            return StringUtils::fnv1a_64(&value->number, sizeof(u64), hash);
+        }
+        case IRInstruction::Kind::FrameAddress:
+        {
+            return StringUtils::fnv1a_64(&value->declaration, sizeof(Declaration*), hash);
+        }
+
+        default:
+        {
+            return StringUtils::fnv1a_64(&value, sizeof(IRInstruction*), hash);
+        }
+    }
+}
+
+u64 IRPasses::HashInstruction(IRInstruction* instruction)
+{
+    u64 hash = StringUtils::fnv1a_64(&instruction->kind, sizeof(IRInstruction::Kind));
+    hash = StringUtils::fnv1a_64(&instruction->size, sizeof(u8), hash);
+
+    // Commutative operands are combined in a way that doesn't depend on their order
+    if (instruction->IsCommutative())
+    {
+        return hash ^ HashValue(instruction->operands[0], 0) ^ HashValue(instruction->operands[1], 0);
+    }
+
+    for (IRInstruction* operand : instruction->operands)
+    {
+        hash = HashValue(operand, hash);
+    }
+
+    return hash;
+}
+
+bool IRPasses::IsSameValue(IRInstruction* a, IRInstruction* b)
+{
+    a = a->Resolve();
+    b = b->Resolve();
+
+    if (a == b)
+        return true;
+
+    if (a->kind != b->kind)
+        return false;
+
+    if (a->kind == IRInstruction::Kind::Constant)
+        return a->number == b->number;
+
+    if (a->kind == IRInstruction::Kind::FrameAddress)
+        return a->declaration == b->declaration;
+
+    return false;
+}
+
+bool IRPasses::IsEquivalent(IRInstruction* a, IRInstruction* b)
+{
+    if (a->kind != b->kind || a->size != b->size || a->operands.size() != b->operands.size())
+        return false;
+
+    if (a->IsCommutative() && IsSameValue(a->operands[0], b->operands[1]) && IsSameValue(a->operands[1], b->operands[0]))
+        return true;
+
+    for (size_t i = 0; i < a->operands.size(); i++)
+    {
+        if (!IsSameValue(a->operands[i], b->operands[i]))
+            return false;
+    }
+
+    return true;
+}
+
+void IRPasses::ReplaceWithCopy(IRInstruction* instruction, IRInstruction* value)
+{
+    instruction->kind = IRInstruction::Kind::Copy;
+    instruction->operands.clear();
+    instruction->operands.push_back(value);
+}
+
+void IRPasses::CollectLoop(IRBlock* header, IRBlock* latch, robin_hood::unordered_map<IRBlock*, bool>& loop)
+{
+    loop[header] = true;
+
+    std::vector<IRBlock*> worklist;
+    if (loop.find(latch) == loop.end())
+    {
+        loop[latch] = true;
+        worklist.push_back(latch);
+    }
+
+    // Everything that reaches the latch without going through the header
+    while (worklist.size())
+    {
+        IRBlock* block = worklist.back();
+        worklist.pop_back();
+
+        for (IRBlock* predecessor : block->predecessors)
+        {
+            if (loop.find(predecessor) != loop.end())
+                continue;
+
+            loop[predecessor] = true;
+            worklist.push_back(predecessor);
+        }
+    }
+}
+
+bool IRPasses::IsHoistable(IRInstruction* instruction)
+{
+    if (!instruction->IsBinary())
+        return false;
+
+    // Hoisting a division out of a loop that never runs must not introduce a division by zero
+    if (instruction->kind == IRInstruction::Kind::Divide || instruction->kind == IRInstruction::Kind::Modulo)
+    {
+        IRInstruction* divisor = instruction->operands[1]->Resolve();
+        return divisor->kind == IRInstruction::Kind::Constant && Truncate(divisor->number, instruction->size) != 0;
+    }
+
+    return true;
+}
+
+u64 IRPasses::Truncate(u64 value, u8 size)
+{
+    if (size >= 8)
+        return value;
+
+    return value & ((1ull << (size * 8)) - 1);
+}
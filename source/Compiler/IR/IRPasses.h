@@ -0,0 +1,43 @@
+#pragma once
+#include "pch/Build.h"
+#include "robin_hood.h"
+#include "IR.h"
+#include <vector>
+
+class IRPasses
+{
+public:
+    // Folds branches on constants, removes unreachable blocks and every instruction nothing with a side effect depends on
+    // Division by zero isn't treated as a side effect, a division whose result is unused goes away like any other
+    static bool DeadCodeElimination(IRFunction* function);
+
+    // Points every use of a Copy at the value it copies, and turns Phis merging a single value into Copies
+    static bool CopyPropagation(IRFunction* function);
+
+    // Replaces an instruction with a Copy of an identical one that dominates it
+    // Loads are only reused within a block, and only until the next instruction that may write memory
+    static bool CommonSubexpressionElimination(IRFunction* function);
+
+    // Moves arithmetic whose operands are all defined outside of a loop into the block that enters the loop
+    static bool LoopInvariantCodeMotion(IRFunction* function);
+
+    // Fills in IRBlock::order, isReachable and immediateDominator, order receives the reachable blocks in reverse post order
+    static void ComputeDominators(IRFunction* function, std::vector<IRBlock*>& order);
+    static bool Dominates(IRBlock* dominator, IRBlock* block);
+
+private:
+    static bool FoldConstantBranches(IRFunction* function);
+    static bool RemoveUnreachableBlocks(IRFunction* function);
+    static IRBlock* Intersect(IRBlock* a, IRBlock* b);
+
+    static bool NumberValues(IRBlock* block, robin_hood::unordered_map<IRBlock*, std::vector<IRBlock*>>& children, robin_hood::unordered_map<u64, std::vector<IRInstruction*>>& available);
+    static u64 HashValue(IRInstruction* value, u64 hash);
+    static u64 HashInstruction(IRInstruction* instruction);
+    static bool IsSameValue(IRInstruction* a, IRInstruction* b);
+    static bool IsEquivalent(IRInstruction* a, IRInstruction* b);
+    static void ReplaceWithCopy(IRInstruction* instruction, IRInstruction* value);
+
+    static void CollectLoop(IRBlock* header, IRBlock* latch, robin_hood::unordered_map<IRBlock*, bool>& loop);
+    static bool IsHoistable(IRInstruction* instruction);
+    static u64 Truncate(u64 value, u8 size);
+};
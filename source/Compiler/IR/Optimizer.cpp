@@ -0,0 +1,190 @@
+#include "pch/Build.h"
+#include "Optimizer.h"
+#include "IR.h"
+#include "IRBuilder.h"
+#include "IRPassManager.h"
+#include "IRInliner.h"
+#include "../Module.h"
+#include "Utils/JobUtils.h"
+
+void Optimizer::Process(Module* module)
+{
+    IRInfo& irInfo = module->irInfo;
+    if (!irInfo.isEnabled)
+        return;
+
+    for (auto& itr : irInfo.functions)
+    {
+        delete itr.second;
+    }
+
+    irInfo.functions.clear();
+    irInfo.inlinedCallees.clear();
+
+    std::vector<Declaration*> declarations;
+
+    ListNode* node;
+    ListIterate(&module->parserInfo.block->scope->declarations, node)
+    {
+        Declaration* declaration = ListGetStructPtr(node, Declaration, listNode);
+        declarations.push_back(declaration);
+    }
+
+    Process(module, declarations);
+}
+
+void Optimizer::Process(Module* module, const std::vector<Declaration*>& declarations)
+{
+    IRInfo& irInfo = module->irInfo;
+    if (!irInfo.isEnabled)
+        return;
+
+    std::vector<Declaration*> functions;
+    for (Declaration* declaration : declarations)
+    {
+        if (declaration->kind == Declaration::Kind::Function && !declaration->function.flags.nativeCall && !declaration->function.flags.unreachable)
+        {
+            functions.push_back(declaration);
+        }
+    }
+
+    IRPassManager passManager = IRPassManager::CreateDefault();
+
+    std::vector<IRFunction*> results(functions.size(), nullptr);
+    std::atomic<u32> numBuiltInstructions = 0;
+
+    JobUtils::ParallelFor(functions.size(), [&](size_t index)
+    {
+        IRFunction* function = IRBuilder::Build(module, functions[index]);
+        if (!function)
+            return;
+
+        numBuiltInstructions += function->GetNumInstructionsInBlocks();
+        passManager.Run(function);
+
+        results[index] = function;
+    });
+
+    // Inserted serially, the workers never touch the map
+    u32 numLowered = 0;
+    for (size_t i = 0; i < functions.size(); i++)
+    {
+        auto itr = irInfo.functions.find(functions[i]);
+        if (itr != irInfo.functions.end())
+        {
+            delete itr->second;
+            irInfo.functions.erase(itr);
+        }
+
+        irInfo.inlinedCallees.erase(functions[i]);
+
+        if (results[i])
+        {
+            irInfo.functions[functions[i]] = results[i];
+            numLowered++;
+        }
+    }
+
+    robin_hood::unordered_map<u32, IRFunction*> callees;
+    robin_hood::unordered_map<Declaration*, bool> isInScope;
+
+    ListNode* node;
+    ListIterate(&module->parserInfo.block->scope->declarations, node)
+    {
+        Declaration* declaration = ListGetStructPtr(node, Declaration, listNode);
+        isInScope[declaration] = true;
+
+        auto itr = irInfo.functions.find(declaration);
+        if (itr != irInfo.functions.end())
+        {
+            callees[declaration->token->nameHash.hash] = itr->second;
+        }
+    }
+
+    // Functions that were removed from the module keep no IR around
+    for (auto itr = irInfo.functions.begin(); itr != irInfo.functions.end();)
+    {
+        if (isInScope.find(itr->first) == isInScope.end())
+        {
+            delete itr->second;
+            irInfo.inlinedCallees.erase(itr->first);
+            itr = irInfo.functions.erase(itr);
+        }
+        else
+        {
+            ++itr;
+        }
+    }
+
+    // Inlining reads the IR of other functions, so it runs serially and in declaration order
+    // A callee that comes first has already had its own calls inlined when it gets copied
+    std::vector<IRFunction*> inlined;
+    u32 numInlined = 0;
+
+    for (size_t i = 0; i < functions.size(); i++)
+    {
+        if (!results[i])
+            continue;
+
+        std::vector<u32> inlinedCallees;
+        u32 numInlinedCalls = IRInliner::Run(results[i], callees, irInfo.inlinedCallees, inlinedCallees);
+        if (numInlinedCalls == 0)
+            continue;
+
+        numInlined += numInlinedCalls;
+        inlined.push_back(results[i]);
+        irInfo.inlinedCallees[functions[i]] = std::move(inlinedCallees);
+    }
+
+    // The inlined bodies were optimized on their own, but now see the arguments they were called with
+    JobUtils::ParallelFor(inlined.size(), [&](size_t index)
+    {
+        passManager.Run(inlined[index]);
+    });
+
+    u32 numInstructions = 0;
+    for (IRFunction* function : results)
+    {
+        if (function)
+            numInstructions += function->GetNumInstructionsInBlocks();
+    }
+
+    DebugHandler::PrintSuccess("Optimizer : Successfully Processsed Module (%s) (Functions: %u, Lowered: %u, Inlined: %u, Instructions: %u -> %u)", module->nameHash.name.c_str(), static_cast<u32>(functions.size()), numLowered, numInlined, numBuiltInstructions.load(), numInstructions);
+}
+
+void Optimizer::AddInlinedCallers(Module* module, std::vector<Declaration*>& declarations)
+{
+    IRInfo& irInfo = module->irInfo;
+    if (!irInfo.isEnabled || irInfo.inlinedCallees.empty())
+        return;
+
+    robin_hood::unordered_map<u32, bool> changedHashes;
+    robin_hood::unordered_map<Declaration*, bool> isChanged;
+
+    for (Declaration* declaration : declarations)
+    {
+        changedHashes[declaration->token->nameHash.hash] = true;
+        isChanged[declaration] = true;
+    }
+
+    ListNode* node;
+    ListIterate(&module->parserInfo.block->scope->declarations, node)
+    {
+        Declaration* declaration = ListGetStructPtr(node, Declaration, listNode);
+        if (isChanged.find(declaration) != isChanged.end())
+            continue;
+
+        auto itr = irInfo.inlinedCallees.find(declaration);
+        if (itr == irInfo.inlinedCallees.end())
+            continue;
+
+        for (u32 hash : itr->second)
+        {
+            if (changedHashes.find(hash) != changedHashes.end())
+            {
+                declarations.push_back(declaration);
+                break;
+            }
+        }
+    }
+}
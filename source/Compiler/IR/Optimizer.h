@@ -0,0 +1,21 @@
+#pragma once
+#include "pch/Build.h"
+#include <vector>
+
+struct Module;
+struct Declaration;
+
+// Runs between the Folder and Bytecode when the module has the IR enabled
+// Builds the SSA form of every function and runs IRPassManager::CreateDefault over it, then inlines small calls (see IRInliner) and runs it again
+// Functions the IR can't express yet are left out, Bytecode generates those from their tree as before
+class Optimizer
+{
+public:
+    static void Process(Module* module);
+
+    // Optimizes a subset of the global declarations, the IR of every other function is kept
+    static void Process(Module* module, const std::vector<Declaration*>& declarations);
+
+    // Adds the unchanged functions that inlined one of the declarations, their tree is reused but their code has to be generated again
+    static void AddInlinedCallers(Module* module, std::vector<Declaration*>& declarations);
+};
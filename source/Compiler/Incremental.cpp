@@ -0,0 +1,395 @@
+#include "pch/Build.h"
+#include "Incremental.h"
+#include "Module.h"
+#include <algorithm>
+
+#include "Frontend/Lexer.h"
+#include "Frontend/Parser.h"
+#include "Frontend/Typer.h"
+#include "Frontend/Folder.h"
+#include "IR/Optimizer.h"
+#include "Backend/Bytecode/Bytecode.h"
+#include "Backend/Bytecode/BytecodeVerifier.h"
+#include "Backend/x86_64/x86_64.h"
+
+void Incremental::Parse(Module* module, const char* source, size_t size)
+{
+    IncrementalInfo& incrementalInfo = module->incrementalInfo;
+    LexerInfo& lexerInfo = module->lexerInfo;
+
+    bool isFirstParse = module->parserInfo.block == nullptr;
+    if (!isFirstParse)
+    {
+        // Reused declarations point into the previous tokens and buffer, so we keep them until nothing does
+        IncrementalSource& previousSource = incrementalInfo.sources.emplace_back();
+        previousSource.generation = incrementalInfo.generation;
+        previousSource.buffer = lexerInfo.buffer;
+        previousSource.tokens = std::move(lexerInfo.tokens);
+    }
+
+    incrementalInfo.generation++;
+
+    char* buffer = new char[size + 1];
+    memcpy(buffer, source, size);
+    buffer[size] = 0;
+
+    lexerInfo.buffer = buffer;
+    lexerInfo.size = size;
+    lexerInfo.index = 0;
+    lexerInfo.tokenIndex = 0;
+    lexerInfo.line = 1;
+    lexerInfo.column = 1;
+    lexerInfo.tokens.clear();
+
+    Lexer::Process(module);
+
+    std::vector<IncrementalDeclaration> declarations;
+    if (isFirstParse)
+    {
+        ParseAll(module, declarations);
+    }
+    else
+    {
+        ParseChanged(module, declarations);
+    }
+
+    incrementalInfo.declarations = std::move(declarations);
+    ReleaseSources(module);
+}
+
+void Incremental::Compile(Module* module)
+{
+    IncrementalInfo& incrementalInfo = module->incrementalInfo;
+
+    if (incrementalInfo.compileAll)
+    {
+        Typer::Process(module);
+        Folder::Process(module);
+        Optimizer::Process(module);
+        Bytecode::Process(module);
+
+        incrementalInfo.compileAll = false;
+    }
+    else
+    {
+        Typer::Process(module, incrementalInfo.changedDeclarations);
+        Folder::Process(module, incrementalInfo.changedDeclarations);
+
+        // Functions that inlined a changed function still hold its old body
+        Optimizer::AddInlinedCallers(module, incrementalInfo.changedDeclarations);
+        Optimizer::Process(module, incrementalInfo.changedDeclarations);
+        Bytecode::Process(module, incrementalInfo.changedDeclarations);
+    }
+
+    // Unchanged functions were relinked into a new buffer, so the whole module is verified again
+    BytecodeVerifier::Process(module);
+    Jit::Process(module);
+
+    u32 numDeclarations = static_cast<u32>(incrementalInfo.declarations.size());
+    u32 numChanged = static_cast<u32>(incrementalInfo.changedDeclarations.size());
+    incrementalInfo.changedDeclarations.clear();
+
+    DebugHandler::PrintSuccess("Incremental : Successfully Processsed Module (%s) (Declarations: %u, Changed: %u)", module->nameHash.name.c_str(), numDeclarations, numChanged);
+}
+
+void Incremental::FindDeclarations(Module* module, std::vector<IncrementalDeclaration>& declarations)
+{
+    LexerInfo& lexerInfo = module->lexerInfo;
+    std::vector<Token>& tokens = lexerInfo.tokens;
+
+    u32 index = 0;
+    while (true)
+    {
+        Token* token = &tokens[index];
+        if (token->kind == Token::Kind::End_of_File)
+            break;
+
+        if (token->kind == Token::Kind::Comment)
+        {
+            index++;
+            continue;
+        }
+
+        if (token->kind != Token::Kind::Keyword_Fn && token->kind != Token::Kind::Keyword_Struct)
+        {
+            lexerInfo.Error(token, "Only functions and structs can be declared in the Global Scope");
+        }
+
+        Token* nameToken = &tokens[index + 1];
+        if (nameToken->kind != Token::Kind::Identifier)
+        {
+            lexerInfo.Error(nameToken, "Expecting '%s' but got '%s'", Token::GetTokenKindName(Token::Kind::Identifier), Token::GetTokenKindName(nameToken->kind));
+        }
+
+        IncrementalDeclaration& declaration = declarations.emplace_back();
+        declaration.nameHash = nameToken->nameHash.hash;
+        declaration.firstToken = index;
+
+        // The declaration ends with the '}' that closes the first '{', which for functions is also where the body starts
+        u32 bodyToken = 0;
+        u32 depth = 0;
+
+        for (index += 2; ; index++)
+        {
+            token = &tokens[index];
+
+            if (token->kind == Token::Kind::End_of_File)
+            {
+                lexerInfo.Error(nameToken, "Declaration (%.*s) is missing a closing '}'", nameToken->nameHash.length, nameToken->nameHash.name);
+            }
+            else if (token->kind == Token::Kind::Curley_Bracket_Open)
+            {
+                if (depth++ == 0 && bodyToken == 0)
+                    bodyToken = index;
+            }
+            else if (token->kind == Token::Kind::Curley_Bracket_Close)
+            {
+                if (depth == 0)
+                {
+                    lexerInfo.Error(token, "Unexpected '}'");
+                }
+
+                if (--depth == 0)
+                {
+                    index++;
+                    break;
+                }
+            }
+        }
+
+        declaration.lastToken = index;
+
+        // Every token of a struct is part of its layout
+        if (tokens[declaration.firstToken].kind == Token::Kind::Keyword_Struct)
+            bodyToken = declaration.lastToken;
+
+        HashTokens(module, declaration.firstToken, bodyToken, declaration.signatureHash, declaration.signatureReferences);
+        HashTokens(module, declaration.firstToken, declaration.lastToken, declaration.hash, declaration.references);
+    }
+}
+
+void Incremental::HashTokens(Module* module, u32 firstToken, u32 lastToken, u64& hash, std::vector<u32>& references)
+{
+    std::vector<Token>& tokens = module->lexerInfo.tokens;
+    u32 nameHash = tokens[firstToken + 1].nameHash.hash;
+
+    hash = StringUtils::fnv1a_64(nullptr, 0);
+
+    // Line and column are left out on purpose, moving a declaration around in the file shouldn't invalidate it
+    for (u32 i = firstToken; i < lastToken; i++)
+    {
+        Token* token = &tokens[i];
+        if (token->kind == Token::Kind::Comment)
+            continue;
+
+        hash = StringUtils::fnv1a_64(&token->kind, sizeof(token->kind), hash);
+        hash = StringUtils::fnv1a_64(token->nameHash.name, token->nameHash.length, hash);
+
+        if (token->kind == Token::Kind::Identifier && token->nameHash.hash != nameHash)
+        {
+            if (std::find(references.begin(), references.end(), token->nameHash.hash) == references.end())
+                references.push_back(token->nameHash.hash);
+        }
+    }
+}
+
+bool Incremental::ReferencesAny(const std::vector<u32>& references, const robin_hood::unordered_map<u32, bool>& nameHashes)
+{
+    for (u32 reference : references)
+    {
+        if (nameHashes.find(reference) != nameHashes.end())
+            return true;
+    }
+
+    return false;
+}
+
+void Incremental::ParseAll(Module* module, std::vector<IncrementalDeclaration>& declarations)
+{
+    IncrementalInfo& incrementalInfo = module->incrementalInfo;
+
+    Parser::Process(module);
+    FindDeclarations(module, declarations);
+
+    robin_hood::unordered_map<u32, Declaration*> nameHashToDeclaration;
+
+    ListNode* node;
+    ListIterate(&module->parserInfo.block->scope->declarations, node)
+    {
+        Declaration* declaration = ListGetStructPtr(node, Declaration, listNode);
+        nameHashToDeclaration[declaration->token->nameHash.hash] = declaration;
+    }
+
+    for (IncrementalDeclaration& declaration : declarations)
+    {
+        declaration.declaration = nameHashToDeclaration[declaration.nameHash];
+        declaration.generation = incrementalInfo.generation;
+    }
+
+    incrementalInfo.compileAll = true;
+    incrementalInfo.changedDeclarations.clear();
+}
+
+void Incremental::ParseChanged(Module* module, std::vector<IncrementalDeclaration>& declarations)
+{
+    IncrementalInfo& incrementalInfo = module->incrementalInfo;
+    LexerInfo& lexerInfo = module->lexerInfo;
+    ParserInfo& parserInfo = module->parserInfo;
+
+    FindDeclarations(module, declarations);
+
+    robin_hood::unordered_map<u32, IncrementalDeclaration*> previousDeclarations;
+    for (IncrementalDeclaration& declaration : incrementalInfo.declarations)
+    {
+        previousDeclarations[declaration.nameHash] = &declaration;
+    }
+
+    // Names whose signature (or layout) changed, declarations that were added or removed count as changed
+    robin_hood::unordered_map<u32, bool> changedSignatures;
+    robin_hood::unordered_map<u32, u32> nameHashToLine;
+
+    for (IncrementalDeclaration& declaration : declarations)
+    {
+        Token* nameToken = &lexerInfo.tokens[declaration.firstToken + 1];
+
+        auto lineItr = nameHashToLine.find(declaration.nameHash);
+        if (lineItr != nameHashToLine.end())
+        {
+            lexerInfo.Error(nameToken, "Declaration (%.*s) has already been defined on line %u", nameToken->nameHash.length, nameToken->nameHash.name, lineItr->second);
+        }
+
+        nameHashToLine[declaration.nameHash] = nameToken->line;
+
+        auto itr = previousDeclarations.find(declaration.nameHash);
+        if (itr == previousDeclarations.end() || itr->second->signatureHash != declaration.signatureHash)
+            changedSignatures[declaration.nameHash] = true;
+    }
+
+    for (IncrementalDeclaration& declaration : incrementalInfo.declarations)
+    {
+        if (nameHashToLine.find(declaration.nameHash) == nameHashToLine.end())
+            changedSignatures[declaration.nameHash] = true;
+    }
+
+    // A signature that mentions a changed signature may have changed with it, structs nest so we repeat until nothing new is found
+    bool foundChange = true;
+    while (foundChange)
+    {
+        foundChange = false;
+
+        for (IncrementalDeclaration& declaration : declarations)
+        {
+            if (changedSignatures.find(declaration.nameHash) != changedSignatures.end())
+                continue;
+
+            if (ReferencesAny(declaration.signatureReferences, changedSignatures))
+            {
+                changedSignatures[declaration.nameHash] = true;
+                foundChange = true;
+            }
+        }
+    }
+
+    // Rebuild the Global Scope in place, reused declarations keep pointing at it as their parent
+    Compound* block = parserInfo.block;
+    Scope* globalScope = block->scope;
+
+    std::vector<Declaration*> nativeFunctions;
+
+    ListNode* node;
+    ListIterate(&globalScope->declarations, node)
+    {
+        Declaration* declaration = ListGetStructPtr(node, Declaration, listNode);
+
+        if (declaration->kind == Declaration::Kind::Function && declaration->function.flags.nativeCall)
+            nativeFunctions.push_back(declaration);
+    }
+
+    block->statements.Init();
+    globalScope->declarations.Init();
+    globalScope->scopeChildren.Init();
+
+    parserInfo.currentScope = globalScope;
+    parserInfo.currentStructScope = nullptr;
+    parserInfo.currentLoop = nullptr;
+
+    incrementalInfo.changedDeclarations.clear();
+
+    for (IncrementalDeclaration& declaration : declarations)
+    {
+        auto itr = previousDeclarations.find(declaration.nameHash);
+
+        bool isChanged = itr == previousDeclarations.end() ||
+                         itr->second->hash != declaration.hash ||
+                         changedSignatures.find(declaration.nameHash) != changedSignatures.end() ||
+                         ReferencesAny(declaration.references, changedSignatures);
+
+        if (!isChanged)
+        {
+            Declaration* reusedDeclaration = itr->second->declaration;
+
+            declaration.declaration = reusedDeclaration;
+            declaration.generation = itr->second->generation;
+
+            Parser::DeclarationPushToScope(module, reusedDeclaration, globalScope);
+            if (reusedDeclaration->kind == Declaration::Kind::Function)
+            {
+                List::AddNodeBack(&globalScope->scopeChildren, &reusedDeclaration->function.scope->listNode);
+            }
+
+            continue;
+        }
+
+        lexerInfo.tokenIndex = declaration.firstToken;
+
+        Statement* statement = nullptr;
+        Parser::TryParseDeclaration(module, statement);
+
+        if (lexerInfo.tokenIndex != declaration.lastToken)
+        {
+            lexerInfo.Error(lexerInfo.PeekToken(), "Unexpected '%s' after Declaration", Token::GetTokenKindName(lexerInfo.PeekToken()->kind));
+        }
+
+        declaration.declaration = ListGetStructPtr(globalScope->declarations.prev, Declaration, listNode);
+        declaration.generation = incrementalInfo.generation;
+
+        incrementalInfo.changedDeclarations.push_back(declaration.declaration);
+    }
+
+    for (Declaration* declaration : nativeFunctions)
+    {
+        Parser::DeclarationPushToScope(module, declaration, globalScope);
+        List::AddNodeBack(&globalScope->scopeChildren, &declaration->function.scope->listNode);
+    }
+
+    parserInfo.currentScope = nullptr;
+
+    DebugHandler::PrintSuccess("Parser : Successfully Processsed Module (%s) (Declarations: %u, Changed: %u)", module->nameHash.name.c_str(), static_cast<u32>(declarations.size()), static_cast<u32>(incrementalInfo.changedDeclarations.size()));
+}
+
+void Incremental::ReleaseSources(Module* module)
+{
+    IncrementalInfo& incrementalInfo = module->incrementalInfo;
+
+    robin_hood::unordered_map<u32, bool> usedGenerations;
+    for (IncrementalDeclaration& declaration : incrementalInfo.declarations)
+    {
+        usedGenerations[declaration.generation] = true;
+    }
+
+    for (auto itr = incrementalInfo.sources.begin(); itr != incrementalInfo.sources.end();)
+    {
+        if (usedGenerations.find(itr->generation) == usedGenerations.end())
+        {
+            // Generation 0 was compiled outside of Incremental, its buffer belongs to whoever compiled it
+            if (itr->generation > 0)
+                delete[] itr->buffer;
+
+            itr = incrementalInfo.sources.erase(itr);
+        }
+        else
+        {
+            itr++;
+        }
+    }
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include "pch/Build.h"
+#include "robin_hood.h"
+#include <vector>
+
+struct Module;
+struct Token;
+struct IncrementalDeclaration;
+
+// Recompiles a module from new source, reusing the typed trees and bytecode of every global declaration
+// whose tokens didn't change and that doesn't refer to a declaration whose signature did
+class Incremental
+{
+public:
+    // Lexes the source and parses the global declarations that changed since the last call
+    // Native functions registered on the module are carried over
+    static void Parse(Module* module, const char* source, size_t size);
+
+    // Types and generates bytecode for everything Parse found to have changed
+    static void Compile(Module* module);
+
+private:
+    static void FindDeclarations(Module* module, std::vector<IncrementalDeclaration>& declarations);
+    static void HashTokens(Module* module, u32 firstToken, u32 lastToken, u64& hash, std::vector<u32>& references);
+    static bool ReferencesAny(const std::vector<u32>& references, const robin_hood::unordered_map<u32, bool>& nameHashes);
+
+    static void ParseAll(Module* module, std::vector<IncrementalDeclaration>& declarations);
+    static void ParseChanged(Module* module, std::vector<IncrementalDeclaration>& declarations);
+    static void ReleaseSources(Module* module);
+};
@@ -1,7 +1,10 @@
 #include "pch/Build.h"
 #include "Module.h"
+#include "NativeBinding.h"
 #include <Compiler/Frontend/Typer.h>
 #include <Compiler/Frontend/Parser.h>
+#include <Compiler/Frontend/TypeTable.h>
+#include <Compiler/Backend/Bytecode/Interpreter.h>
 
 LexerInfo& LexerInfo::operator=(const LexerInfo& a)
 {
@@ -12,20 +15,33 @@ LexerInfo& LexerInfo::operator=(const LexerInfo& a)
     return *this;
 }
 
-NativeFunction::NativeFunction(Module* module, const String& inName, std::function<NativeFunctionCallbackFunc> callback)
+NativeFunction::NativeFunction(Module* module, const String& inName, NativeFunctionCallbackFunc* callback)
 {
     name = inName;
 
     _module = module;
+    _nameHash = StringUtils::hash_djb2(name.c_str(), static_cast<i32>(name.length()));
+
+    // Parameters are added to the layout as they are added to the signature
+    NativeFunctionBinding& binding = _module->_nativeFunctionHashToBinding[_nameHash];
+    binding.callback = callback;
+    binding.parameters.clear();
+
+    // Modules loaded from a bytecode image already know the signature from their native import table, we only bind the callback and the parameter layout
+    if (_module->bytecodeInfo.image)
+        return;
+
     _declaration = new Declaration();
     _declaration->kind = Declaration::Kind::Function;
     _declaration->type = Type::CreateFunction();
 
     // Create Token
     {
+        const std::string& tokenName = AddName(name);
+
         Token* token = new Token();
         token->kind = Token::Kind::Identifier;
-        token->nameHash.SetNameHash(name.c_str(), name.length());
+        token->nameHash.SetNameHash(tokenName.c_str(), tokenName.length());
         token->number = 0;
 
         _declaration->token = token;
@@ -33,6 +49,10 @@ NativeFunction::NativeFunction(Module* module, const String& inName, std::functi
 
     Function* function = &_declaration->function;
     function->flags.nativeCall = true;
+    function->flags.alwaysInline = false;
+    function->flags.neverInline = true;
+    function->flags.unreachable = false;
+    function->flags.intrinsic = false;
 
     // Create Scope
     {
@@ -48,7 +68,7 @@ NativeFunction::NativeFunction(Module* module, const String& inName, std::functi
 
     // Set Return Type
     {
-        function->returnType = Type::Create(Type::Kind::Void);
+        function->returnType = Type_Void;
     }
 
     // Create Dummy Body
@@ -75,8 +95,6 @@ NativeFunction::NativeFunction(Module* module, const String& inName, std::functi
         }
         _module->parserInfo.currentScope = nullptr;
     }
-
-    _module->_nativeFunctionHashToCallback[_declaration->token->nameHash.hash] = callback;
 }
 
 void NativeFunction::AddParamChar(const String& inName, PassAs passAs)
@@ -181,11 +199,14 @@ void NativeFunction::SetReturnTypeU64(PassAs passAs)
 
 void NativeFunction::SetReturnTypeUnknown(const String& inName, PassAs passAs)
 {
+    if (!_declaration)
+        return;
+
     Type* type = Type::Create(Type::Kind::Unknown);
 
     // Setup Token
     {
-        returnName = inName;
+        const std::string& returnName = AddName(inName);
 
         type->unknown.token = new Token();
         type->unknown.token->kind = Token::Kind::Identifier;
@@ -196,14 +217,52 @@ void NativeFunction::SetReturnTypeUnknown(const String& inName, PassAs passAs)
     SetReturnType(type, passAs);
 }
 
+void MemCopyCallback(u8* destination, u8* source, u64 size)
+{
+    memmove(destination, source, size);
+}
+
+void MemSetCallback(u8* destination, u8 value, u64 size)
+{
+    memset(destination, value, size);
+}
+
+void NativeFunction::AddIntrinsics(Module* module)
+{
+    NativeFunction nfMemCopy = Bind<&MemCopyCallback>(module, "MemCopy", { "destination", "source", "size" });
+    nfMemCopy.SetIntrinsic();
+
+    NativeFunction nfMemSet = Bind<&MemSetCallback>(module, "MemSet", { "destination", "value", "size" });
+    nfMemSet.SetIntrinsic();
+}
+
+const std::string& NativeFunction::AddName(const String& inName)
+{
+    return _module->_nativeNames.emplace_back(inName);
+}
+
+void NativeFunction::SetIntrinsic()
+{
+    if (!_declaration)
+        return;
+
+    _declaration->function.flags.intrinsic = true;
+}
+
 void NativeFunction::TryAddParam(const String& inName, Type* type, PassAs passAs)
 {
+    std::vector<NativeParameterLocation>& parameters = _module->_nativeFunctionHashToBinding[_nameHash].parameters;
+    parameters.push_back(NativeParameterLocation::Get(static_cast<u32>(parameters.size())));
+
+    if (!_declaration)
+        return;
+
     Declaration* declaration = new Declaration();
     declaration->kind = Declaration::Kind::Variable;
 
     // Setup Token
     {
-        std::string& paramName = _paramNames.emplace_back(inName);
+        const std::string& paramName = AddName(inName);
 
         Token* token = new Token();
         token->kind = Token::Kind::Identifier;
@@ -215,9 +274,7 @@ void NativeFunction::TryAddParam(const String& inName, Type* type, PassAs passAs
 
     if (passAs == PassAs::Pointer)
     {
-        Type* ptrType = Type::CreatePointer();
-        ptrType->pointer.type = type;
-        declaration->type = ptrType;
+        declaration->type = TypeTable::GetPointer(type);
     }
     else
     {
@@ -238,11 +295,12 @@ void NativeFunction::TryAddParam(const String& inName, Type* type, PassAs passAs
 
 void NativeFunction::SetReturnType(Type* type, PassAs passAs)
 {
+    if (!_declaration)
+        return;
+
     if (passAs == PassAs::Pointer)
     {
-        Type* ptrType = Type::CreatePointer();
-        ptrType->pointer.type = type;
-        _declaration->function.returnType = ptrType;
+        _declaration->function.returnType = TypeTable::GetPointer(type);
     }
     else
     {
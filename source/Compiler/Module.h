@@ -2,16 +2,25 @@
 #include "pch/Build.h"
 #include "robin_hood.h"
 #include <vector>
+#include <deque>
 #include <filesystem>
 #include <functional>
+#include <initializer_list>
 
 #include "Token.h"
 #include "Import.h"
 #include "Tree.h"
 #include "Backend/Bytecode/ByteOpcode.h"
+#include "Backend/Bytecode/CodeBuffer.h"
 #include "Utils/NameHash.h"
 #include "Utils/StringTable.h"
 
+class MappedFile;
+class ExecutableMemory;
+struct IRFunction;
+struct IRBlock;
+struct IRInstruction;
+
 struct LexerInfo
 {
 public:
@@ -170,14 +179,88 @@ public:
     Loop* currentLoop = nullptr;
 };
 
-struct TyperInfo
+struct TyperContext
 {
 public:
     Scope* currentScope = nullptr;
     Struct* currentStruct = nullptr;
 
-    bool typeResolved = true;
-    bool unresolvedTypes = true;
+    // State for the declaration currently being typed
+    bool unresolvedTypes = false;
+    std::vector<Declaration*> dependencies;
+};
+
+struct TyperInfo
+{
+public:
+    // Context for the serial stage, function bodies are typed on worker threads with their own context
+    TyperContext context;
+
+    // Global declarations waiting to be typed, each maps to the declarations waiting on it
+    std::vector<Declaration*> worklist;
+    robin_hood::unordered_map<Declaration*, std::vector<Declaration*>> pendingDeclarations;
+};
+
+struct FolderLocal
+{
+public:
+    u32 numAssignments = 0;
+    bool isAddressTaken = false;
+    bool isReadBeforeAssigned = false;
+
+    // Set once the only assignment to the local has folded down to a number
+    bool isConstant = false;
+    u64 value = 0;
+};
+
+struct FolderContext
+{
+public:
+    // Locals declared in the body of the function being folded, parameters are never propagated
+    robin_hood::unordered_map<Declaration*, FolderLocal> locals;
+    u32 numFolded = 0;
+};
+
+struct IRBuilderContext
+{
+public:
+    IRFunction* function = nullptr;
+    IRBlock* currentBlock = nullptr;
+
+    // Parameters and locals whose address is taken stay in the frame, everything else is an SSA value
+    robin_hood::unordered_map<Declaration*, bool> addressTaken;
+
+    // SSA construction state, indexed by block id
+    std::vector<robin_hood::unordered_map<Declaration*, IRInstruction*>> definitions;
+    std::vector<std::vector<std::pair<Declaration*, IRInstruction*>>> incompletePhis;
+    std::vector<bool> isSealed;
+
+    // Targets of continue and break in the loops we are currently in
+    std::vector<IRBlock*> continueBlocks;
+    std::vector<IRBlock*> breakBlocks;
+
+    // Cleared when the function uses something the IR can't express, Bytecode then generates it from the tree
+    bool isSupported = true;
+};
+
+struct ReachabilityInfo
+{
+public:
+    // Name hashes of the functions the host calls into, with none every function is kept
+    std::vector<u32> entryPoints;
+};
+
+struct IRInfo
+{
+public:
+    // Set by the driver, the IR is opt in until it covers everything Bytecode does
+    bool isEnabled = false;
+
+    // Functions in here are lowered from their IR instead of their tree
+    robin_hood::unordered_map<Declaration*, IRFunction*> functions;
+
+    // Hashes of the functions whose body was inlined into a function, it has to be optimized again when one of them changes
+    robin_hood::unordered_map<Declaration*, std::vector<u32>> inlinedCallees;
 };
 
 struct FunctionMemoryInfo
@@ -186,20 +269,94 @@ struct FunctionMemoryInfo
     u32 numInstructionBytes = 0;
 
     u32 cleanupAddress = 0;
+    u32 frameSize = 0;
+    bool isNative = false;
+
+    // Set by BytecodeVerifier, how far below and above Rsp at entry the function touches the stack
+    u32 maxStackDepth = 0;
+    u32 maxStackRise = 0;
+
+    // Set by the Jit, the function's machine code or nullptr when it runs in the Interpreter
+    const u8* jitCode = nullptr;
+
+    // Calls and loop iterations counted by the Interpreter, see JitInfo::isTiered
+    u32 hotness = 0;
 };
 
 struct FunctionParamInfo
 {
-    std::vector<Declaration*> declarations;
+    // Frame offset of each parameter, in declaration order
+    std::vector<i64> parameterOffsets;
     u32 extraParameterStackSpace = 0;
 };
 
-struct BytecodeInfo
+struct BlockJump
 {
 public:
-    Function* currentFunction;
+    PatchPoint jump;
+    IRBlock* block;
+};
+
+// Value a predecessor writes into a Phi, taken from the register it was parked in when the copies form a cycle
+struct PhiCopy
+{
+public:
+    IRInstruction* phi;
+    IRInstruction* source;
+    Register sourceRegister;
+};
+
+struct BytecodeContext
+{
+public:
+    Function* currentFunction = nullptr;
+    Loop* currentLoop = nullptr;
+
+    FunctionMemoryInfo* memoryInfo = nullptr;
+    FunctionParamInfo* paramInfo = nullptr;
+
+    CodeBuffer opcodes;
+
+    // Filled by the RegisterAllocator, locals that aren't in here live in the frame
+    robin_hood::unordered_map<Declaration*, Register> localRegisters;
+    std::vector<Register> savedRegisters;
+
+    // Same for the values of a function lowered from its IR, indexed by IRInstruction::id, values without one live in their slot
+    std::vector<Register> valueRegisters;
 
+    // Size of the variables (and IR slots) below Rbp, the saved registers are pushed right past them
+    u64 frameSize = 0;
+
+    // For every call, a mask of the parameter registers (Rcx, Rdx, R8, R9) that are read after it returns
+    robin_hood::unordered_map<Expression*, u8> liveParameters;
+
+    // Parameter registers already holding an argument of a call whose arguments we are still generating
+    u8 pendingArguments = 0;
+
+    // Set when an address into our frame may be held by someone else, the frame then has to outlive every call so none of them is a tail call
+    bool isFrameAddressTaken = false;
+
+    // Binary expressions holding a value in a temporary register, past RegisterAllocator::NumTemporaryRegisters they are pushed instead
+    u32 numTemporaries = 0;
+
+    // Set when the function is lowered from its IR, jumps to blocks that haven't been placed yet are patched afterwards
+    IRFunction* irFunction = nullptr;
+    std::vector<BlockJump> blockJumps;
+
+    // Strings are added to the module's StringTable when linking, so their indices don't depend on which thread finished first
+    // Until then CreateStringOnHeap::strIndex is an index into this list
+    std::vector<String*> strings;
+    std::vector<size_t> stringOpcodeIndices;
+};
+
+struct BytecodeInfo
+{
+public:
+    // Every function's instructions, concatenated in declaration order
     std::vector<u8> opcodes;
+
+    // Code replaced by a recompile, kept alive until no running frame can be executing it
+    std::vector<std::vector<u8>> retiredOpcodes;
     StringTable stringTable;
 
     robin_hood::unordered_map<u32, u32> hashNameToDataIndex;
@@ -207,11 +364,94 @@ public:
     robin_hood::unordered_map<u32, FunctionMemoryInfo> functionHashToMemoryInfo;
     robin_hood::unordered_map<u32, FunctionParamInfo> functionHashToParamInfo;
     robin_hood::unordered_map<u32, u64> stringIndexToHeapAddress;
+
+    // Set before Bytecode runs to keep the comment of every generated instruction, offsets are relative to the start of the function
+    bool recordComments = false;
+    robin_hood::unordered_map<u32, std::vector<CodeComment>> functionHashToComments;
+
+    // Set when the module was loaded from a bytecode image, instructions then point into the mapping
+    MappedFile* image = nullptr;
+
+    // Set when BytecodeVerifier accepted every function, the Interpreter then skips its per instruction stack checks
+    bool isVerified = false;
+};
+
+struct IncrementalDeclaration
+{
+public:
+    u32 nameHash = 0;
+    Declaration* declaration = nullptr;
+
+    // The source generation this declaration was parsed from
+    u32 generation = 0;
+
+    // Token range [firstToken, lastToken) in the current source
+    u32 firstToken = 0;
+    u32 lastToken = 0;
+
+    // Hash of the tokens up to the body, structs hash all of their tokens here
+    u64 signatureHash = 0;
+    u64 hash = 0;
+
+    // Name hashes of the identifiers used by the signature and by the whole declaration
+    std::vector<u32> signatureReferences;
+    std::vector<u32> references;
+};
+
+struct IncrementalSource
+{
+public:
+    u32 generation = 0;
+    char* buffer = nullptr;
+    std::vector<Token> tokens;
+};
+
+struct IncrementalInfo
+{
+public:
+    u32 generation = 0;
+    bool compileAll = true;
+
+    // Global declarations of the current source, in source order
+    std::vector<IncrementalDeclaration> declarations;
+    std::vector<Declaration*> changedDeclarations;
+
+    // Older sources that reused declarations still point into
+    std::vector<IncrementalSource> sources;
 };
 
 struct Module;
 class Interpreter;
 typedef void NativeFunctionCallbackFunc(Interpreter* interpreter);
+
+// What a call to a native function needs, the parameter layout is worked out when the native is bound so the callback reads an argument without any lookups
+struct NativeFunctionBinding
+{
+public:
+    NativeFunctionCallbackFunc* callback = nullptr;
+    std::vector<NativeParameterLocation> parameters;
+};
+
+// Runs the machine code of a function on the Interpreter's registers and memory
+typedef void JitEnterFunc(Interpreter* interpreter, u64* registers, u8* memory, const u8* code);
+struct JitInfo
+{
+public:
+    // Set by the driver, functions the Jit can't translate run in the Interpreter
+    bool isEnabled = false;
+
+    // Functions start in the Interpreter and are translated once their hotness reaches the threshold, which keeps startup fast
+    bool isTiered = false;
+    u32 promotionThreshold = 1000;
+
+    // One block for the whole module, or one per promoted function when tiered
+    std::vector<ExecutableMemory*> code;
+    JitEnterFunc* enter = nullptr;
+
+    // Code replaced by a reload, kept alive until no running frame can be executing it
+    std::vector<ExecutableMemory*> retiredCode;
+};
+
 struct NativeFunction
 {
 public:
@@ -222,7 +462,12 @@ public:
     };
 
 public:
-    NativeFunction(Module* module, const String& name, std::function<NativeFunctionCallbackFunc> callback);
+    NativeFunction(Module* module, const String& name, NativeFunctionCallbackFunc* callback);
+
+    // Derives the Nai signature from the signature of Function, calls go through a thunk that reads each argument straight from its register or stack slot
+    // Names the parameters after paramNames, defined in NativeBinding.h
+    template <auto Function>
+    static NativeFunction Bind(Module* module, const String& name, std::initializer_list<const char*> paramNames = {});
 
     void AddParamChar(const String& name, PassAs passAs);
     void AddParamBool(const String& name, PassAs passAs);
@@ -247,16 +492,23 @@ public:
     void SetReturnTypeU64(PassAs passAs);
     void SetReturnTypeUnknown(const String& name, PassAs passAs);
 
+    // MemCopy(destination, source, size) and MemSet(destination, value, size), calls to them compile to a single MemCopy or MemSet opcode
+    // The callbacks are only there for hosts that call them through the Interpreter
+    static void AddIntrinsics(Module* module);
+
 private:
     void TryAddParam(const String& name, Type* type, PassAs passAs);
     void SetReturnType(Type* type, PassAs passAs);
+    void SetIntrinsic();
+
+    // Tokens only view their name, the module keeps the ones made up here alive after the NativeFunction is gone
+    const std::string& AddName(const String& name);
 
 private:
     std::string name;
-    std::string returnName;
-    std::vector<std::string> _paramNames;
 
     u32 _numParameters = 0;
+    u32 _nameHash = 0;
     Module* _module = nullptr;
     Declaration* _declaration = nullptr;
 };
@@ -269,8 +521,12 @@ public:
 
     LexerInfo lexerInfo;
     ParserInfo parserInfo;
+    ReachabilityInfo reachabilityInfo;
     TyperInfo typerInfo;
+    IRInfo irInfo;
     BytecodeInfo bytecodeInfo;
+    JitInfo jitInfo;
+    IncrementalInfo incrementalInfo;
 
     std::vector<Import> imports;
     std::vector<ImportAlias> importAliases;
@@ -279,5 +535,8 @@ public:
     robin_hood::unordered_map<u32, u32> importPathHashToAliasIndex;
     robin_hood::unordered_map<u32, u32> importAliasToImportIndex;
 
-    robin_hood::unordered_map<u32, std::function<NativeFunctionCallbackFunc>> _nativeFunctionHashToCallback;
+    robin_hood::unordered_map<u32, NativeFunctionBinding> _nativeFunctionHashToBinding;
+
+    // Names viewed by the tokens of native declarations, a deque so adding one doesn't move the others
+    std::deque<std::string> _nativeNames;
 };
\ No newline at end of file
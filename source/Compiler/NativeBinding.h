@@ -0,0 +1,148 @@
+#pragma once
+#include "pch/Build.h"
+#include "Module.h"
+#include "Frontend/Typer.h"
+#include "Backend/Bytecode/Interpreter.h"
+
+#include <cstring>
+#include <initializer_list>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+// Nai type of a parameter or return type of a bound C++ function, pointers point into the Interpreter's memory
+template <typename T>
+struct NativeType
+{
+    static_assert(sizeof(T) == 0, "NativeFunction::Bind : Unsupported parameter or return type");
+};
+
+template <> struct NativeType<char> { static Type* Get() { return Type_Char; } };
+template <> struct NativeType<bool> { static Type* Get() { return Type_Bool; } };
+template <> struct NativeType<i8> { static Type* Get() { return Type_I8; } };
+template <> struct NativeType<i16> { static Type* Get() { return Type_I16; } };
+template <> struct NativeType<i32> { static Type* Get() { return Type_I32; } };
+template <> struct NativeType<i64> { static Type* Get() { return Type_I64; } };
+template <> struct NativeType<u8> { static Type* Get() { return Type_U8; } };
+template <> struct NativeType<u16> { static Type* Get() { return Type_U16; } };
+template <> struct NativeType<u32> { static Type* Get() { return Type_U32; } };
+template <> struct NativeType<u64> { static Type* Get() { return Type_U64; } };
+
+template <typename T>
+struct NativeType<T*>
+{
+    static Type* Get() { return NativeType<std::remove_cv_t<T>>::Get(); }
+};
+
+template <typename R, typename... Args>
+struct NativeBinding
+{
+public:
+    using Return = R;
+    static constexpr u32 NumParameters = sizeof...(Args);
+
+    template <R(*Function)(Args...)>
+    static void Thunk(Interpreter* interpreter)
+    {
+        Call<Function>(interpreter, std::index_sequence_for<Args...>());
+    }
+
+    // One extra entry at the end, so functions without parameters don't declare empty arrays
+    static void GetParameterTypes(Type** types, NativeFunction::PassAs* passAs)
+    {
+        Type* parameterTypes[] = { NativeType<Args>::Get()..., nullptr };
+        NativeFunction::PassAs parameterPassAs[] = { GetPassAs<Args>()..., NativeFunction::PassAs::Value };
+
+        memcpy(types, parameterTypes, sizeof(parameterTypes));
+        memcpy(passAs, parameterPassAs, sizeof(parameterPassAs));
+    }
+
+    template <typename T>
+    static constexpr NativeFunction::PassAs GetPassAs()
+    {
+        return std::is_pointer_v<T> ? NativeFunction::PassAs::Pointer : NativeFunction::PassAs::Value;
+    }
+
+private:
+    template <R(*Function)(Args...), size_t... Indices>
+    static void Call(Interpreter* interpreter, std::index_sequence<Indices...>)
+    {
+        if constexpr (std::is_void_v<R>)
+        {
+            Function(ReadArgument<Args, Indices>(interpreter)...);
+        }
+        else
+        {
+            R result = Function(ReadArgument<Args, Indices>(interpreter)...);
+            u64* rax = interpreter->GetRegister(Register::Rax);
+
+            if constexpr (std::is_pointer_v<R>)
+            {
+                *rax = static_cast<u64>(reinterpret_cast<const u8*>(result) - interpreter->GetMemory());
+            }
+            else
+            {
+                *rax = static_cast<u64>(result);
+            }
+        }
+    }
+
+    template <typename T, size_t Index>
+    static T ReadArgument(Interpreter* interpreter)
+    {
+        constexpr NativeParameterLocation Location = NativeParameterLocation::Get(Index);
+        u64 value = 0;
+
+        if constexpr (Location.reg != Register::None)
+        {
+            value = *interpreter->GetRegister(Location.reg);
+        }
+        else
+        {
+            u64 address = *interpreter->GetRegister(Register::Rsp) + Location.stackOffset;
+            memcpy(&value, &interpreter->GetMemory()[address], sizeof(u64));
+        }
+
+        if constexpr (std::is_pointer_v<T>)
+        {
+            return reinterpret_cast<T>(&interpreter->GetMemory()[value]);
+        }
+        else
+        {
+            T argument;
+            memcpy(&argument, &value, sizeof(T));
+            return argument;
+        }
+    }
+};
+
+template <typename R, typename... Args>
+NativeBinding<R, Args...> GetNativeBinding(R(*)(Args...));
+
+template <auto Function>
+NativeFunction NativeFunction::Bind(Module* module, const String& name, std::initializer_list<const char*> paramNames)
+{
+    using Binding = decltype(GetNativeBinding(Function));
+
+    NativeFunction nativeFunction(module, name, &Binding::template Thunk<Function>);
+
+    Type* types[Binding::NumParameters + 1];
+    PassAs passAs[Binding::NumParameters + 1];
+    Binding::GetParameterTypes(types, passAs);
+
+    // Parameters without a name are only ever shown in errors, so a generated one does
+    const char* const* names = paramNames.begin();
+    for (u32 i = 0; i < Binding::NumParameters; i++)
+    {
+        std::string paramName = i < paramNames.size() ? names[i] : "param" + std::to_string(i + 1);
+        nativeFunction.TryAddParam(paramName, types[i], passAs[i]);
+    }
+
+    using Return = typename Binding::Return;
+    if constexpr (!std::is_void_v<Return>)
+    {
+        nativeFunction.SetReturnType(NativeType<Return>::Get(), Binding::template GetPassAs<Return>());
+    }
+
+    return nativeFunction;
+}
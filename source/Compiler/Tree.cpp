@@ -37,6 +37,16 @@ Type* Type::CreateBasic(u32 size, u32 alignment, bool isResolved, bool isSigned)
     return type;
 }
 
+Type* Type::CreateVoid()
+{
+    Type* type = Create(Type::Kind::Void);
+    type->size = 0;
+    type->alignment = 0;
+    type->isResolved = true;
+
+    return type;
+}
+
 Type* Type::CreatePointer()
 {
     Type* type = Create(Type::Kind::Pointer);
@@ -58,7 +68,9 @@ Type* Type::CreateStruct()
 Type* Type::CreateFunction()
 {
     Type* type = Create(Type::Kind::Function);
-    type->function.argumentTypes.Init();
+    type->function.returnType = nullptr;
+    type->function.argumentTypes = nullptr;
+    type->function.numArgumentTypes = 0;
 
     return type;
 }
@@ -166,6 +178,8 @@ const char* BinaryKindNames[] =
     "<=",
     ">",
     ">=",
+    "&&",
+    "||",
     "="
 };
 
@@ -69,6 +69,8 @@ public:
         LessEqual,
         GreaterThan,
         GreaterEqual,
+        LogicalAnd,
+        LogicalOr,
         Assign,
         Count
     };
@@ -222,7 +224,9 @@ public:
 
 struct FunctionType
 {
-    List argumentTypes;
+    Type* returnType;
+    Type** argumentTypes;
+    u32 numArgumentTypes;
 };
 
 struct Type
@@ -257,8 +261,6 @@ public:
     u32 alignment;
     bool isResolved = false;
 
-    ListNode listNode;
-
 public:
     bool IsSigned();
     bool IsBasic();
@@ -267,6 +269,7 @@ public:
 public:
     static Type* Create(Kind kind);
     static Type* CreateBasic(u32 size, u32 alignment, bool isResolved, bool isSigned);
+    static Type* CreateVoid();
     static Type* CreatePointer();
     static Type* CreateStruct();
     static Type* CreateFunction();
@@ -373,6 +376,16 @@ public:
     struct
     {
         u8 nativeCall : 1;
+
+        // Set with the #inline and #no_inline directives, functions with neither are left to the Optimizer's cost model
+        u8 alwaysInline : 1;
+        u8 neverInline : 1;
+
+        // Set by Reachability when no entry point calls into the function, its body is never typed or generated
+        u8 unreachable : 1;
+
+        // Natives Bytecode replaces with an opcode instead of calling, see NativeFunction::AddIntrinsics
+        u8 intrinsic : 1;
     } flags;
 
     ListNode listNode;
@@ -0,0 +1,101 @@
+#include <pch/Build.h>
+#include "ExecutableMemory.h"
+
+#include <cstring>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+bool ExecutableMemory::Assign(const u8* code, size_t size)
+{
+    Release();
+
+    size_t pageSize = GetPageSize();
+    size_t allocationSize = ((size + pageSize - 1) / pageSize) * pageSize;
+
+    void* data = VirtualAlloc(nullptr, allocationSize, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+    if (!data)
+        return false;
+
+    memcpy(data, code, size);
+
+    DWORD oldProtection = 0;
+    if (!VirtualProtect(data, allocationSize, PAGE_EXECUTE_READ, &oldProtection))
+    {
+        VirtualFree(data, 0, MEM_RELEASE);
+        return false;
+    }
+
+    FlushInstructionCache(GetCurrentProcess(), data, allocationSize);
+
+    _data = static_cast<u8*>(data);
+    _size = allocationSize;
+
+    return true;
+}
+
+void ExecutableMemory::Release()
+{
+    if (_data)
+    {
+        VirtualFree(_data, 0, MEM_RELEASE);
+    }
+
+    _data = nullptr;
+    _size = 0;
+}
+
+size_t ExecutableMemory::GetPageSize()
+{
+    SYSTEM_INFO systemInfo;
+    GetSystemInfo(&systemInfo);
+
+    return static_cast<size_t>(systemInfo.dwPageSize);
+}
+#else
+bool ExecutableMemory::Assign(const u8* code, size_t size)
+{
+    Release();
+
+    size_t pageSize = GetPageSize();
+    size_t allocationSize = ((size + pageSize - 1) / pageSize) * pageSize;
+
+    void* data = mmap(nullptr, allocationSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (data == MAP_FAILED)
+        return false;
+
+    memcpy(data, code, size);
+
+    if (mprotect(data, allocationSize, PROT_READ | PROT_EXEC) != 0)
+    {
+        munmap(data, allocationSize);
+        return false;
+    }
+
+    _data = static_cast<u8*>(data);
+    _size = allocationSize;
+
+    return true;
+}
+
+void ExecutableMemory::Release()
+{
+    if (_data)
+    {
+        munmap(_data, _size);
+    }
+
+    _data = nullptr;
+    _size = 0;
+}
+
+size_t ExecutableMemory::GetPageSize()
+{
+    return static_cast<size_t>(sysconf(_SC_PAGESIZE));
+}
+#endif
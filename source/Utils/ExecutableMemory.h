@@ -0,0 +1,27 @@
+#pragma once
+#include <pch/Build.h>
+
+// Pages holding generated machine code, they are written once and never writable and executable at the same time
+class ExecutableMemory
+{
+public:
+    ExecutableMemory() { }
+    ~ExecutableMemory() { Release(); }
+
+    ExecutableMemory(const ExecutableMemory&) = delete;
+    ExecutableMemory& operator=(const ExecutableMemory&) = delete;
+
+    // Copies the code into fresh pages and makes them executable
+    bool Assign(const u8* code, size_t size);
+    void Release();
+
+    u8* GetData() const { return _data; }
+    size_t GetSize() const { return _size; }
+
+private:
+    static size_t GetPageSize();
+
+private:
+    u8* _data = nullptr;
+    size_t _size = 0;
+};
@@ -2,30 +2,45 @@
 #include <iostream>
 #include <fstream>
 
+// Loads a source file into a NUL terminated buffer, the Lexer relies on the terminator to find the end of the file
+// Tokens view the buffer for as long as the module lives, so it is read into memory we own rather than mapped, an edit to the file can't change it under them
 class FileReader
 {
 public:
-    FileReader(std::string path, std::string fileName) : _path(path), _fileName(fileName) 
+    FileReader(std::string path, std::string fileName) : _path(path), _fileName(fileName)
     {
         ZoneScoped;
     }
+    ~FileReader()
+    {
+        delete[] _buffer;
+    }
+
+    FileReader(const FileReader&) = delete;
+    FileReader& operator=(const FileReader&) = delete;
 
     bool Fetch()
     {
         ZoneScoped;
-        fopen_s(&_fileStream, _path.c_str(), "r");
 
-        fseek(_fileStream, 0, SEEK_END);
-        unsigned long size = ftell(_fileStream);
-        rewind(_fileStream);
-
-        _buffer = new char[sizeof(char) * size];
-        if (!_buffer)
+        FILE* fileStream = nullptr;
+#ifdef _WIN32
+        fopen_s(&fileStream, _path.c_str(), "rb");
+#else
+        fileStream = fopen(_path.c_str(), "rb");
+#endif
+        if (!fileStream)
             return false;
 
-        _length = fread(_buffer, 1, size, _fileStream);
+        fseek(fileStream, 0, SEEK_END);
+        unsigned long size = ftell(fileStream);
+        rewind(fileStream);
+
+        _buffer = new char[sizeof(char) * (size + 1)];
+        _length = fread(_buffer, 1, size, fileStream);
+        _buffer[_length] = 0;
 
-        fclose(_fileStream);
+        fclose(fileStream);
         return true;
     }
 
@@ -36,8 +51,6 @@ public:
     size_t Length() { return _length; }
 
 private:
-    FILE* _fileStream;
-
     std::string _path;
     std::string _fileName;
 
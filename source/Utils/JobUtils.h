@@ -0,0 +1,56 @@
+#pragma once
+#include <pch/Build.h>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace JobUtils
+{
+    inline u32 GetNumWorkers(size_t numJobs)
+    {
+        u32 numThreads = std::max(std::thread::hardware_concurrency(), 1u);
+        return static_cast<u32>(std::min<size_t>(numThreads, numJobs));
+    }
+
+    // Calls job(index) for every index in [0, numJobs), spread over the available hardware threads
+    // The calling thread takes part in the work and returns once every job has finished
+    template <typename Job>
+    inline void ParallelFor(size_t numJobs, const Job& job)
+    {
+        u32 numWorkers = GetNumWorkers(numJobs);
+        if (numWorkers <= 1)
+        {
+            for (size_t i = 0; i < numJobs; i++)
+            {
+                job(i);
+            }
+
+            return;
+        }
+
+        std::atomic<size_t> nextJob = 0;
+        auto worker = [&]()
+        {
+            for (size_t i = nextJob++; i < numJobs; i = nextJob++)
+            {
+                job(i);
+            }
+        };
+
+        std::vector<std::thread> threads;
+        threads.reserve(numWorkers - 1);
+
+        for (u32 i = 1; i < numWorkers; i++)
+        {
+            threads.emplace_back(worker);
+        }
+
+        worker();
+
+        for (std::thread& thread : threads)
+        {
+            thread.join();
+        }
+    }
+}
@@ -0,0 +1,106 @@
+#include <pch/Build.h>
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+bool MappedFile::Open(const std::string& path)
+{
+    Close();
+
+    HANDLE fileHandle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (fileHandle == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(fileHandle, &fileSize) || fileSize.QuadPart == 0)
+    {
+        CloseHandle(fileHandle);
+        return false;
+    }
+
+    HANDLE mappingHandle = CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mappingHandle)
+    {
+        CloseHandle(fileHandle);
+        return false;
+    }
+
+    void* data = MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+    if (!data)
+    {
+        CloseHandle(mappingHandle);
+        CloseHandle(fileHandle);
+        return false;
+    }
+
+    _fileHandle = fileHandle;
+    _mappingHandle = mappingHandle;
+    _data = static_cast<u8*>(data);
+    _size = static_cast<size_t>(fileSize.QuadPart);
+
+    return true;
+}
+
+void MappedFile::Close()
+{
+    if (_data)
+    {
+        UnmapViewOfFile(_data);
+        CloseHandle(_mappingHandle);
+        CloseHandle(_fileHandle);
+    }
+
+    _data = nullptr;
+    _size = 0;
+    _fileHandle = nullptr;
+    _mappingHandle = nullptr;
+}
+#else
+bool MappedFile::Open(const std::string& path)
+{
+    Close();
+
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) != 0 || fileStat.st_size == 0)
+    {
+        close(fd);
+        return false;
+    }
+
+    void* data = mmap(nullptr, static_cast<size_t>(fileStat.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+
+    // The mapping keeps its own reference to the file
+    close(fd);
+
+    if (data == MAP_FAILED)
+        return false;
+
+    _data = static_cast<u8*>(data);
+    _size = static_cast<size_t>(fileStat.st_size);
+
+    return true;
+}
+
+void MappedFile::Close()
+{
+    if (_data)
+    {
+        munmap(_data, _size);
+    }
+
+    _data = nullptr;
+    _size = 0;
+}
+#endif
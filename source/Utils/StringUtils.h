@@ -79,6 +79,20 @@ namespace StringUtils
     {
         return ((count ? fnv1a_32(s, count - 1) : 2166136261u) ^ s[count]) * 16777619u;
     }
+
+    // FNV-1a 64bit hashing algorithm, pass a previous result as hash to keep hashing into it
+    inline uint64_t fnv1a_64(const void* data, std::size_t count, uint64_t hash = 14695981039346656037ull)
+    {
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+
+        for (std::size_t i = 0; i < count; i++)
+        {
+            hash ^= bytes[i];
+            hash *= 1099511628211ull;
+        }
+
+        return hash;
+    }
 }
 
 constexpr unsigned int operator"" _h(char const* s, std::size_t count)
@@ -106,23 +106,88 @@ void PrintCallback(Interpreter* interpreter)
     PrintWithArgs(interpreter, format, static_cast<u32>(strlen(format)));
 }
 
-void AddCallback(Interpreter* interpreter)
+u32 AddCallback(u32 num1, u32 num2)
 {
-    u32* num1 = interpreter->GetParameter<u32>(1);
-    u32* num2 = interpreter->GetParameter<u32>(2);
-    u32 result = *num1 + *num2;
+    return num1 + num2;
+}
+
+void AddNativeFunctions(Module* module)
+{
+    NativeFunction::AddIntrinsics(module);
+
+    //NativeFunction nfTest(module, "Test", TestCallback);
+    NativeFunction nfPrint(module, "print", PrintCallback);
+    {
+        nfPrint.AddParamChar("string", NativeFunction::PassAs::Pointer);
+    }
+
+    NativeFunction::Bind<&AddCallback>(module, "Add", { "num1", "num2" });
+}
+
+void RunEntryPoint(Module* module, u32 functionHash)
+{
+    Interpreter* interpreter = new Interpreter();
+
+    // Record Time
+    {
+        std::chrono::high_resolution_clock::time_point t1 = std::chrono::high_resolution_clock::now();
+        // Run Main
+        {
+            interpreter->Init();
+            interpreter->Interpret(module, functionHash);
+        }
+        std::chrono::high_resolution_clock::time_point t2 = std::chrono::high_resolution_clock::now();
+        std::chrono::duration<double> time_span = std::chrono::duration_cast<std::chrono::duration<double>>(t2 - t1);
+
+        // Print Time
+        DebugHandler::PrintSuccess("Interpreter : Finished in %f seconds", time_span.count());
+    }
+}
+
+int RunLoadedImage(Module* module)
+{
+    AddNativeFunctions(module);
+    Jit::Process(module);
+
+    // The image has no declarations left to check the signature of main against, the compiler did that before saving it
+    u32 mainHash = "main"_djb2;
+
+    auto itr = module->bytecodeInfo.functionHashToMemoryInfo.find(mainHash);
+    if (itr == module->bytecodeInfo.functionHashToMemoryInfo.end() || itr->second.isNative)
+    {
+        DebugHandler::PrintError("Compiler : Failed to find Entry Point ('main()') in Module(%s)", module->nameHash.name.c_str());
+        return 0;
+    }
 
-    *interpreter->GetRegister(Register::Rax) = result;
+    RunEntryPoint(module, mainHash);
+    return 0;
 }
 
-int Compile(const std::string& fileName)
+int RunImage(const std::string& fileName, bool jit, bool tiered)
+{
+    ZoneScopedNC("RunImage", tracy::Color::Red);
+
+    Compiler cc;
+
+    Module* module = cc.modules.Emplace();
+    module->nameHash.SetNameHash(fileName);
+    module->jitInfo.isEnabled = jit;
+    module->jitInfo.isTiered = tiered;
+
+    if (!BytecodeImage::Load(module, fileName))
+        return -1;
+
+    return RunLoadedImage(module);
+}
+
+int Compile(const std::string& fileName, const std::string& imagePath, const std::string& objectPath, const std::string& cacheDirectory, bool optimize, bool disassemble, bool jit, bool tiered)
 {
     ZoneScopedNC("Compile", tracy::Color::Red);
 
     FileReader reader(fileName, fileName);
     if (!reader.Fetch())
     {
-        DebugHandler::PrintError("Compiler failed to read script (%s)");
+        DebugHandler::PrintError("Compiler failed to read script (%s)", fileName.c_str());
     }
     else
     {
@@ -132,29 +197,52 @@ int Compile(const std::string& fileName)
         module->nameHash.SetNameHash(fileName);
         module->lexerInfo.buffer = reader.GetBuffer();
         module->lexerInfo.size = reader.Length();
-
-        Lexer::Process(module);
-        Parser::Process(module);
-
-        // Add Native Calls
-
-        //NativeFunction nfTest(module, "Test", TestCallback);
-        NativeFunction nfPrint(module, "print", PrintCallback);
+        module->irInfo.isEnabled = optimize;
+        module->bytecodeInfo.recordComments = disassemble;
+        module->jitInfo.isEnabled = jit;
+        module->jitInfo.isTiered = tiered;
+
+        // main is all we run, whatever it can't reach is left out
+        // An object file exports every function to its host, so nothing is stripped and the cache key tells the two apart
+        if (objectPath.empty())
         {
-            nfPrint.AddParamChar("string", NativeFunction::PassAs::Pointer);
+            module->reachabilityInfo.entryPoints.push_back("main"_djb2);
         }
 
-        NativeFunction nfAdd(module, "Add", AddCallback);
+        u64 cacheKey = 0;
+        bool useCache = !cacheDirectory.empty() && CompileCache::GetKey(module, module->lexerInfo.buffer, module->lexerInfo.size, cacheKey);
+
+        // Cached images have no comments to print, so disassembling always compiles
+        // They don't keep the declarations an object file takes its symbol names from either
+        if (useCache && !disassemble && objectPath.empty() && CompileCache::TryLoad(cacheDirectory, cacheKey, module))
         {
-            nfAdd.AddParamU32("num1", NativeFunction::PassAs::Value);
-            nfAdd.AddParamU32("num2", NativeFunction::PassAs::Value);
-            nfAdd.SetReturnTypeU32(NativeFunction::PassAs::Value);
+            if (!imagePath.empty())
+            {
+                if (!CompileCache::Copy(cacheDirectory, cacheKey, imagePath))
+                    return -1;
+            }
+
+            return RunLoadedImage(module);
         }
 
+        Lexer::Process(module);
+        Parser::Process(module);
+
+        // Add Native Calls
+        AddNativeFunctions(module);
+
+        Reachability::Process(module);
         Typer::Process(module);
+        Folder::Process(module);
+        Optimizer::Process(module);
         Bytecode::Process(module);
+        BytecodeVerifier::Process(module);
+        Jit::Process(module);
 
-        Interpreter* interpreter = new Interpreter();
+        if (disassemble)
+        {
+            Bytecode::PrintDisassembly(module);
+        }
 
         u32 mainHash = "main"_djb2;
         bool foundMain = false;
@@ -194,20 +282,27 @@ int Compile(const std::string& fileName)
                 break;
 
             foundMain = true;
-            // Record Time
+
+            // Only modules with a valid entry point are worth shipping as an image
+            // Both report why they failed, a build that asked for the file mustn't look like it succeeded
+            if (!imagePath.empty())
             {
-                std::chrono::high_resolution_clock::time_point t1 = std::chrono::high_resolution_clock::now();
-                // Run Main
-                {
-                    interpreter->Init();
-                    interpreter->Interpret(module, declaration);
-                }
-                std::chrono::high_resolution_clock::time_point t2 = std::chrono::high_resolution_clock::now();
-                std::chrono::duration<double> time_span = std::chrono::duration_cast<std::chrono::duration<double>>(t2 - t1);
+                if (!BytecodeImage::Save(module, imagePath))
+                    return -1;
+            }
 
-                // Print Time
-                DebugHandler::PrintSuccess("Interpreter : Finished in %f seconds", time_span.count());
+            if (!objectPath.empty())
+            {
+                if (!ObjectFile::Save(module, objectPath))
+                    return -1;
             }
+
+            if (useCache)
+            {
+                CompileCache::Store(cacheDirectory, cacheKey, module);
+            }
+
+            RunEntryPoint(module, mainHash);
             break;
         }
 
@@ -232,7 +327,15 @@ int main(int argc, char* argv[])
     CLIParser cliParser; // Default implicit parameters are "executable" which gets the path to the current executable, and "filename" which gets the file we're acting on
 
     cliParser.AddParameter("unittest", "Runs a unittest on the file")
-             .AddParameter("testoutput", "The output location for unittests, [REQUIRED] if doing unittest");
+             .AddParameter("testoutput", "The output location for unittests, [REQUIRED] if doing unittest")
+             .AddParameter<std::string>("image", "Saves the compiled bytecode image to this path")
+             .AddParameter<std::string>("object", "Saves the module as an x86-64 ELF object to this path, to link into a host that runs without the Interpreter")
+             .AddParameter("runimage", "Treats the file as a bytecode image and runs it without compiling")
+             .AddParameter<std::string>("cache", "Directory of cached bytecode images, unchanged files are run from the cache without compiling")
+             .AddParameter("optimize", "Generates bytecode through the optimizing IR, functions it can't express yet are generated as before")
+             .AddParameter("disassemble", "Prints the generated bytecode along with the comment of every instruction")
+             .AddParameter("jit", "Translates verified functions to x86-64 machine code, the ones it can't translate run in the Interpreter")
+             .AddParameter("tiered", "With jit, functions start in the Interpreter and are only translated once they've been called or looped often enough");
 
     CLIValues values = cliParser.ParseArguments(argc, argv);
 
@@ -243,5 +346,11 @@ int main(int argc, char* argv[])
     }
 
     std::string filename = values["filename"_h].As<std::string>();
-    return Compile(filename);
+    if (values["runimage"_h].WasDefined())
+        return RunImage(filename, values["jit"_h].WasDefined(), values["tiered"_h].WasDefined());
+
+    std::string imagePath = values["image"_h].WasDefined() ? values["image"_h].As<std::string>() : "";
+    std::string objectPath = values["object"_h].WasDefined() ? values["object"_h].As<std::string>() : "";
+    std::string cacheDirectory = values["cache"_h].WasDefined() ? values["cache"_h].As<std::string>() : "";
+    return Compile(filename, imagePath, objectPath, cacheDirectory, values["optimize"_h].WasDefined(), values["disassemble"_h].WasDefined(), values["jit"_h].WasDefined(), values["tiered"_h].WasDefined());
 }
\ No newline at end of file